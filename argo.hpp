@@ -26,8 +26,16 @@
 /// \file argo.hpp Single file to include to get the full set of headers needed.
 
 #include "common.hpp"
+#include "memory_resource.hpp"
+#include "shape.hpp"
 #include "json.hpp"
 #include "pointer.hpp"
+#include "pointer_set.hpp"
+#include "json_path.hpp"
+#include "json_index.hpp"
+#include "path_index.hpp"
+#include "json_patch.hpp"
+#include "tape.hpp"
 #include "parser.hpp"
 #include "unparser.hpp"
 #include "json_array_index_range_exception.hpp"
@@ -38,6 +46,7 @@
 #include "json_utf8_exception.hpp"
 #include "stream_reader.hpp"
 #include "file_reader.hpp"
+#include "memory_reader.hpp"
 #include "stream_writer.hpp"
 #include "file_writer.hpp"
 
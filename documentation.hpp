@@ -94,6 +94,14 @@
  *     std::cout << j->find(argo::pointer("/foo/0")) << std::endl;
  * \endcode
  *
+ * Building a pointer decodes the string, so keep pointers that are used often. For a
+ * string literal ARGO_POINTER() does that for you and also rejects a malformed pointer
+ * at compile time:
+ *
+ * \code{.cpp}
+ *     std::cout << j->find(ARGO_POINTER("/foo/0")) << std::endl;
+ * \endcode
+ *
  * \section overview Overview
  *
  * The Argo library provides a set of C++ classes for manipulating JSON
@@ -119,6 +127,11 @@
  *     - Direct handling of multiple IO styles (streams, FILEs, file descriptors, strings).
  *     - DOM style representation of JSON messages.
  *     - JSON Pointer access as per <a href="https://tools.ietf.org/html/rfc6901">RFC6901</a>.
+ *     - Compiled JSONPath queries with recursive descent, slices and filters (see argo::json_path).
+ *     - All or nothing JSON Patch as per <a href="https://tools.ietf.org/html/rfc6902">RFC6902</a> (see argo::json_patch).
+ *     - In place JSON Merge Patch as per <a href="https://tools.ietf.org/html/rfc7396">RFC7396</a> (see argo::json::merge_patch()).
+ *     - Parsing of very large top level arrays on several cores (see argo::parser::parse_parallel()).
+ *     - Exception free accessors and parsing for hot paths where failure is routine (see argo::json::value_or(), argo::json::try_get() and argo::parser::try_parse()).
  *     - <a href="https://tools.ietf.org/html/rfc7159">RFC7159</a> compliance.
  *     - Full unicode support.
  *     - Good performance in the context of the amount of error checking carried out.
@@ -158,14 +171,18 @@
  * JSON has just numbers. C++, on the other hand, has ints and doubles. When parsing
  * messages Argo handles this as follows:
  *     - if the number is an integer (i.e. if it consists of a sequence of 0-9 digits
- *       and an options leading '-' sign) then it is parsed as an integer. If it is out
- *       of range for the int POD type, then, if the parser fallback_to_double option is true (the
+ *       and an options leading '-' sign) then it is parsed as a 64 bit integer. If it is out
+ *       of range for both int64_t and uint64_t, then, if the parser fallback_to_double option is true (the
  *       default) an attempt is then made to convert it to a double instead, otherwise parsing fails 
  *       and an exception is thrown.
  *     - if the number is floating point, (e.g. 1.2, 3e+10 etc.) then Argo attempts
  *       to convert it to a double. If it is out of range, then parsing fails and an
  *       exception is thrown.
  *
+ * Ints are held as int64_t, or as uint64_t for positive values too big for an int64_t
+ * (see json::is_uint64()). They can be read with the int, int64_t and uint64_t casts,
+ * each of which throws if the value doesn't fit.
+ *
  * An option is provided for programs that need to handle larger numbers using code of
  * their own whereby numbers are syntax checked only and returned as a string for conversion 
  * by the caller.
@@ -217,6 +234,9 @@
  * the same time and that multiple threads can safely call const methods on a shared json 
  * instance. Simultaneous update/read or update/update  operations on a json instance are 
  * not thread safe. This is the same thread safety model implemented by STL containers.
+ *
+ * argo::parser::parse_parallel() is the one place the library starts threads of its own.
+ * They are all finished with by the time it returns.
  * 
  * \section performance Efficiency Peformance vs. Convenience
  *
@@ -240,13 +260,121 @@
  * assignment operator which can remove the need for explicit pointer operations in many
  * cases.
  *
+ * \section memory Memory Resources
+ *
+ * Object and array storage is allocated through argo::polymorphic_allocator, a C++11
+ * equivalent of std::pmr::polymorphic_allocator. Pass a memory_resource to the parser
+ * constructor (or to json(type, memory_resource *)) to build a DOM inside your own pool.
+ * The rules follow std::pmr: a moved instance keeps the resource its storage came from,
+ * a copy gets new_delete_resource() unless you use json(const json &, memory_resource *).
+ * Strings are plain std::string and so short strings live inside the pooled node while
+ * long ones come from the global heap.
+ *
+ * \code{.cpp}
+ * argo::monotonic_buffer_resource pool;
+ * argo::stream_reader r(&std::cin, argo::parser::max_message_length, true);
+ * argo::parser p(r, true, argo::parser::max_token_length, argo::parser::max_nesting_depth,
+ *                true, true, true, &pool);
+ * auto j = p.parse();
+ * \endcode
+ *
+ * When reading a stream of similar messages, parser::parse_into() parses the next
+ * message into an existing json and reuses the strings, arrays and objects that it
+ * held before. Anything of the old value still shared with other instances is left
+ * alone. Once warmed up this does no allocation at all for messages with the same
+ * structure, and json::recycler offers the same trick to code building documents by hand.
+ *
+ * \section copying Copying
+ *
+ * Copying a json instance is cheap whatever its size. Objects and arrays are
+ * reference counted and shared between copies until one of the copies changes
+ * them, at which point just the objects and arrays on the path to the change
+ * are cloned. The reference counts are atomic so copies may be passed to other
+ * threads. Storage is only shared between instances using the same memory
+ * resource and stops being shared once a non-const reference into it has been
+ * obtained, e.g. via get_object() or the non-const [] operator.
+ *
+ * Documents that repeat the same sub-objects many times can be shrunk with
+ * json::deduplicate(), which makes all identical objects and arrays share one
+ * copy of their storage in the same way.
+ *
+ * Strings and numbers are still copied, so when building a document pass the
+ * values being added with std::move() to json::append() and json::insert(), or
+ * construct them in place with json::emplace_back() and json::emplace().
+ *
+ * \section hashing Hashing
+ *
+ * json::hash() returns a structural hash that is consistent with operator== and
+ * std::hash is specialised for json so instances can be used directly as keys of
+ * unordered containers. Each object and array caches its hash, so rehashing a
+ * large document after a change only walks the path to the change, and
+ * operator== returns false straight away when both sides have differing cached
+ * hashes.
+ *
+ * \section tapes Read Only Documents
+ *
+ * For documents that are built once and then only read, argo::tape holds the
+ * whole DOM in a single vector of tagged 64 bit entries plus one block of string
+ * data. Lookups walk linearly through memory instead of following pointers. The
+ * navigation API mirrors the const json API and unparser writes tapes exactly as it
+ * would the json instance they were built from.
+ *
+ * \code{.cpp}
+ * auto j = argo::parser::load("test_files/test2.json");
+ * argo::tape t(*j);
+ * std::cout << t.find(argo::pointer("/0/address")) << std::endl;
+ * \endcode
+ *
+ * \section packed Numeric Arrays
+ *
+ * Arrays in which every element is an int or every element is a double are
+ * stored by the parser as a packed vector of int64_t or double values rather
+ * than a vector of json instances. This makes no difference to how they are
+ * used; any non-const access converts them back to the ordinary form first.
+ * json::as_span() gives direct access to the values and json::sum(),
+ * json::minimum() and json::maximum() work over them with loops the compiler
+ * can vectorise.
+ *
+ * Packing is on by default. Const element access with json::size() and
+ * json::operator[] reads a packed array without unpacking it, which is how the
+ * library itself walks arrays. json::get_array() on a const packed array has
+ * to build a vector of json instances holding every element and keep it for
+ * the life of the array, so iterate by index instead when arrays may be packed
+ * or pass false for the parser's p_pack_numeric_arrays option.
+ *
+ * \code{.cpp}
+ * auto j = argo::parser::parse("[1.5, 2.5, 3.5]");
+ * std::cout << j->sum() << " " << j->as_span<double>().size() << std::endl;
+ * \endcode
+ *
+ * \section shapes Object Shapes
+ *
+ * The parser can store each non-empty object as a vector of values plus an
+ * argo::object_shape holding the member names. Objects with the same set of
+ * names, e.g. the records in an array of records, share one shape so each name
+ * is held once rather than once per object. As with packed arrays this makes
+ * no difference to how they are used and non-const access converts them back
+ * to an ordinary map. Const lookups go through the shape, which remembers the
+ * slot it found last, so reading the same member of every record is cheap.
+ * Shapes are allocated from the global heap rather than the parser's memory
+ * resource since they can outlive the message they were made for. Shaping is
+ * off by default, pass true for the parser's p_shape_objects option to turn it
+ * on. Comparison, diffing, unparsing and JSON path all work straight off the
+ * shape but json::get_object() on a const shaped object has to build and keep
+ * a map of the members, which gives back the memory that shaping saved.
+ *
+ * The parser also expects each object to have the same names in the same
+ * order as the last object at the same depth. Names that match byte for byte
+ * aren't decoded again and an object whose names all match reuses the last
+ * shape directly. parser::get_statistics() reports how often that happens.
+ *
  * \section installing Installation
  *
  * \subsection all All Operating Systems & Compilers
  * 
  * The simplest way to install Argo is to include the code in your own project and
  * then build it along with everything else. All the .hpp files and all the .cpp
- * files are needed except for documentation.hpp, json_test.cpp and json_example.cpp.
+ * files are needed except for documentation.hpp, json_test.cpp, json_example.cpp and json_bench.cpp.
  *
  * \subsection linux Linux
  *
@@ -22,8 +22,12 @@
 
 /// \file json.cpp The json class.
 
+#include <atomic>
+#include <climits>
+#include <cstring>
 #include <iterator>
 #include <algorithm>
+#include <unordered_map>
 
 #include "common.hpp"
 #include "json.hpp"
@@ -41,919 +45,3305 @@ json::~json() noexcept
     reset();
 }
 
+// shared storage
+
+/**
+ * Reference counted holder for the map of an object or the vector of an
+ * array. Copies of a json instance point at the same node and it is only
+ * cloned when one of them is about to change it. The node lives in the same
+ * memory resource as the container it holds.
+ */
+template <typename T>
+struct json::shared_node
+{
+    explicit shared_node(T &&value) : m_refs(1), m_shareable(true), m_hash(0), m_value(std::move(value))
+    {
+    }
+
+    /// New node taking over the contents of value.
+    static shared_node *create(T &&value)
+    {
+        memory_resource *r = value.get_allocator().resource();
+        void *p = r->allocate(sizeof(shared_node), alignof(shared_node));
+        return new (p) shared_node(std::move(value));
+    }
+
+    void acquire() noexcept
+    {
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() noexcept
+    {
+        if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            memory_resource *r = m_value.get_allocator().resource();
+            this->~shared_node();
+            r->deallocate(this, sizeof(shared_node), alignof(shared_node));
+        }
+    }
+
+    /// True if another instance holds a reference too.
+    bool is_shared() const noexcept
+    {
+        return m_refs.load(std::memory_order_acquire) != 1;
+    }
+
+    /// True if a copy allocating from r can simply take another reference.
+    bool can_share(memory_resource *r) const noexcept
+    {
+        return m_shareable && *m_value.get_allocator().resource() == *(r ? r : new_delete_resource());
+    }
+
+    std::atomic<size_t> m_refs;
+
+    /// Cleared once a non-const reference into m_value has been handed out.
+    bool m_shareable;
+
+    /// See json::hash(), 0 if not yet known.
+    std::atomic<size_t> m_hash;
+
+    T m_value;
+};
+
 // objects
 
 void json::destroy_object() noexcept
 {
-    m_value.u_object.~json_object();
+    m_value.u_object->release();
 }
 
-void json::construct_object()
+void json::construct_object(memory_resource *r)
 {
-    new (&m_value.u_object) json::json_object;
+    move_construct_object(json_object(json_object::allocator_type(r)));
 }
 
 void json::move_construct_object(json_object&& o)
 {
-    construct_object();
-    std::move(o.begin(), o.end(), std::inserter(m_value.u_object, m_value.u_object.begin()));
+    m_value.u_object = object_node::create(std::move(o));
+}
+
+void json::copy_construct_object(const json_object &o, memory_resource *r)
+{
+    json_object res{json_object::allocator_type(r)};
+    for (const auto &p : o)
+    {
+        res.emplace_hint(
+                res.end(),
+                std::piecewise_construct,
+                std::forward_as_tuple(p.first),
+                std::forward_as_tuple(p.second, r));
+    }
+    move_construct_object(std::move(res));
 }
 
-void json::copy_construct_object(const json_object &o)
+json::json_object &json::object_for_update()
 {
-    construct_object();
-    std::copy(o.begin(), o.end(), std::inserter(m_value.u_object, m_value.u_object.begin()));
+    ensure_type(object_e, json_exception::not_an_object_e);
+    unshape();
+
+    object_node *n = m_value.u_object;
+    if (n->is_shared())
+    {
+        // The members are copied but they share their own storage with the
+        // originals, so only this level is cloned.
+        copy_construct_object(n->m_value, n->m_value.get_allocator().resource());
+        n->release();
+    }
+
+    m_value.u_object->m_hash.store(0, std::memory_order_relaxed);
+    return m_value.u_object->m_value;
 }
 
 // arrays
 
 void json::destroy_array() noexcept
 {
-    m_value.u_array.~json_array();
+    m_value.u_array->release();
 }
 
-void json::construct_array()
+void json::construct_array(memory_resource *r)
 {
-    new (&m_value.u_array) json::json_array;
+    move_construct_array(json_array(json_array::allocator_type(r)));
 }
 
 void json::move_construct_array(json_array&& a)
 {
-    construct_array();
-    std::move(a.begin(), a.end(), std::back_inserter(m_value.u_array));
+    m_value.u_array = array_node::create(std::move(a));
 }
 
-void json::copy_construct_array(const json_array &a)
+void json::copy_construct_array(const json_array &a, memory_resource *r)
 {
-    construct_array();
-    std::copy(a.begin(), a.end(), std::back_inserter(m_value.u_array));
+    json_array res{json_array::allocator_type(r)};
+    res.reserve(a.size());
+    for (const auto &i : a)
+    {
+        res.emplace_back(i, r);
+    }
+    move_construct_array(std::move(res));
 }
 
-// strings
-
-void json::become_string(std::string s)
+json::json_array &json::array_for_update()
 {
-    m_type = string_e;
-    construct_string(std::move(s));
-}
+    ensure_type(array_e, json_exception::not_an_array_e);
+    unpack();
 
-void json::destroy_string() noexcept
-{
-    m_value.u_string.~basic_string();
-}
+    array_node *n = m_value.u_array;
+    if (n->is_shared())
+    {
+        copy_construct_array(n->m_value, n->m_value.get_allocator().resource());
+        n->release();
+    }
 
-void json::construct_string()
-{
-    new (&m_value.u_string) std::string;
+    m_value.u_array->m_hash.store(0, std::memory_order_relaxed);
+    return m_value.u_array->m_value;
 }
 
-void json::construct_string(std::string s)
-{
-    new (&m_value.u_string) std::string(std::move(s));
-}
+// packed arrays
 
-void json::reset() noexcept
-{
-    switch (m_type)
+/**
+ * Storage for a packed array. Only one of the two vectors is used depending
+ * on the element type. Const methods that need json references to the
+ * elements get them from m_blocks, which makes json instances block_size
+ * elements at a time as they are asked for, or from m_view if get_array()
+ * has built the whole vector. Both are published atomically so that
+ * concurrent readers are safe. Packed arrays are shared by copies in the same
+ * way as shared_node.
+ */
+struct json::packed_array
+{
+    /// Number of elements made into json instances at a time.
+    static const size_t block_size = 64;
+
+    packed_array(type element_type, memory_resource *r) :
+                        m_refs(1),
+                        m_hash(0),
+                        m_element_type(element_type),
+                        m_resource(r),
+                        m_ints(polymorphic_allocator<int64_t>(r)),
+                        m_doubles(polymorphic_allocator<double>(r)),
+                        m_view(nullptr),
+                        m_blocks(nullptr)
     {
-    case object_e:
-        destroy_object();
-        break;
-    case array_e:
-        destroy_array();
-        break;
-    case string_e:
-        destroy_string();
-        break;
-    default:
-        break;
     }
 
-    m_type = null_e;
-    m_raw_value.clear();
-}
+    ~packed_array()
+    {
+        release_view();
+    }
 
-void json::copy_json(const json &other)
-{
-    if (this == &other) return;
+    // frees the view and the element blocks, must be called before the
+    // values change since the directory is sized by num_blocks()
+    void release_view()
+    {
+        json_array *view = m_view.exchange(nullptr);
+        if (view)
+        {
+            view->~json_array();
+            m_resource->deallocate(view, sizeof(json_array), alignof(json_array));
+        }
 
-    reset();
-    m_type = other.m_type;
-    m_raw_value = other.m_raw_value;
+        std::atomic<json *> *blocks = m_blocks.exchange(nullptr);
+        if (blocks)
+        {
+            for (size_t b = 0; b < num_blocks(); b++)
+            {
+                free_block(blocks[b].load());
+            }
+            m_resource->deallocate(blocks, num_blocks() * sizeof(std::atomic<json *>), alignof(std::atomic<json *>));
+        }
+    }
 
-    if (m_type == object_e)
+    size_t size() const
     {
-        copy_construct_object(other.m_value.u_object);
+        return m_element_type == number_int_e ? m_ints.size() : m_doubles.size();
     }
-    else if (m_type == array_e)
+
+    size_t num_blocks() const
     {
-        copy_construct_array(other.m_value.u_array);
+        return (size() + block_size - 1) / block_size;
     }
-    else if (m_type == string_e)
+
+    json value(size_t i) const
     {
-        construct_string(other.m_value.u_string);
+        return m_element_type == number_int_e ? json(m_ints[i]) : json(m_doubles[i]);
     }
-    else if (m_type == boolean_e)
+
+    /// All the elements as json instances.
+    json_array elements() const
     {
-        m_value.u_boolean = other.m_value.u_boolean;
+        json_array a{json_array::allocator_type(m_resource)};
+        a.reserve(size());
+        for (size_t i = 0; i < size(); i++)
+        {
+            a.push_back(value(i));
+        }
+        return a;
     }
-    else if (m_type == number_int_e)
+
+    /// The block holding element i as json instances, any past the end being null.
+    json *make_block(size_t i) const
     {
-        m_value.u_number_int = other.m_value.u_number_int;
+        json *b = static_cast<json *>(m_resource->allocate(block_size * sizeof(json), alignof(json)));
+        size_t first = i - i % block_size;
+        for (size_t k = 0; k < block_size; k++)
+        {
+            new (&b[k]) json(first + k < size() ? value(first + k) : json());
+        }
+        return b;
     }
-    else if (m_type == number_double_e)
+
+    void free_block(json *b) const
     {
-        m_value.u_number_double = other.m_value.u_number_double;
+        if (b)
+        {
+            for (size_t k = 0; k < block_size; k++)
+            {
+                b[k].~json();
+            }
+            m_resource->deallocate(b, block_size * sizeof(json), alignof(json));
+        }
     }
-}
 
-json::json(const json &other) : m_type(null_e)
+    std::atomic<size_t> m_refs;
+    std::atomic<size_t> m_hash;
+    type m_element_type;
+    memory_resource *m_resource;
+    std::vector<int64_t, polymorphic_allocator<int64_t>> m_ints;
+    std::vector<double, polymorphic_allocator<double>> m_doubles;
+    std::atomic<json_array *> m_view;
+    std::atomic<std::atomic<json *> *> m_blocks;
+};
+
+void json::destroy_packed() noexcept
 {
-    copy_json(other);
+    packed_array *p = m_value.u_packed;
+    if (p->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        memory_resource *r = p->m_resource;
+        p->~packed_array();
+        r->deallocate(p, sizeof(packed_array), alignof(packed_array));
+    }
+    m_packed = false;
 }
 
-json &json::operator=(const json &other)
+void json::construct_packed(type element_type, memory_resource *r)
 {
-    copy_json(other);
-    return *this;
+    r = r ? r : new_delete_resource();
+    void *p = r->allocate(sizeof(packed_array), alignof(packed_array));
+    m_value.u_packed = new (p) packed_array(element_type, r);
+    m_packed = true;
 }
 
-void json::move_json(json &other)
+void json::copy_construct_packed(const packed_array &p, memory_resource *r)
 {
-    if (this == &other) return;
-
-    reset();
-    m_type = other.m_type;
-    if (m_type == object_e)
-    {
-        move_construct_object(std::move(other.m_value.u_object));
-    }
-    else if (m_type == array_e)
-    {
-        move_construct_array(std::move(other.m_value.u_array));
-    }
-    else if (m_type == string_e)
+    if (*p.m_resource == *(r ? r : new_delete_resource()))
     {
-        construct_string(other.m_value.u_string);
+        // never modified in place so it can always be shared
+        m_value.u_packed = const_cast<packed_array *>(&p);
+        m_value.u_packed->m_refs.fetch_add(1, std::memory_order_relaxed);
+        m_packed = true;
+        return;
     }
-    else if (m_type == boolean_e)
+
+    construct_packed(p.m_element_type, r);
+    m_value.u_packed->m_ints.assign(p.m_ints.begin(), p.m_ints.end());
+    m_value.u_packed->m_doubles.assign(p.m_doubles.begin(), p.m_doubles.end());
+}
+
+void json::unpack()
+{
+    if (m_packed)
     {
-        m_value.u_boolean = other.m_value.u_boolean;
+        json_array a(json_array::allocator_type(m_value.u_packed->m_resource));
+        json_array *view = m_value.u_packed->m_view.load();
+
+        if (view && m_value.u_packed->m_refs.load(std::memory_order_acquire) == 1)
+        {
+            a = std::move(*view);
+        }
+        else if (view)
+        {
+            a = *view;
+        }
+        else
+        {
+            a = m_value.u_packed->elements();
+        }
+
+        destroy_packed();
+        move_construct_array(std::move(a));
     }
-    else if (m_type == number_int_e)
+}
+
+const json::json_array &json::array_view() const
+{
+    if (!m_packed)
     {
-        m_value.u_number_int = other.m_value.u_number_int;
+        return m_value.u_array->m_value;
     }
-    else if (m_type == number_double_e)
+
+    packed_array &p = *m_value.u_packed;
+    json_array *view = p.m_view.load();
+
+    if (view == nullptr)
     {
-        m_value.u_number_double = other.m_value.u_number_double;
-    }
+        json_array elements = p.elements();
 
-    m_raw_value = std::move(other.m_raw_value);
+        // the vector itself comes from the array's resource too
+        void *storage = p.m_resource->allocate(sizeof(json_array), alignof(json_array));
+        json_array *a = new (storage) json_array(std::move(elements));
 
-    other.reset();
-}
+        // another thread may have got there first, in which case use theirs
+        if (p.m_view.compare_exchange_strong(view, a))
+        {
+            view = a;
+        }
+        else
+        {
+            a->~json_array();
+            p.m_resource->deallocate(a, sizeof(json_array), alignof(json_array));
+        }
+    }
 
-json &json::operator=(json &&other) noexcept
-{
-    move_json(other);
-    return *this;
+    return *view;
 }
 
-json::json(json &&other) noexcept : m_type(null_e)
+const json &json::packed_element(size_t index) const
 {
-    move_json(other);
-}
+    packed_array &p = *m_value.u_packed;
+    json_array *view = p.m_view.load();
 
-json::json(type t) : m_type(t)
-{
-    switch (m_type)
+    if (view)
     {
-    case object_e:
-        construct_object();
-        break;
-    case array_e:
-        construct_array();
-        break;
-    case string_e:
-        construct_string();
-        break;
-    case boolean_e:
-        m_value.u_boolean = false;
-        break;
-    case number_int_e:
-        m_value.u_number_int = 0;
-        break;
-    case number_double_e:
-        m_value.u_number_double = 0;
-        break;
-    case null_e:
-        break;
-    default:
-        throw json_exception(json_exception::invalid_json_type_e);
+        return (*view)[index];
     }
-}
 
-json::json(type t, std::string raw_value) : m_type(t), m_raw_value(std::move(raw_value))
-{
-    if (t != string_e && t != number_int_e && t != number_double_e)
+    // As with the view, another thread may get there first, in which case
+    // theirs is used.
+    std::atomic<json *> *blocks = p.m_blocks.load();
+
+    if (blocks == nullptr)
     {
-        throw json_exception(json_exception::not_number_or_string_e, get_instance_type_name());
+        size_t n = p.num_blocks();
+        void *storage = p.m_resource->allocate(n * sizeof(std::atomic<json *>), alignof(std::atomic<json *>));
+        std::atomic<json *> *b = static_cast<std::atomic<json *> *>(storage);
+        for (size_t i = 0; i < n; i++)
+        {
+            new (&b[i]) std::atomic<json *>(nullptr);
+        }
+
+        if (p.m_blocks.compare_exchange_strong(blocks, b))
+        {
+            blocks = b;
+        }
+        else
+        {
+            p.m_resource->deallocate(b, n * sizeof(std::atomic<json *>), alignof(std::atomic<json *>));
+        }
     }
 
-    if (t == string_e)
+    std::atomic<json *> &slot = blocks[index / packed_array::block_size];
+    json *block = slot.load();
+
+    if (block == nullptr)
     {
-        construct_string();
+        json *b = p.make_block(index);
+
+        if (slot.compare_exchange_strong(block, b))
+        {
+            block = b;
+        }
+        else
+        {
+            p.free_block(b);
+        }
     }
-}
 
-json::json(int i) noexcept
-{
-    m_type = number_int_e;
-    m_value.u_number_int = i;
+    return block[index % packed_array::block_size];
 }
 
-json::json(double d) noexcept
+json json::from_numbers(const int64_t *values, size_t n, memory_resource *r)
 {
-    m_type = number_double_e;
-    m_value.u_number_double = d;
+    json j;
+    j.m_type = array_e;
+    j.construct_packed(number_int_e, r);
+    j.m_value.u_packed->m_ints.assign(values, values + n);
+    return j;
 }
 
-json::json(bool b) noexcept
+json json::from_numbers(const double *values, size_t n, memory_resource *r)
 {
-    m_type = boolean_e;
-    m_value.u_boolean = b;
+    json j;
+    j.m_type = array_e;
+    j.construct_packed(number_double_e, r);
+    j.m_value.u_packed->m_doubles.assign(values, values + n);
+    return j;
 }
 
-json::json(std::string s)
+bool json::is_packed() const noexcept
 {
-    become_string(std::move(s));
+    return m_packed;
 }
 
-json::json(const char *s)
+json::type json::get_packed_type() const noexcept
 {
-    become_string(s);
+    return m_packed ? m_value.u_packed->m_element_type : null_e;
 }
 
-json::json(null_t) noexcept : m_type(null_e)
+template <>
+span<const int64_t> NAMESPACE::json::as_span<int64_t>() const
 {
+    if (m_packed && m_value.u_packed->m_element_type == number_int_e)
+    {
+        return span<const int64_t>(m_value.u_packed->m_ints.data(), m_value.u_packed->m_ints.size());
+    }
+    else
+    {
+        throw json_exception(json_exception::not_packed_array_e);
+    }
 }
 
-json::json(std::unique_ptr<std::string> s)
+template <>
+span<const double> NAMESPACE::json::as_span<double>() const
 {
-    become_string(*s);
+    if (m_packed && m_value.u_packed->m_element_type == number_double_e)
+    {
+        return span<const double>(m_value.u_packed->m_doubles.data(), m_value.u_packed->m_doubles.size());
+    }
+    else
+    {
+        throw json_exception(json_exception::not_packed_array_e);
+    }
 }
 
-json &json::operator=(int i)
-{
-    reset();
-    m_type = number_int_e;
-    m_value.u_number_int = i;
-    return *this;
-}
+// shaped objects
 
-json &json::operator=(double d)
-{
-    reset();
-    m_type = number_double_e;
-    m_value.u_number_double = d;
-    return *this;
-}
+/**
+ * Storage for a shaped object. m_values holds the value for each name in
+ * m_shape, in the same order. As for packed_array, m_view is built on demand
+ * by const methods that need the members as a map, the storage is never
+ * changed in place and it is shared by copies.
+ */
+struct json::shaped_object
+{
+    shaped_object(std::shared_ptr<const object_shape> shape, json_array &&values) :
+                        m_refs(1),
+                        m_hash(0),
+                        m_resource(values.get_allocator().resource()),
+                        m_shape(std::move(shape)),
+                        m_values(std::move(values)),
+                        m_view(nullptr)
+    {
+    }
 
-json &json::operator=(bool b)
-{
-    reset();
-    m_type = boolean_e;
-    m_value.u_boolean = b;
-    return *this;
-}
+    ~shaped_object()
+    {
+        release_view();
+    }
 
-json &json::operator=(std::string s)
-{
-    reset();
-    become_string(std::move(s));
-    return *this;
-}
+    void release_view()
+    {
+        json_object *view = m_view.exchange(nullptr);
+        if (view)
+        {
+            view->~json_object();
+            m_resource->deallocate(view, sizeof(json_object), alignof(json_object));
+        }
+    }
 
-json &json::operator=(const char *s)
-{
-    reset();
-    become_string(s);
-    return *this;
-}
+    std::atomic<size_t> m_refs;
+    std::atomic<size_t> m_hash;
+    memory_resource *m_resource;
+    std::shared_ptr<const object_shape> m_shape;
+    json_array m_values;
+    std::atomic<json_object *> m_view;
+};
 
-json &json::operator=(std::unique_ptr<std::string> s)
+void json::destroy_shaped() noexcept
 {
-    reset();
-    become_string(*s);
-    return *this;
+    shaped_object *s = m_value.u_shaped;
+    if (s->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        memory_resource *r = s->m_resource;
+        s->~shaped_object();
+        r->deallocate(s, sizeof(shaped_object), alignof(shaped_object));
+    }
+    m_shaped = false;
 }
 
-json &json::operator=(const json::json_object &o)
+void json::construct_shaped(std::shared_ptr<const object_shape> shape, json_array &&values)
 {
-    reset();
-    m_type = object_e;
-    copy_construct_object(o);
-    return *this;
+    memory_resource *r = values.get_allocator().resource();
+    void *p = r->allocate(sizeof(shaped_object), alignof(shaped_object));
+    m_value.u_shaped = new (p) shaped_object(std::move(shape), std::move(values));
+    m_shaped = true;
 }
 
-json &json::operator=(const json_array &a)
+void json::copy_construct_shaped(const shaped_object &s, memory_resource *r)
 {
-    reset();
-    m_type = array_e;
-    copy_construct_array(a);
-    return *this;
-}
+    if (*s.m_resource == *(r ? r : new_delete_resource()))
+    {
+        // never modified in place so it can always be shared
+        m_value.u_shaped = const_cast<shaped_object *>(&s);
+        m_value.u_shaped->m_refs.fetch_add(1, std::memory_order_relaxed);
+        m_shaped = true;
+        return;
+    }
 
-json &json::operator=(null_t)
-{
-    reset();
-    m_type = null_e;
-    return *this;
+    json_array values{json_array::allocator_type(r)};
+    values.reserve(s.m_values.size());
+    for (const auto &v : s.m_values)
+    {
+        values.emplace_back(v, r);
+    }
+    construct_shaped(s.m_shape, std::move(values));
 }
 
-json json::from_object(json_object o)
+void json::unshape()
 {
-    json j(object_e);
-    j.move_construct_object(std::move(o));
-    return j;
-}
+    if (m_shaped)
+    {
+        shaped_object &s = *m_value.u_shaped;
+        json_object o{json_object::allocator_type(s.m_resource)};
+        const auto &names = s.m_shape->get_names();
+        bool owned = s.m_refs.load(std::memory_order_acquire) == 1;
 
-json json::from_array(json_array a)
-{
-    json j(array_e);
-    j.move_construct_array(std::move(a));
-    return j;
-}
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            if (owned)
+            {
+                o.emplace_hint(o.end(), names[i], std::move(s.m_values[i]));
+            }
+            else
+            {
+                o.emplace_hint(
+                        o.end(),
+                        std::piecewise_construct,
+                        std::forward_as_tuple(names[i]),
+                        std::forward_as_tuple(s.m_values[i], s.m_resource));
+            }
+        }
 
-json::type json::get_instance_type() const
-{
-    return m_type;
+        destroy_shaped();
+        move_construct_object(std::move(o));
+    }
 }
 
-json::json_array &json::get_array()
+const json::json_object &json::object_view() const
 {
-    ensure_type(array_e, json_exception::not_an_array_e);
-    return m_value.u_array;
+    if (!m_shaped)
+    {
+        return m_value.u_object->m_value;
+    }
+
+    shaped_object &s = *m_value.u_shaped;
+    json_object *view = s.m_view.load();
+
+    if (view == nullptr)
+    {
+        json_object members{json_object::allocator_type(s.m_resource)};
+        const auto &names = s.m_shape->get_names();
+
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            members.emplace_hint(
+                    members.end(),
+                    std::piecewise_construct,
+                    std::forward_as_tuple(names[i]),
+                    std::forward_as_tuple(s.m_values[i], s.m_resource));
+        }
+
+        // the map itself comes from the object's resource too
+        void *storage = s.m_resource->allocate(sizeof(json_object), alignof(json_object));
+        json_object *o = new (storage) json_object(std::move(members));
+
+        // another thread may have got there first, in which case use theirs
+        if (s.m_view.compare_exchange_strong(view, o))
+        {
+            view = o;
+        }
+        else
+        {
+            o->~json_object();
+            s.m_resource->deallocate(o, sizeof(json_object), alignof(json_object));
+        }
+    }
+
+    return *view;
 }
 
-const json::json_array &json::get_array() const
+const json *json::find_member(const std::string &name) const
 {
-    ensure_type(array_e, json_exception::not_an_array_e);
-    return m_value.u_array;
+    if (m_shaped)
+    {
+        size_t i = m_value.u_shaped->m_shape->find(name);
+        return i == object_shape::npos ? nullptr : &m_value.u_shaped->m_values[i];
+    }
+
+    const json_object &o = m_value.u_object->m_value;
+    auto i = o.find(name);
+    return i == o.end() ? nullptr : &i->second;
 }
 
-json::json_object &json::get_object()
+const json *json::find_member(const pointer::token &t) const
 {
-    ensure_type(object_e, json_exception::not_an_object_e);
-    return m_value.u_object;
+    if (m_shaped)
+    {
+        size_t hint = t.get_slot_hint();
+        size_t i = m_value.u_shaped->m_shape->find(t.get_name(), hint);
+
+        if (i == object_shape::npos)
+        {
+            return nullptr;
+        }
+        else if (i != hint)
+        {
+            // Only store when it changes so that threads sharing a pointer
+            // don't fight over the cache line.
+            t.set_slot_hint(i);
+        }
+        return &m_value.u_shaped->m_values[i];
+    }
+
+    return find_member(t.get_name());
 }
 
-const json::json_object &json::get_object() const
+json json::from_shape(std::shared_ptr<const object_shape> shape, json_array values)
 {
-    ensure_type(object_e, json_exception::not_an_object_e);
-    return m_value.u_object;
+    if (!shape || shape->size() != values.size())
+    {
+        throw json_exception(json_exception::shape_size_mismatch_e);
+    }
+
+    json j;
+    j.m_type = object_e;
+    j.construct_shaped(std::move(shape), std::move(values));
+    return j;
 }
 
-bool json::has(const std::string &name) const
+bool json::is_shaped() const noexcept
 {
-    const json_object& o = get_object();
-    return o.find(name) != o.end();
+    return m_shaped;
 }
 
-const std::string &json::get_raw_value() const
+std::shared_ptr<const object_shape> json::get_shape() const
 {
-    return m_raw_value;
+    return m_shaped ? m_value.u_shaped->m_shape : nullptr;
 }
 
-json::operator int() const
+span<const json> json::get_shape_values() const
 {
-    if (m_raw_value.size() > 0)
-    {
-        throw json_exception(json_exception::cant_cast_raw_e);
-    }
-    else if (m_type == number_int_e)
-    {
-        return m_value.u_number_int;
-    }
-    else if (m_type == number_double_e)
+    if (m_shaped)
     {
-        return static_cast<int>(m_value.u_number_double);
+        return span<const json>(m_value.u_shaped->m_values.data(), m_value.u_shaped->m_values.size());
     }
     else
     {
-        throw json_exception(json_exception::not_number_e, get_instance_type_name());
+        throw json_exception(json_exception::not_shaped_object_e);
     }
 }
 
-json::operator double() const
+// The bulk operations use four independent accumulators so that there is no
+// loop carried dependency between neighbouring elements and the compiler is
+// free to turn the loops into SIMD code.
+
+template <typename T, typename A>
+static A packed_sum(const T *v, size_t n)
 {
-    if (m_raw_value.size() > 0)
-    {
-        throw json_exception(json_exception::cant_cast_raw_e);
-    }
-    else if (m_type == number_double_e)
-    {
-        return m_value.u_number_double;
-    }
-    else if (m_type == number_int_e)
+    A a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
     {
-        return static_cast<double>(m_value.u_number_int);
+        a0 += v[i];
+        a1 += v[i + 1];
+        a2 += v[i + 2];
+        a3 += v[i + 3];
     }
-    else
+
+    for (; i < n; i++)
     {
-        throw json_exception(json_exception::not_number_e, get_instance_type_name());
+        a0 += v[i];
     }
+
+    return (a0 + a1) + (a2 + a3);
 }
 
-json::operator const std::string&() const
+template <typename T>
+static T packed_minimum(const T *v, size_t n)
 {
-    if (m_raw_value.size() > 0)
-    {
-        throw json_exception(json_exception::cant_cast_raw_e);
-    }
-    else if (m_type == string_e)
+    T m0 = v[0], m1 = v[0], m2 = v[0], m3 = v[0];
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
     {
-        return m_value.u_string;
+        m0 = v[i] < m0 ? v[i] : m0;
+        m1 = v[i + 1] < m1 ? v[i + 1] : m1;
+        m2 = v[i + 2] < m2 ? v[i + 2] : m2;
+        m3 = v[i + 3] < m3 ? v[i + 3] : m3;
     }
-    else
+
+    for (; i < n; i++)
     {
-        throw json_exception(json_exception::not_string_e, get_instance_type_name());
+        m0 = v[i] < m0 ? v[i] : m0;
     }
+
+    m0 = m1 < m0 ? m1 : m0;
+    m2 = m3 < m2 ? m3 : m2;
+    return m2 < m0 ? m2 : m0;
 }
 
-json::operator bool() const
+template <typename T>
+static T packed_maximum(const T *v, size_t n)
 {
-    if (m_type == boolean_e)
-    {
-        return m_value.u_boolean;
-    }
-    else if (m_type == number_int_e)
+    T m0 = v[0], m1 = v[0], m2 = v[0], m3 = v[0];
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
     {
-        return m_value.u_number_int != 0;
+        m0 = v[i] > m0 ? v[i] : m0;
+        m1 = v[i + 1] > m1 ? v[i + 1] : m1;
+        m2 = v[i + 2] > m2 ? v[i + 2] : m2;
+        m3 = v[i + 3] > m3 ? v[i + 3] : m3;
     }
-    else
+
+    for (; i < n; i++)
     {
-        throw json_exception(json_exception::not_number_int_or_boolean_e, get_instance_type_name());
+        m0 = v[i] > m0 ? v[i] : m0;
     }
-}
 
-json &json::operator[](const std::string &name)
-{
-    json_object& o = get_object();
-    return o[name];
+    m0 = m1 > m0 ? m1 : m0;
+    m2 = m3 > m2 ? m3 : m2;
+    return m2 > m0 ? m2 : m0;
 }
 
-json &json::operator[](const char *name)
+double json::sum() const
 {
-    return (*this)[std::string(name)];
-}
+    ensure_type(array_e, json_exception::not_an_array_e);
 
-json &json::operator[](size_t index)
-{
-    json_array& a = get_array();
-    if (index < a.size())
-    {
-        return (a)[index];
-    }
-    else
+    if (m_packed && m_value.u_packed->m_element_type == number_int_e)
     {
-        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+        // in double, as for an unpacked array, so that a total too big
+        // for an int64_t doesn't wrap
+        const auto &v = m_value.u_packed->m_ints;
+        return packed_sum<int64_t, double>(v.data(), v.size());
     }
-}
-
-json &json::operator[](int index)
-{
-    if (index >= 0)
+    else if (m_packed)
     {
-        return (*this)[static_cast<size_t>(index)];
+        const auto &v = m_value.u_packed->m_doubles;
+        return packed_sum<double, double>(v.data(), v.size());
     }
     else
     {
-        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+        double res = 0;
+        for (const auto &e : m_value.u_array->m_value)
+        {
+            res += static_cast<double>(e);
+        }
+        return res;
     }
 }
 
-const json &json::operator[](size_t index) const
+double json::minimum() const
 {
-    const json_array& a = get_array();
-    if (index < a.size())
-    {
-        return (a)[index];
-    }
-    else
+    ensure_type(array_e, json_exception::not_an_array_e);
+
+    if (m_packed && m_value.u_packed->m_element_type == number_int_e)
     {
-        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+        const auto &v = m_value.u_packed->m_ints;
+        if (v.empty())
+        {
+            throw json_array_index_range_exception(json_exception::array_index_range_e, 0);
+        }
+        return static_cast<double>(packed_minimum(v.data(), v.size()));
     }
-}
-
-const json &json::operator[](int index) const
-{
-    if (index >= 0)
+    else if (m_packed)
     {
-        return (*this)[static_cast<size_t>(index)];
+        const auto &v = m_value.u_packed->m_doubles;
+        if (v.empty())
+        {
+            throw json_array_index_range_exception(json_exception::array_index_range_e, 0);
+        }
+        return packed_minimum(v.data(), v.size());
     }
     else
     {
-        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+        if (m_value.u_array->m_value.empty())
+        {
+            throw json_array_index_range_exception(json_exception::array_index_range_e, 0);
+        }
+        double res = m_value.u_array->m_value[0];
+        for (const auto &e : m_value.u_array->m_value)
+        {
+            double d = e;
+            res = d < res ? d : res;
+        }
+        return res;
     }
 }
 
-const json &json::operator[](const std::string &name) const
+double json::maximum() const
 {
-    const json_object& o = get_object();
-    auto i = o.find(name);
-    if (i == o.end())
+    ensure_type(array_e, json_exception::not_an_array_e);
+
+    if (m_packed && m_value.u_packed->m_element_type == number_int_e)
     {
-        throw json_invalid_key_exception(json_exception::invalid_key_e, name);
+        const auto &v = m_value.u_packed->m_ints;
+        if (v.empty())
+        {
+            throw json_array_index_range_exception(json_exception::array_index_range_e, 0);
+        }
+        return static_cast<double>(packed_maximum(v.data(), v.size()));
+    }
+    else if (m_packed)
+    {
+        const auto &v = m_value.u_packed->m_doubles;
+        if (v.empty())
+        {
+            throw json_array_index_range_exception(json_exception::array_index_range_e, 0);
+        }
+        return packed_maximum(v.data(), v.size());
     }
     else
     {
-        return (i->second);
+        if (m_value.u_array->m_value.empty())
+        {
+            throw json_array_index_range_exception(json_exception::array_index_range_e, 0);
+        }
+        double res = m_value.u_array->m_value[0];
+        for (const auto &e : m_value.u_array->m_value)
+        {
+            double d = e;
+            res = d > res ? d : res;
+        }
+        return res;
     }
 }
 
-const json &json::operator[](const char *name) const
-{
-    return (*this)[std::string(name)];
-}
+// strings
 
-const json &json::append(const json &j)
+void json::become_string(std::string s)
 {
-    json_array& a = get_array();
-    a.push_back(j);
-    return a.back();
+    m_type = string_e;
+    construct_string(std::move(s));
 }
 
-const json &json::append(std::unique_ptr<json> j)
+void json::destroy_string() noexcept
 {
-    return append(*j);
+    m_value.u_string.~basic_string();
 }
 
-const json &json::insert(const std::string &name, const json &j)
+void json::construct_string()
 {
-    json_object& o = get_object();
-    return o[name] = j;
+    new (&m_value.u_string) std::string;
 }
 
-const json &json::insert(const std::string &name, std::unique_ptr<json> j)
+void json::construct_string(std::string s)
 {
-    return insert(name, *j);
+    new (&m_value.u_string) std::string(std::move(s));
 }
 
-const char *json::get_instance_type_name() const
+void json::reset() noexcept
+{
+    switch (m_type)
+    {
+    case object_e:
+        if (m_shaped)
+        {
+            destroy_shaped();
+        }
+        else
+        {
+            destroy_object();
+        }
+        break;
+    case array_e:
+        if (m_packed)
+        {
+            destroy_packed();
+        }
+        else
+        {
+            destroy_array();
+        }
+        break;
+    case string_e:
+        destroy_string();
+        break;
+    default:
+        break;
+    }
+
+    m_type = null_e;
+    m_unsigned = false;
+    m_raw_value.clear();
+}
+
+void json::copy_json(const json &other, memory_resource *r)
+{
+    if (this == &other) return;
+
+    reset();
+    m_type = other.m_type;
+    m_raw_value = other.m_raw_value;
+
+    if (m_type == object_e && other.m_shaped)
+    {
+        copy_construct_shaped(*other.m_value.u_shaped, r);
+    }
+    else if (m_type == object_e && other.m_value.u_object->can_share(r))
+    {
+        m_value.u_object = other.m_value.u_object;
+        m_value.u_object->acquire();
+    }
+    else if (m_type == object_e)
+    {
+        copy_construct_object(other.m_value.u_object->m_value, r);
+    }
+    else if (m_type == array_e && other.m_packed)
+    {
+        copy_construct_packed(*other.m_value.u_packed, r);
+    }
+    else if (m_type == array_e && other.m_value.u_array->can_share(r))
+    {
+        m_value.u_array = other.m_value.u_array;
+        m_value.u_array->acquire();
+    }
+    else if (m_type == array_e)
+    {
+        copy_construct_array(other.m_value.u_array->m_value, r);
+    }
+    else if (m_type == string_e)
+    {
+        construct_string(other.m_value.u_string);
+    }
+    else if (m_type == boolean_e)
+    {
+        m_value.u_boolean = other.m_value.u_boolean;
+    }
+    else if (m_type == number_int_e)
+    {
+        m_value.u_number_int = other.m_value.u_number_int;
+        m_unsigned = other.m_unsigned;
+    }
+    else if (m_type == number_double_e)
+    {
+        m_value.u_number_double = other.m_value.u_number_double;
+    }
+}
+
+json::json(const json &other) : m_type(null_e)
+{
+    copy_json(other, nullptr);
+}
+
+json::json(const json &other, memory_resource *r) : m_type(null_e)
+{
+    copy_json(other, r);
+}
+
+json &json::operator=(const json &other)
+{
+    if (this != &other)
+    {
+        // copy first in case other is part of this instance
+        json tmp(other);
+        move_json(tmp);
+    }
+    return *this;
+}
+
+void json::move_json(json &other)
+{
+    if (this == &other) return;
+
+    reset();
+    m_type = other.m_type;
+    if (m_type == object_e && other.m_shaped)
+    {
+        m_value.u_shaped = other.m_value.u_shaped;
+        m_shaped = true;
+        other.m_shaped = false;
+        other.m_type = null_e;
+    }
+    else if (m_type == object_e)
+    {
+        m_value.u_object = other.m_value.u_object;
+        other.m_type = null_e;
+    }
+    else if (m_type == array_e && other.m_packed)
+    {
+        m_value.u_packed = other.m_value.u_packed;
+        m_packed = true;
+        other.m_packed = false;
+        other.m_type = null_e;
+    }
+    else if (m_type == array_e)
+    {
+        m_value.u_array = other.m_value.u_array;
+        other.m_type = null_e;
+    }
+    else if (m_type == string_e)
+    {
+        construct_string(std::move(other.m_value.u_string));
+    }
+    else if (m_type == boolean_e)
+    {
+        m_value.u_boolean = other.m_value.u_boolean;
+    }
+    else if (m_type == number_int_e)
+    {
+        m_value.u_number_int = other.m_value.u_number_int;
+        m_unsigned = other.m_unsigned;
+    }
+    else if (m_type == number_double_e)
+    {
+        m_value.u_number_double = other.m_value.u_number_double;
+    }
+
+    m_raw_value = std::move(other.m_raw_value);
+
+    other.reset();
+}
+
+json &json::operator=(json &&other) noexcept
+{
+    if (this != &other)
+    {
+        // take the value out of other first in case it is part of this instance
+        json tmp;
+        tmp.move_json(other);
+        move_json(tmp);
+    }
+    return *this;
+}
+
+json::json(json &&other) noexcept : m_type(null_e)
+{
+    move_json(other);
+}
+
+json::json(type t) : json(t, nullptr)
+{
+}
+
+json::json(type t, memory_resource *r) : m_type(t)
+{
+    switch (m_type)
+    {
+    case object_e:
+        construct_object(r);
+        break;
+    case array_e:
+        construct_array(r);
+        break;
+    case string_e:
+        construct_string();
+        break;
+    case boolean_e:
+        m_value.u_boolean = false;
+        break;
+    case number_int_e:
+        m_value.u_number_int = 0;
+        break;
+    case number_double_e:
+        m_value.u_number_double = 0;
+        break;
+    case null_e:
+        break;
+    default:
+        throw json_exception(json_exception::invalid_json_type_e);
+    }
+}
+
+json::json(type t, std::string raw_value) : m_type(t), m_raw_value(std::move(raw_value))
+{
+    if (t != string_e && t != number_int_e && t != number_double_e)
+    {
+        throw json_exception(json_exception::not_number_or_string_e, get_instance_type_name());
+    }
+
+    if (t == string_e)
+    {
+        construct_string();
+    }
+}
+
+json::json(int i) noexcept
+{
+    m_type = number_int_e;
+    m_value.u_number_int = i;
+}
+
+json::json(int64_t i) noexcept
+{
+    m_type = number_int_e;
+    m_value.u_number_int = i;
+}
+
+json::json(uint64_t i) noexcept
+{
+    // only values that don't fit in an int64_t are held unsigned
+    m_type = number_int_e;
+    m_unsigned = i > static_cast<uint64_t>(INT64_MAX);
+    m_value.u_number_uint = i;
+}
+
+json::json(double d) noexcept
+{
+    m_type = number_double_e;
+    m_value.u_number_double = d;
+}
+
+json::json(bool b) noexcept
+{
+    m_type = boolean_e;
+    m_value.u_boolean = b;
+}
+
+json::json(std::string s)
+{
+    become_string(std::move(s));
+}
+
+json::json(const char *s)
+{
+    become_string(s);
+}
+
+json::json(null_t) noexcept : m_type(null_e)
+{
+}
+
+json::json(std::unique_ptr<std::string> s)
+{
+    become_string(*s);
+}
+
+json &json::operator=(int i)
+{
+    reset();
+    m_type = number_int_e;
+    m_value.u_number_int = i;
+    return *this;
+}
+
+json &json::operator=(int64_t i)
+{
+    reset();
+    m_type = number_int_e;
+    m_value.u_number_int = i;
+    return *this;
+}
+
+json &json::operator=(uint64_t i)
+{
+    reset();
+    m_type = number_int_e;
+    m_unsigned = i > static_cast<uint64_t>(INT64_MAX);
+    m_value.u_number_uint = i;
+    return *this;
+}
+
+json &json::operator=(double d)
+{
+    reset();
+    m_type = number_double_e;
+    m_value.u_number_double = d;
+    return *this;
+}
+
+json &json::operator=(bool b)
+{
+    reset();
+    m_type = boolean_e;
+    m_value.u_boolean = b;
+    return *this;
+}
+
+json &json::operator=(std::string s)
+{
+    reset();
+    become_string(std::move(s));
+    return *this;
+}
+
+json &json::operator=(const char *s)
+{
+    reset();
+    become_string(s);
+    return *this;
+}
+
+json &json::operator=(std::unique_ptr<std::string> s)
+{
+    reset();
+    become_string(*s);
+    return *this;
+}
+
+json &json::operator=(const json::json_object &o)
+{
+    json tmp;
+    tmp.copy_construct_object(o, nullptr);
+    tmp.m_type = object_e;
+    move_json(tmp);
+    return *this;
+}
+
+json &json::operator=(json_object &&o)
+{
+    // take the map out first in case it is part of this instance
+    json tmp = from_object(std::move(o));
+    move_json(tmp);
+    return *this;
+}
+
+json &json::operator=(const json_array &a)
+{
+    json tmp;
+    tmp.copy_construct_array(a, nullptr);
+    tmp.m_type = array_e;
+    move_json(tmp);
+    return *this;
+}
+
+json &json::operator=(json_array &&a)
+{
+    json tmp = from_array(std::move(a));
+    move_json(tmp);
+    return *this;
+}
+
+json &json::operator=(null_t)
+{
+    reset();
+    m_type = null_e;
+    return *this;
+}
+
+json json::from_object(json_object o)
+{
+    json j;
+    j.m_type = object_e;
+    j.move_construct_object(std::move(o));
+    return j;
+}
+
+json json::from_array(json_array a)
+{
+    json j;
+    j.m_type = array_e;
+    j.move_construct_array(std::move(a));
+    return j;
+}
+
+json::type json::get_instance_type() const
+{
+    return m_type;
+}
+
+memory_resource *json::get_memory_resource() const
+{
+    switch (m_type)
+    {
+    case object_e:
+        return m_shaped ? m_value.u_shaped->m_resource : m_value.u_object->m_value.get_allocator().resource();
+    case array_e:
+        return m_packed ? m_value.u_packed->m_resource : m_value.u_array->m_value.get_allocator().resource();
+    default:
+        return new_delete_resource();
+    }
+}
+
+json::json_array &json::get_array()
+{
+    json_array &a = array_for_update();
+    m_value.u_array->m_shareable = false;
+    return a;
+}
+
+const json::json_array &json::get_array() const
+{
+    ensure_type(array_e, json_exception::not_an_array_e);
+    return array_view();
+}
+
+json::json_object &json::get_object()
+{
+    json_object &o = object_for_update();
+    m_value.u_object->m_shareable = false;
+    return o;
+}
+
+size_t json::size() const noexcept
+{
+    switch (m_type)
+    {
+    case array_e:
+        return m_packed ? m_value.u_packed->size() : m_value.u_array->m_value.size();
+    case object_e:
+        return m_shaped ? m_value.u_shaped->m_values.size() : m_value.u_object->m_value.size();
+    default:
+        return 0;
+    }
+}
+
+const json::json_object &json::get_object() const
+{
+    ensure_type(object_e, json_exception::not_an_object_e);
+    return object_view();
+}
+
+bool json::has(const std::string &name) const
+{
+    ensure_type(object_e, json_exception::not_an_object_e);
+    return find_member(name) != nullptr;
+}
+
+const std::string &json::get_raw_value() const
+{
+    return m_raw_value;
+}
+
+bool json::convert(int &value) const noexcept
+{
+    int64_t i;
+    if (m_type == number_int_e && !convert(i))
+    {
+        return false;
+    }
+    else if (m_type == number_int_e)
+    {
+        if (i < INT_MIN || i > INT_MAX)
+        {
+            return false;
+        }
+        value = static_cast<int>(i);
+        return true;
+    }
+    else if (m_type == number_double_e && m_raw_value.size() == 0)
+    {
+        value = static_cast<int>(m_value.u_number_double);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool json::convert(int64_t &value) const noexcept
+{
+    if (m_raw_value.size() > 0)
+    {
+        return false;
+    }
+    else if (m_type == number_int_e && !m_unsigned)
+    {
+        value = m_value.u_number_int;
+        return true;
+    }
+    else if (m_type == number_double_e)
+    {
+        value = static_cast<int64_t>(m_value.u_number_double);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool json::convert(uint64_t &value) const noexcept
+{
+    if (m_raw_value.size() > 0)
+    {
+        return false;
+    }
+    else if (m_type == number_int_e && (m_unsigned || m_value.u_number_int >= 0))
+    {
+        value = m_value.u_number_uint;
+        return true;
+    }
+    else if (m_type == number_double_e)
+    {
+        value = static_cast<uint64_t>(m_value.u_number_double);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool json::convert(double &value) const noexcept
+{
+    if (m_raw_value.size() > 0)
+    {
+        return false;
+    }
+    else if (m_type == number_double_e)
+    {
+        value = m_value.u_number_double;
+        return true;
+    }
+    else if (m_type == number_int_e && m_unsigned)
+    {
+        value = static_cast<double>(m_value.u_number_uint);
+        return true;
+    }
+    else if (m_type == number_int_e)
+    {
+        value = static_cast<double>(m_value.u_number_int);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool json::convert(bool &value) const noexcept
+{
+    if (m_type == boolean_e)
+    {
+        value = m_value.u_boolean;
+        return true;
+    }
+    else if (m_type == number_int_e)
+    {
+        value = m_value.u_number_uint != 0;
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+void json::cast_failed() const
+{
+    if (m_raw_value.size() > 0)
+    {
+        throw json_exception(json_exception::cant_cast_raw_e);
+    }
+    else if (m_type == number_int_e)
+    {
+        throw json_exception(json_exception::number_out_of_range_e);
+    }
+    else
+    {
+        throw json_exception(json_exception::not_number_e, get_instance_type_name());
+    }
+}
+
+json::operator int() const
+{
+    int res;
+    if (!convert(res))
+    {
+        cast_failed();
+    }
+    return res;
+}
+
+json::operator int64_t() const
+{
+    int64_t res;
+    if (!convert(res))
+    {
+        cast_failed();
+    }
+    return res;
+}
+
+json::operator uint64_t() const
+{
+    uint64_t res;
+    if (!convert(res))
+    {
+        cast_failed();
+    }
+    return res;
+}
+
+bool json::is_uint64() const noexcept
+{
+    return m_type == number_int_e && m_unsigned;
+}
+
+json::operator double() const
+{
+    double res;
+    if (!convert(res))
+    {
+        cast_failed();
+    }
+    return res;
+}
+
+json::operator const std::string&() const
+{
+    const std::string *res = get_if<std::string>();
+    if (res != nullptr)
+    {
+        return *res;
+    }
+    else if (m_raw_value.size() > 0)
+    {
+        throw json_exception(json_exception::cant_cast_raw_e);
+    }
+    else
+    {
+        throw json_exception(json_exception::not_string_e, get_instance_type_name());
+    }
+}
+
+json::operator bool() const
+{
+    bool res;
+    if (!convert(res))
+    {
+        throw json_exception(json_exception::not_number_int_or_boolean_e, get_instance_type_name());
+    }
+    return res;
+}
+
+template <>
+const bool *NAMESPACE::json::get_if<bool>() const noexcept
+{
+    return m_type == boolean_e ? &m_value.u_boolean : nullptr;
+}
+
+template <>
+const int64_t *NAMESPACE::json::get_if<int64_t>() const noexcept
+{
+    return m_type == number_int_e && !m_unsigned && m_raw_value.size() == 0 ? &m_value.u_number_int : nullptr;
+}
+
+template <>
+const uint64_t *NAMESPACE::json::get_if<uint64_t>() const noexcept
+{
+    return m_type == number_int_e && (m_unsigned || m_value.u_number_int >= 0) && m_raw_value.size() == 0 ?
+                &m_value.u_number_uint : nullptr;
+}
+
+template <>
+const double *NAMESPACE::json::get_if<double>() const noexcept
+{
+    return m_type == number_double_e && m_raw_value.size() == 0 ? &m_value.u_number_double : nullptr;
+}
+
+template <>
+const std::string *NAMESPACE::json::get_if<std::string>() const noexcept
+{
+    return m_type == string_e && m_raw_value.size() == 0 ? &m_value.u_string : nullptr;
+}
+
+template <>
+int NAMESPACE::json::value_or<int>(int fallback) const
+{
+    int res;
+    return convert(res) ? res : fallback;
+}
+
+template <>
+int64_t NAMESPACE::json::value_or<int64_t>(int64_t fallback) const
+{
+    int64_t res;
+    return convert(res) ? res : fallback;
+}
+
+template <>
+uint64_t NAMESPACE::json::value_or<uint64_t>(uint64_t fallback) const
+{
+    uint64_t res;
+    return convert(res) ? res : fallback;
+}
+
+template <>
+double NAMESPACE::json::value_or<double>(double fallback) const
+{
+    double res;
+    return convert(res) ? res : fallback;
+}
+
+template <>
+bool NAMESPACE::json::value_or<bool>(bool fallback) const
+{
+    bool res;
+    return convert(res) ? res : fallback;
+}
+
+template <>
+std::string NAMESPACE::json::value_or<std::string>(std::string fallback) const
+{
+    const std::string *res = get_if<std::string>();
+    return res != nullptr ? *res : fallback;
+}
+
+template <>
+const char *NAMESPACE::json::value_or<const char *>(const char *fallback) const
+{
+    const std::string *res = get_if<std::string>();
+    return res != nullptr ? res->c_str() : fallback;
+}
+
+const json *json::try_get(const std::string &name) const
+{
+    return m_type == object_e ? find_member(name) : nullptr;
+}
+
+const json *json::try_get(size_t index) const
+{
+    if (m_type != array_e || index >= size())
+    {
+        return nullptr;
+    }
+    return m_packed ? &packed_element(index) : &m_value.u_array->m_value[index];
+}
+
+json &json::operator[](const std::string &name)
+{
+    json_object& o = get_object();
+    return o[name];
+}
+
+json &json::operator[](const char *name)
+{
+    return (*this)[std::string(name)];
+}
+
+json &json::operator[](size_t index)
+{
+    json_array& a = get_array();
+    if (index < a.size())
+    {
+        return (a)[index];
+    }
+    else
+    {
+        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+    }
+}
+
+json &json::operator[](int index)
+{
+    if (index >= 0)
+    {
+        return (*this)[static_cast<size_t>(index)];
+    }
+    else
+    {
+        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+    }
+}
+
+const json &json::operator[](size_t index) const
+{
+    const json *res = try_get(index);
+    if (res == nullptr)
+    {
+        ensure_type(array_e, json_exception::not_an_array_e);
+        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+    }
+    return *res;
+}
+
+const json &json::operator[](int index) const
+{
+    if (index >= 0)
+    {
+        return (*this)[static_cast<size_t>(index)];
+    }
+    else
+    {
+        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+    }
+}
+
+const json &json::operator[](const std::string &name) const
+{
+    const json *res = try_get(name);
+    if (res == nullptr)
+    {
+        ensure_type(object_e, json_exception::not_an_object_e);
+        throw json_invalid_key_exception(json_exception::invalid_key_e, name);
+    }
+    return *res;
+}
+
+const json &json::operator[](const char *name) const
+{
+    return (*this)[std::string(name)];
+}
+
+const json &json::append(const json &j)
+{
+    json_array& a = array_for_update();
+    a.push_back(j);
+    return a.back();
+}
+
+const json &json::append(json &&j)
+{
+    json_array& a = array_for_update();
+    a.push_back(std::move(j));
+    return a.back();
+}
+
+const json &json::append(std::unique_ptr<json> j)
+{
+    return append(std::move(*j));
+}
+
+const json &json::insert(const std::string &name, const json &j)
+{
+    json_object& o = object_for_update();
+    return o[name] = j;
+}
+
+const json &json::insert(const std::string &name, json &&j)
+{
+    json_object& o = object_for_update();
+    return o[name] = std::move(j);
+}
+
+const json &json::insert(std::string &&name, json &&j)
+{
+    json_object& o = object_for_update();
+    return o[std::move(name)] = std::move(j);
+}
+
+const json &json::insert(const std::string &name, std::unique_ptr<json> j)
+{
+    return insert(name, std::move(*j));
+}
+
+const char *json::get_instance_type_name() const
 {
     switch (m_type)
     {
     case object_e:
         return "object";
     case array_e:
-        return "array";
+        return "array";
+    case boolean_e:
+        return "boolean";
+    case null_e:
+        return "null";
+    case number_int_e:
+        return "number (int)";
+    case number_double_e:
+        return "number (double)";
+    case string_e:
+        return "string";
+    default:
+        return "corrupted";
+    }
+}
+
+bool json::number_equal(const json &other) const
+{
+    if (m_raw_value.size() == 0 && other.m_raw_value.size() == 0)
+    {
+        if (m_type == number_int_e)
+        {
+            return m_unsigned == other.m_unsigned &&
+                   m_value.u_number_int == other.m_value.u_number_int;
+        }
+        else
+        {
+            // Will only work if they are exactly the same in all bits.
+            return m_value.u_number_double == other.m_value.u_number_double;
+        }
+    }
+    else
+    {
+        throw json_exception(json_exception::cant_compare_raw_e);
+    }
+}
+
+int json::compare_int(int64_t i) const
+{
+    if (m_raw_value.size() > 0)
+    {
+        throw json_exception(json_exception::cant_cast_raw_e);
+    }
+    else if (m_type == number_int_e)
+    {
+        if (m_unsigned || m_value.u_number_int > i)
+        {
+            return 1;
+        }
+        return m_value.u_number_int < i ? -1 : 0;
+    }
+    else
+    {
+        // doubles are truncated as for the int cast
+        int64_t v = static_cast<int64_t>(*this);
+        return v < i ? -1 : (v > i ? 1 : 0);
+    }
+}
+
+int json::compare_int(uint64_t i) const
+{
+    if (i <= static_cast<uint64_t>(INT64_MAX))
+    {
+        return compare_int(static_cast<int64_t>(i));
+    }
+    else if (m_raw_value.size() > 0)
+    {
+        throw json_exception(json_exception::cant_cast_raw_e);
+    }
+    else if (m_type == number_int_e && m_unsigned)
+    {
+        return m_value.u_number_uint < i ? -1 : (m_value.u_number_uint > i ? 1 : 0);
+    }
+    else if (m_type == number_double_e)
+    {
+        double d = static_cast<double>(i);
+        return m_value.u_number_double < d ? -1 : (m_value.u_number_double > d ? 1 : 0);
+    }
+    else if (m_type == number_int_e)
+    {
+        return -1;
+    }
+    else
+    {
+        throw json_exception(json_exception::not_number_e, get_instance_type_name());
+    }
+}
+
+int json::compare_int(const json &other) const
+{
+    if (other.m_unsigned)
+    {
+        return compare_int(other.m_value.u_number_uint);
+    }
+    else
+    {
+        return compare_int(other.m_value.u_number_int);
+    }
+}
+
+bool json::string_equal(const json &other) const
+{
+    if (m_raw_value.size() == 0 && other.m_raw_value.size() == 0)
+    {
+        return m_value.u_string == other.m_value.u_string;
+    }
+    else
+    {
+        throw json_exception(json_exception::cant_compare_raw_e);
+    }
+}
+
+bool json::object_equal(const json &other) const
+{
+    if (m_shaped && other.m_shaped)
+    {
+        const shaped_object &a = *m_value.u_shaped;
+        const shaped_object &b = *other.m_value.u_shaped;
+
+        if (a.m_shape == b.m_shape || a.m_shape->get_names() == b.m_shape->get_names())
+        {
+            return &a == &b || a.m_values == b.m_values;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (m_shaped || other.m_shaped)
+    {
+        // shape names are sorted like the map's keys so the two walk in
+        // step, neither side needs a view
+        const shaped_object &a = m_shaped ? *m_value.u_shaped : *other.m_value.u_shaped;
+        const json_object &b = m_shaped ? other.m_value.u_object->m_value : m_value.u_object->m_value;
+        const std::vector<std::string> &names = a.m_shape->get_names();
+
+        if (names.size() != b.size())
+        {
+            return false;
+        }
+
+        size_t i = 0;
+        for (const auto &member : b)
+        {
+            if (member.first != names[i] || member.second != a.m_values[i])
+            {
+                return false;
+            }
+            i++;
+        }
+        return true;
+    }
+
+    const json_object &a = m_value.u_object->m_value;
+    const json_object &b = other.m_value.u_object->m_value;
+
+    return &a == &b || (a.size() == b.size() && equal(a.begin(), a.end(), b.begin()));
+}
+
+bool json::array_equal(const json &other) const
+{
+    if (m_packed && other.m_packed &&
+        m_value.u_packed->m_element_type == other.m_value.u_packed->m_element_type)
+    {
+        return m_value.u_packed->m_ints == other.m_value.u_packed->m_ints &&
+               m_value.u_packed->m_doubles == other.m_value.u_packed->m_doubles;
+    }
+
+    if (m_packed || other.m_packed)
+    {
+        // element by element so that neither side needs a view
+        size_t n = size();
+        if (n != other.size())
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            bool same = m_packed && other.m_packed ?
+                            m_value.u_packed->value(i) == other.m_value.u_packed->value(i) :
+                        m_packed ?
+                            m_value.u_packed->value(i) == other.m_value.u_array->m_value[i] :
+                            m_value.u_array->m_value[i] == other.m_value.u_packed->value(i);
+            if (!same)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const json_array &a = array_view();
+    const json_array &b = other.array_view();
+
+    return &a == &b || (a.size() == b.size() && equal(a.begin(), a.end(), b.begin()));
+}
+
+bool json::operator==(const json &other) const
+{
+    size_t h1 = cached_hash();
+    size_t h2 = other.cached_hash();
+
+    if (h1 != 0 && h2 != 0 && h1 != h2)
+    {
+        return false;
+    }
+
+    if (m_type == other.m_type)
+    {
+        switch (m_type)
+        {
+        case object_e:
+            return object_equal(other);
+        case array_e:
+            return array_equal(other);
+        case boolean_e:
+            return m_value.u_boolean == other.m_value.u_boolean;
+        case null_e:
+            return true;
+        case number_int_e:
+            return number_equal(other);
+        case number_double_e:
+            return number_equal(other);
+        case string_e:
+            return string_equal(other);
+        default:
+            throw json_exception(json_exception::invalid_json_type_e);
+        }
+    }
+    else if ((m_type == number_int_e && other.m_type == number_double_e) ||
+             (m_type == number_double_e && other.m_type == number_int_e))
+    {
+        return static_cast<double>(*this) == static_cast<double>(other);
+    }
+    else
+    {
+        return false;
+    }
+}
+
+
+bool json::operator!=(const json &other) const
+{
+    return !(*this == other);
+}
+
+bool json::operator==(bool b) const
+{
+    return static_cast<bool>(*this) == b;
+}
+
+bool json::operator==(int i) const
+{
+    return compare_int(static_cast<int64_t>(i)) == 0;
+}
+
+bool json::operator==(int64_t i) const
+{
+    return compare_int(i) == 0;
+}
+
+bool json::operator==(uint64_t i) const
+{
+    return compare_int(i) == 0;
+}
+
+bool json::operator==(double d) const
+{
+    return static_cast<double>(*this) == d;
+}
+
+bool json::operator==(const std::string &s) const
+{
+    return static_cast<std::string>(*this) == s;
+}
+
+bool json::operator==(const char *s) const
+{
+    return static_cast<std::string>(*this) == s;
+}
+
+bool json::operator!=(int i) const
+{
+    return compare_int(static_cast<int64_t>(i)) != 0;
+}
+
+bool json::operator!=(int64_t i) const
+{
+    return compare_int(i) != 0;
+}
+
+bool json::operator!=(uint64_t i) const
+{
+    return compare_int(i) != 0;
+}
+
+bool json::operator!=(double d) const
+{
+    return static_cast<double>(*this) != d;
+}
+
+bool json::operator!=(const std::string &s) const
+{
+    return static_cast<std::string>(*this) != s;
+}
+
+bool json::operator!=(const char *s) const
+{
+    return static_cast<std::string>(*this) != s;
+}
+
+bool json::operator<(int i) const
+{
+    return compare_int(static_cast<int64_t>(i)) < 0;
+}
+
+bool json::operator<(int64_t i) const
+{
+    return compare_int(i) < 0;
+}
+
+bool json::operator<(uint64_t i) const
+{
+    return compare_int(i) < 0;
+}
+
+bool json::operator<(double d) const
+{
+    return static_cast<double>(*this) < d;
+}
+
+bool json::operator<(const std::string &s) const
+{
+    return static_cast<std::string>(*this) < s;
+}
+
+bool json::operator<(const char *s) const
+{
+    return static_cast<std::string>(*this) < s;
+}
+
+bool json::operator<=(int i) const
+{
+    return compare_int(static_cast<int64_t>(i)) <= 0;
+}
+
+bool json::operator<=(int64_t i) const
+{
+    return compare_int(i) <= 0;
+}
+
+bool json::operator<=(uint64_t i) const
+{
+    return compare_int(i) <= 0;
+}
+
+bool json::operator<=(double d) const
+{
+    return static_cast<double>(*this) <= d;
+}
+
+bool json::operator<=(const std::string &s) const
+{
+    return static_cast<std::string>(*this) < s;
+}
+
+bool json::operator<=(const char *s) const
+{
+    return static_cast<std::string>(*this) <= s;
+}
+
+bool json::operator>(int i) const
+{
+    return compare_int(static_cast<int64_t>(i)) > 0;
+}
+
+bool json::operator>(int64_t i) const
+{
+    return compare_int(i) > 0;
+}
+
+bool json::operator>(uint64_t i) const
+{
+    return compare_int(i) > 0;
+}
+
+bool json::operator>(double d) const
+{
+    return static_cast<double>(*this) > d;
+}
+
+bool json::operator>(const std::string &s) const
+{
+    return static_cast<std::string>(*this) > s;
+}
+
+bool json::operator>(const char *s) const
+{
+    return static_cast<std::string>(*this) > s;
+}
+
+bool json::operator>=(int i) const
+{
+    return compare_int(static_cast<int64_t>(i)) >= 0;
+}
+
+bool json::operator>=(int64_t i) const
+{
+    return compare_int(i) >= 0;
+}
+
+bool json::operator>=(uint64_t i) const
+{
+    return compare_int(i) >= 0;
+}
+
+bool json::operator>=(double d) const
+{
+    return static_cast<double>(*this) >= d;
+}
+
+bool json::operator>=(const std::string &s) const
+{
+    return static_cast<std::string>(*this) >= s;
+}
+
+bool json::operator>=(const char *s) const
+{
+    return static_cast<std::string>(*this) >= s;
+}
+
+bool json::operator<(const json &other) const
+{
+    if (m_type == string_e && other.m_type == string_e)
+    {
+        return static_cast<std::string>(*this) < static_cast<std::string>(other);
+    }
+    else if (m_type == number_int_e && other.m_type == number_int_e)
+    {
+        return compare_int(other) < 0;
+    }
+    else if ((m_type == number_double_e && other.m_type == number_double_e) ||
+             (m_type == number_double_e && other.m_type == number_int_e) ||
+             (m_type == number_int_e && other.m_type == number_double_e))
+    {
+        return static_cast<double>(*this) < static_cast<double>(other);
+    }
+    else
+    {
+        throw json_exception(
+                        json_exception::types_not_comparable_e,
+                        get_instance_type_name(),
+                        other.get_instance_type_name());
+    }
+}
+
+bool json::operator<=(const json &other) const
+{
+    if (m_type == string_e && other.m_type == string_e)
+    {
+        return static_cast<std::string>(*this) <= static_cast<std::string>(other);
+    }
+    else if (m_type == number_int_e && other.m_type == number_int_e)
+    {
+        return compare_int(other) <= 0;
+    }
+    else if ((m_type == number_double_e && other.m_type == number_double_e) ||
+             (m_type == number_double_e && other.m_type == number_int_e) ||
+             (m_type == number_int_e && other.m_type == number_double_e))
+    {
+        return static_cast<double>(*this) <= static_cast<double>(other);
+    }
+    else
+    {
+        throw json_exception(
+                        json_exception::types_not_comparable_e,
+                        get_instance_type_name(),
+                        other.get_instance_type_name());
+    }
+}
+
+bool json::operator>(const json &other) const
+{
+    return !(*this <= other);
+}
+
+bool json::operator>=(const json &other) const
+{
+    return !(*this < other);
+}
+
+// hashing
+
+// FNV-1a and the splitmix64 finaliser rather than std::hash so that the
+// result is the same everywhere.
+
+static uint64_t hash_bytes(const char *s, size_t n, uint64_t h = 14695981039346656037ULL)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        h = (h ^ static_cast<unsigned char>(s[i])) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t hash_mix(uint64_t h)
+{
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+static uint64_t hash_combine(uint64_t h, uint64_t v)
+{
+    return hash_mix(h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+}
+
+// Ints and doubles that compare equal have to hash the same.
+static uint64_t hash_number(double d)
+{
+    uint64_t bits = 0;
+    if (d != 0)
+    {
+        memcpy(&bits, &d, sizeof(bits));
+    }
+    return hash_mix(bits ^ json::number_int_e);
+}
+
+size_t json::cached_hash() const noexcept
+{
+    if (m_type == object_e && m_shaped)
+    {
+        return m_value.u_shaped->m_hash.load(std::memory_order_relaxed);
+    }
+    else if (m_type == object_e)
+    {
+        return m_value.u_object->m_hash.load(std::memory_order_relaxed);
+    }
+    else if (m_type == array_e && m_packed)
+    {
+        return m_value.u_packed->m_hash.load(std::memory_order_relaxed);
+    }
+    else if (m_type == array_e)
+    {
+        return m_value.u_array->m_hash.load(std::memory_order_relaxed);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+size_t json::hash() const
+{
+    size_t h = cached_hash();
+
+    if (h != 0)
+    {
+        return h;
+    }
+
+    uint64_t res = hash_mix(m_type + 1);
+
+    if (m_raw_value.size() > 0)
+    {
+        return static_cast<size_t>(hash_bytes(m_raw_value.data(), m_raw_value.size(), res));
+    }
+
+    switch (m_type)
+    {
+    case object_e:
+        if (m_shaped)
+        {
+            const auto &names = m_value.u_shaped->m_shape->get_names();
+            for (size_t i = 0; i < names.size(); i++)
+            {
+                res = hash_combine(res, hash_bytes(names[i].data(), names[i].size()));
+                res = hash_combine(res, m_value.u_shaped->m_values[i].hash());
+            }
+        }
+        else
+        {
+            for (const auto &p : m_value.u_object->m_value)
+            {
+                res = hash_combine(res, hash_bytes(p.first.data(), p.first.size()));
+                res = hash_combine(res, p.second.hash());
+            }
+        }
+        break;
+    case array_e:
+        if (m_packed && m_value.u_packed->m_element_type == number_int_e)
+        {
+            for (auto i : m_value.u_packed->m_ints)
+            {
+                res = hash_combine(res, hash_number(static_cast<double>(i)));
+            }
+        }
+        else if (m_packed)
+        {
+            for (auto d : m_value.u_packed->m_doubles)
+            {
+                res = hash_combine(res, hash_number(d));
+            }
+        }
+        else
+        {
+            for (const auto &e : m_value.u_array->m_value)
+            {
+                res = hash_combine(res, e.hash());
+            }
+        }
+        break;
     case boolean_e:
-        return "boolean";
+        res = hash_combine(res, m_value.u_boolean);
+        break;
     case null_e:
-        return "null";
+        break;
     case number_int_e:
-        return "number (int)";
     case number_double_e:
-        return "number (double)";
+        return static_cast<size_t>(hash_number(static_cast<double>(*this)));
     case string_e:
-        return "string";
+        res = hash_bytes(m_value.u_string.data(), m_value.u_string.size(), res);
+        break;
     default:
-        return "corrupted";
+        throw json_exception(json_exception::invalid_json_type_e);
+    }
+
+    // 0 means not cached
+    h = res == 0 ? 1 : static_cast<size_t>(res);
+
+    if (m_type == object_e && m_shaped)
+    {
+        m_value.u_shaped->m_hash.store(h, std::memory_order_relaxed);
+    }
+    else if (m_type == object_e && m_value.u_object->m_shareable)
+    {
+        m_value.u_object->m_hash.store(h, std::memory_order_relaxed);
+    }
+    else if (m_type == array_e && m_packed)
+    {
+        m_value.u_packed->m_hash.store(h, std::memory_order_relaxed);
+    }
+    else if (m_type == array_e && m_value.u_array->m_shareable)
+    {
+        m_value.u_array->m_hash.store(h, std::memory_order_relaxed);
     }
+
+    return h;
 }
 
-bool json::number_equal(const json &other) const
+// deduplication
+
+/**
+ * The objects and arrays kept by deduplicate(), by hash. They are copies, and
+ * so share storage with, the first instance of each distinct object or array.
+ */
+struct json::dedup_table
 {
-    if (m_raw_value.size() == 0 && other.m_raw_value.size() == 0)
+    std::unordered_multimap<size_t, json> m_objects;
+    std::unordered_multimap<size_t, json> m_arrays;
+};
+
+size_t json::deduplicate()
+{
+    dedup_table seen;
+    size_t count = 0;
+    deduplicate(seen, count);
+    return count;
+}
+
+void json::deduplicate(dedup_table &seen, size_t &count)
+{
+    if (m_type != object_e && m_type != array_e)
     {
-        if (m_type == number_int_e)
+        return;
+    }
+
+    // Children first so that identical parents are made of identical (and
+    // already shared) children. Storage that is already shared is left as
+    // it is rather than being cloned just to look inside it.
+    if (m_type == object_e && m_shaped)
+    {
+        if (m_value.u_shaped->m_refs.load(std::memory_order_acquire) == 1)
+        {
+            for (auto &v : m_value.u_shaped->m_values)
+            {
+                v.deduplicate(seen, count);
+            }
+        }
+    }
+    else if (m_type == object_e && !m_value.u_object->is_shared())
+    {
+        for (auto &p : m_value.u_object->m_value)
         {
-            return m_value.u_number_int == other.m_value.u_number_int;
+            p.second.deduplicate(seen, count);
         }
-        else
+    }
+    else if (m_type == array_e && !m_packed && !m_value.u_array->is_shared())
+    {
+        for (auto &e : m_value.u_array->m_value)
         {
-            // Will only work if they are exactly the same in all bits.
-            return m_value.u_number_double == other.m_value.u_number_double;
+            e.deduplicate(seen, count);
         }
     }
-    else
+
+    if ((m_type == object_e && !m_shaped && !m_value.u_object->m_shareable) ||
+        (m_type == array_e && !m_packed && !m_value.u_array->m_shareable))
     {
-        throw json_exception(json_exception::cant_compare_raw_e);
+        return;
+    }
+
+    auto &table = m_type == object_e ? seen.m_objects : seen.m_arrays;
+    size_t h = hash();
+    auto range = table.equal_range(h);
+
+    for (auto i = range.first; i != range.second; ++i)
+    {
+        const json &kept = i->second;
+
+        if (*kept.get_memory_resource() == *get_memory_resource() && identical(kept))
+        {
+            bool already_shared = m_shaped ? kept.m_shaped && m_value.u_shaped == kept.m_value.u_shaped :
+                                  m_type == object_e ? !kept.m_shaped && m_value.u_object == kept.m_value.u_object :
+                                  m_packed ? kept.m_packed && m_value.u_packed == kept.m_value.u_packed :
+                                  !kept.m_packed && m_value.u_array == kept.m_value.u_array;
+
+            if (!already_shared)
+            {
+                copy_json(kept, get_memory_resource());
+                count++;
+            }
+            return;
+        }
     }
+
+    json &kept = table.emplace(h, json())->second;
+    kept.copy_json(*this, get_memory_resource());
 }
 
-bool json::string_equal(const json &other) const
+bool json::identical(const json &other) const
 {
-    if (m_raw_value.size() == 0 && other.m_raw_value.size() == 0)
+    if (m_type != other.m_type || m_raw_value != other.m_raw_value)
     {
-        return m_value.u_string == other.m_value.u_string;
+        return false;
     }
-    else
+
+    switch (m_type)
     {
-        throw json_exception(json_exception::cant_compare_raw_e);
+    case object_e:
+        if (m_shaped != other.m_shaped)
+        {
+            return false;
+        }
+        else if (m_shaped)
+        {
+            const shaped_object &a = *m_value.u_shaped;
+            const shaped_object &b = *other.m_value.u_shaped;
+
+            if (&a == &b)
+            {
+                return true;
+            }
+            else if (a.m_shape != b.m_shape && a.m_shape->get_names() != b.m_shape->get_names())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < a.m_values.size(); i++)
+            {
+                if (!a.m_values[i].identical(b.m_values[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        else
+        {
+            const json_object &a = m_value.u_object->m_value;
+            const json_object &b = other.m_value.u_object->m_value;
+
+            if (&a == &b)
+            {
+                return true;
+            }
+            else if (a.size() != b.size())
+            {
+                return false;
+            }
+
+            for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+            {
+                if (i->first != j->first || !i->second.identical(j->second))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    case array_e:
+        if (m_packed != other.m_packed)
+        {
+            return false;
+        }
+        else if (m_packed)
+        {
+            const packed_array &a = *m_value.u_packed;
+            const packed_array &b = *other.m_value.u_packed;
+
+            return &a == &b ||
+                   (a.m_element_type == b.m_element_type &&
+                    a.m_ints == b.m_ints &&
+                    a.m_doubles.size() == b.m_doubles.size() &&
+                    (a.m_doubles.empty() ||
+                     memcmp(a.m_doubles.data(), b.m_doubles.data(), a.m_doubles.size() * sizeof(double)) == 0));
+        }
+        else
+        {
+            const json_array &a = m_value.u_array->m_value;
+            const json_array &b = other.m_value.u_array->m_value;
+
+            if (&a == &b)
+            {
+                return true;
+            }
+            else if (a.size() != b.size())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < a.size(); i++)
+            {
+                if (!a[i].identical(b[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    case boolean_e:
+        return m_value.u_boolean == other.m_value.u_boolean;
+    case number_int_e:
+        return m_raw_value.size() > 0 ||
+               (m_unsigned == other.m_unsigned && m_value.u_number_int == other.m_value.u_number_int);
+    case number_double_e:
+        // bit for bit so that 0.0 and -0.0 aren't merged
+        return m_raw_value.size() > 0 ||
+               memcmp(&m_value.u_number_double, &other.m_value.u_number_double, sizeof(double)) == 0;
+    case string_e:
+        return m_raw_value.size() > 0 || m_value.u_string == other.m_value.u_string;
+    default:
+        return true;
     }
 }
 
-bool json::object_equal(const json &other) const
+// recycling
+
+json::recycler::recycler(memory_resource *r) :
+                        m_resource(r ? r : new_delete_resource()),
+                        m_next_string(0),
+                        m_next_array(0),
+                        m_next_array_node(0),
+                        m_next_shaped(0),
+                        m_next_packed(0)
 {
-    return m_value.u_object.size() == other.m_value.u_object.size() &&
-            equal(
-                m_value.u_object.begin(),
-                m_value.u_object.end(),
-                other.m_value.u_object.begin());
 }
 
-bool json::array_equal(const json &other) const
+json::recycler::~recycler()
 {
-    return m_value.u_array.size() == other.m_value.u_array.size() &&
-            equal(
-                m_value.u_array.begin(),
-                m_value.u_array.end(),
-                other.m_value.u_array.begin());
+    clear();
 }
 
-bool json::operator==(const json &other) const
+void json::recycler::recycle(json &&j)
 {
-    if (m_type == other.m_type)
+    clear();
+    take_apart(j);
+}
+
+void json::recycler::clear() noexcept
+{
+    // Spare storage is handed back to a json instance so that it is freed in
+    // the usual way.
+    json tmp;
+
+    for (size_t i = m_next_array_node; i < m_array_nodes.size(); i++)
     {
-        switch (m_type)
+        tmp.m_type = array_e;
+        tmp.m_value.u_array = m_array_nodes[i];
+        tmp.reset();
+    }
+    for (size_t i = m_next_shaped; i < m_shaped.size(); i++)
+    {
+        tmp.m_type = object_e;
+        tmp.m_value.u_shaped = m_shaped[i];
+        tmp.m_shaped = true;
+        tmp.reset();
+    }
+    for (size_t i = m_next_packed; i < m_packed.size(); i++)
+    {
+        tmp.m_type = array_e;
+        tmp.m_value.u_packed = m_packed[i];
+        tmp.m_packed = true;
+        tmp.reset();
+    }
+
+    m_strings.clear();
+    m_arrays.clear();
+    m_array_nodes.clear();
+    m_shaped.clear();
+    m_packed.clear();
+
+    m_next_string = 0;
+    m_next_array = 0;
+    m_next_array_node = 0;
+    m_next_shaped = 0;
+    m_next_packed = 0;
+}
+
+void json::recycler::take_apart(json &j)
+{
+    if (j.m_type == string_e)
+    {
+        m_strings.push_back(std::move(j.m_value.u_string));
+    }
+    else if (j.m_type == object_e && j.m_shaped)
+    {
+        shaped_object *s = j.m_value.u_shaped;
+
+        if (s->m_refs.load(std::memory_order_acquire) == 1 && *s->m_resource == *m_resource)
         {
-        case object_e:
-            return object_equal(other);
-        case array_e:
-            return array_equal(other);
-        case boolean_e:
-            return m_value.u_boolean == other.m_value.u_boolean;
-        case null_e:
-            return true;
-        case number_int_e:
-            return number_equal(other);
-        case number_double_e:
-            return number_equal(other);
-        case string_e:
-            return string_equal(other);
-        default:
-            throw json_exception(json_exception::invalid_json_type_e);
+            for (auto &v : s->m_values)
+            {
+                take_apart(v);
+            }
+
+            m_arrays.push_back(std::move(s->m_values));
+            m_arrays.back().clear();
+            s->release_view();
+            s->m_shape = nullptr;
+            s->m_hash.store(0, std::memory_order_relaxed);
+            m_shaped.push_back(s);
+
+            j.m_shaped = false;
+            j.m_type = null_e;
         }
     }
-    else if ((m_type == number_int_e && other.m_type == number_double_e) ||
-             (m_type == number_double_e && other.m_type == number_int_e))
+    else if (j.m_type == object_e)
     {
-        return static_cast<double>(*this) == static_cast<double>(other);
+        if (!j.m_value.u_object->is_shared())
+        {
+            for (auto &p : j.m_value.u_object->m_value)
+            {
+                take_apart(p.second);
+            }
+        }
     }
-    else
+    else if (j.m_type == array_e && j.m_packed)
     {
-        return false;
+        packed_array *p = j.m_value.u_packed;
+
+        if (p->m_refs.load(std::memory_order_acquire) == 1 && *p->m_resource == *m_resource)
+        {
+            p->release_view();
+            p->m_ints.clear();
+            p->m_doubles.clear();
+            p->m_hash.store(0, std::memory_order_relaxed);
+            m_packed.push_back(p);
+
+            j.m_packed = false;
+            j.m_type = null_e;
+        }
     }
-}
+    else if (j.m_type == array_e)
+    {
+        array_node *n = j.m_value.u_array;
 
+        if (!n->is_shared() && *n->m_value.get_allocator().resource() == *m_resource)
+        {
+            for (auto &e : n->m_value)
+            {
+                take_apart(e);
+            }
 
-bool json::operator!=(const json &other) const
-{
-    return !(*this == other);
+            m_arrays.push_back(std::move(n->m_value));
+            m_arrays.back().clear();
+            n->m_shareable = true;
+            n->m_hash.store(0, std::memory_order_relaxed);
+            m_array_nodes.push_back(n);
+
+            j.m_type = null_e;
+        }
+    }
+
+    j.reset();
 }
 
-bool json::operator==(bool b) const
+std::string json::recycler::take_string()
 {
-    return static_cast<bool>(*this) == b;
+    if (m_next_string < m_strings.size())
+    {
+        std::string s(std::move(m_strings[m_next_string++]));
+        s.clear();
+        return s;
+    }
+    return std::string();
 }
 
-bool json::operator==(int i) const
+json::json_array json::recycler::take_array()
 {
-    return static_cast<int>(*this) == i;
+    if (m_next_array < m_arrays.size())
+    {
+        return std::move(m_arrays[m_next_array++]);
+    }
+    return json_array(json_array::allocator_type(m_resource));
 }
 
-bool json::operator==(double d) const
+json json::recycler::make_array(json_array &&values)
 {
-    return static_cast<double>(*this) == d;
+    if (m_next_array_node == m_array_nodes.size() || *values.get_allocator().resource() != *m_resource)
+    {
+        return from_array(std::move(values));
+    }
+
+    json j;
+    j.m_type = array_e;
+    j.m_value.u_array = m_array_nodes[m_next_array_node++];
+    j.m_value.u_array->m_value = std::move(values);
+    return j;
 }
 
-bool json::operator==(const std::string &s) const
+json json::recycler::make_shaped(std::shared_ptr<const object_shape> shape, json_array &&values)
 {
-    return static_cast<std::string>(*this) == s;
+    if (m_next_shaped == m_shaped.size() || *values.get_allocator().resource() != *m_resource)
+    {
+        return from_shape(std::move(shape), std::move(values));
+    }
+
+    if (!shape || shape->size() != values.size())
+    {
+        throw json_exception(json_exception::shape_size_mismatch_e);
+    }
+
+    json j;
+    j.m_type = object_e;
+    j.m_value.u_shaped = m_shaped[m_next_shaped++];
+    j.m_value.u_shaped->m_shape = std::move(shape);
+    j.m_value.u_shaped->m_values = std::move(values);
+    j.m_shaped = true;
+    return j;
 }
 
-bool json::operator==(const char *s) const
+json::packed_array *json::recycler::take_packed(type element_type)
 {
-    return static_cast<std::string>(*this) == s;
-}
+    if (m_next_packed == m_packed.size())
+    {
+        return nullptr;
+    }
 
-bool json::operator!=(int i) const
-{
-    return static_cast<int>(*this) != i;
+    packed_array *p = m_packed[m_next_packed++];
+    p->m_element_type = element_type;
+    return p;
 }
 
-bool json::operator!=(double d) const
+json json::recycler::make_numbers(const int64_t *values, size_t n)
 {
-    return static_cast<double>(*this) != d;
-}
+    packed_array *p = take_packed(number_int_e);
 
-bool json::operator!=(const std::string &s) const
-{
-    return static_cast<std::string>(*this) != s;
-}
+    if (p == nullptr)
+    {
+        return from_numbers(values, n, m_resource);
+    }
 
-bool json::operator!=(const char *s) const
-{
-    return static_cast<std::string>(*this) != s;
+    json j;
+    j.m_type = array_e;
+    j.m_value.u_packed = p;
+    j.m_packed = true;
+    p->m_ints.assign(values, values + n);
+    return j;
 }
 
-bool json::operator<(int i) const
+json json::recycler::make_numbers(const double *values, size_t n)
 {
-    return static_cast<int>(*this) < i;
-}
+    packed_array *p = take_packed(number_double_e);
 
-bool json::operator<(double d) const
-{
-    return static_cast<double>(*this) < d;
-}
+    if (p == nullptr)
+    {
+        return from_numbers(values, n, m_resource);
+    }
 
-bool json::operator<(const std::string &s) const
-{
-    return static_cast<std::string>(*this) < s;
+    json j;
+    j.m_type = array_e;
+    j.m_value.u_packed = p;
+    j.m_packed = true;
+    p->m_doubles.assign(values, values + n);
+    return j;
 }
 
-bool json::operator<(const char *s) const
+const json &json::find(const pointer &p) const
 {
-    return static_cast<std::string>(*this) < s;
+    const json *res = try_find(p);
+
+    if (res == nullptr)
+    {
+        throw json_exception(json_exception::pointer_not_matched_e);
+    }
+
+    return *res;
 }
 
-bool json::operator<=(int i) const
+const json *json::try_find(const pointer &p) const
 {
-    return static_cast<int>(*this) <= i;
+    return try_find(p, 0);
 }
 
-bool json::operator<=(double d) const
+const json *json::try_find(const pointer &p, size_t first) const
 {
-    return static_cast<double>(*this) <= d;
+    const auto &path = p.get_tokens();
+    const json *res = this;
+
+    for (size_t i = first; i < path.size(); i++)
+    {
+        res = res->child(path[i]);
+        if (res == nullptr)
+        {
+            return nullptr;
+        }
+    }
+
+    return res;
 }
 
-bool json::operator<=(const std::string &s) const
+const json *json::child(const pointer::token &t) const
 {
-    return static_cast<std::string>(*this) < s;
+    switch (t.get_type())
+    {
+    case pointer::token::all_e:
+        return this;
+
+    case pointer::token::object_e:
+        return m_type == object_e ? find_member(t) : nullptr;
+
+    case pointer::token::array_e:
+        return try_get(t.get_index());
+
+    default:
+        throw json_exception(json_exception::pointer_token_type_invalid_e);
+    }
 }
 
-bool json::operator<=(const char *s) const
+void json::find(const pointer_set &s, std::vector<const json *> &results) const
 {
-    return static_cast<std::string>(*this) <= s;
+    results.assign(s.size(), nullptr);
+    find(s.get_nodes(), 0, results);
 }
 
-bool json::operator>(int i) const
+void json::find(const std::vector<pointer_set::node> &nodes, size_t n, std::vector<const json *> &results) const
 {
-    return static_cast<int>(*this) > i;
+    for (auto p : nodes[n].get_pointers())
+    {
+        results[p] = this;
+    }
+
+    // Skip the whole subtree of a child that isn't there, its pointers
+    // stay nullptr.
+    for (size_t c = n + 1; c < nodes[n].get_end(); c = nodes[c].get_end())
+    {
+        const json *j = child(nodes[c].get_token());
+        if (j != nullptr)
+        {
+            j->find(nodes, c, results);
+        }
+    }
 }
 
-bool json::operator>(double d) const
+void json::find_all(const pointer &p, const std::function<void(const json &)> &visit) const
 {
-    return static_cast<double>(*this) > d;
+    find_all(p.get_tokens(), 0, visit);
 }
 
-bool json::operator>(const std::string &s) const
+std::vector<const json *> json::find_all(const pointer &p) const
 {
-    return static_cast<std::string>(*this) > s;
+    std::vector<const json *> res;
+    find_all(p.get_tokens(), 0, [&res](const json &j) { res.push_back(&j); });
+    return res;
 }
 
-bool json::operator>(const char *s) const
+void json::find_all(
+            const std::vector<pointer::token>           &path,
+            size_t                                      i,
+            const std::function<void(const json &)>     &visit) const
 {
-    return static_cast<std::string>(*this) > s;
+    const json *res = this;
+
+    // Plain tokens are followed in a loop, only a wildcard recurses.
+    for (; i < path.size(); i++)
+    {
+        const pointer::token &t = path[i];
+
+        if (t.is_wildcard() && res->m_type == array_e)
+        {
+            for (size_t k = 0; k < res->size(); k++)
+            {
+                res->try_get(k)->find_all(path, i + 1, visit);
+            }
+            return;
+        }
+        else if (t.is_wildcard() && res->m_type == object_e)
+        {
+            if (res->m_shaped)
+            {
+                for (const auto &v : res->m_value.u_shaped->m_values)
+                {
+                    v.find_all(path, i + 1, visit);
+                }
+            }
+            else
+            {
+                for (const auto &m : res->m_value.u_object->m_value)
+                {
+                    m.second.find_all(path, i + 1, visit);
+                }
+            }
+            return;
+        }
+        else
+        {
+            res = res->child(t);
+        }
+
+        if (res == nullptr)
+        {
+            return;
+        }
+    }
+
+    visit(*res);
 }
 
-bool json::operator>=(int i) const
+json &json::find_mutable(const pointer &p)
 {
-    return static_cast<int>(*this) >= i;
+    const auto &path = p.get_tokens();
+    json *res = this;
+
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        json *child = res->child_for_update(path, i, false);
+        if (child == nullptr)
+        {
+            throw json_exception(json_exception::pointer_not_matched_e);
+        }
+
+        // as with get_object() and get_array(), a non-const reference into
+        // the container is being handed out
+        if (child != res)
+        {
+            if (res->m_type == object_e)
+            {
+                res->m_value.u_object->m_shareable = false;
+            }
+            else
+            {
+                res->m_value.u_array->m_shareable = false;
+            }
+        }
+        res = child;
+    }
+
+    return *res;
 }
 
-bool json::operator>=(double d) const
+const json &json::set(const pointer &p, json &&value, bool create)
 {
-    return static_cast<double>(*this) >= d;
+    const auto &path = p.get_tokens();
+    json *parent = parent_for_update(path, create);
+    const pointer::token &t = path.back();
+
+    if (parent != nullptr)
+    {
+        if (t.get_type() == pointer::token::all_e)
+        {
+            *parent = std::move(value);
+            return *parent;
+        }
+        else if (t.get_type() == pointer::token::object_e && parent->m_type == object_e)
+        {
+            json_object &o = parent->object_for_update();
+            return o[t.get_name()] = std::move(value);
+        }
+        else if (t.get_type() == pointer::token::array_e && parent->m_type == array_e)
+        {
+            json_array &a = parent->array_for_update();
+            if (t.get_index() < a.size())
+            {
+                return a[t.get_index()] = std::move(value);
+            }
+            else if (t.get_index() == a.size())
+            {
+                a.push_back(std::move(value));
+                return a.back();
+            }
+        }
+    }
+
+    throw json_exception(json_exception::pointer_not_matched_e);
 }
 
-bool json::operator>=(const std::string &s) const
+bool json::erase(const pointer &p)
 {
-    return static_cast<std::string>(*this) >= s;
+    const auto &path = p.get_tokens();
+    json *parent = parent_for_update(path, false);
+    const pointer::token &t = path.back();
+
+    if (parent == nullptr)
+    {
+        return false;
+    }
+    else if (t.get_type() == pointer::token::all_e)
+    {
+        parent->reset();
+        return true;
+    }
+    else if (t.get_type() == pointer::token::object_e && parent->m_type == object_e)
+    {
+        return parent->object_for_update().erase(t.get_name()) != 0;
+    }
+    else if (t.get_type() == pointer::token::array_e && parent->m_type == array_e)
+    {
+        json_array &a = parent->array_for_update();
+        if (t.get_index() < a.size())
+        {
+            a.erase(a.begin() + t.get_index());
+            return true;
+        }
+    }
+
+    return false;
 }
 
-bool json::operator>=(const char *s) const
+void json::merge_patch(json &&patch)
 {
-    return static_cast<std::string>(*this) >= s;
+    merge_patch(std::move(patch), get_memory_resource());
 }
 
-bool json::operator<(const json &other) const
+void json::merge_patch(json &&patch, memory_resource *r)
 {
-    if (m_type == string_e && other.m_type == string_e)
+    if (patch.m_type != object_e)
     {
-        return static_cast<std::string>(*this) < static_cast<std::string>(other);
+        *this = std::move(patch);
+        return;
     }
-    else if (m_type == number_int_e && other.m_type == number_int_e)
+
+    if (m_type != object_e)
     {
-        return static_cast<int>(*this) < static_cast<int>(other);
+        // an array keeps to its own resource, a scalar has none of its own
+        *this = json(object_e, m_type == array_e ? get_memory_resource() : r);
     }
-    else if ((m_type == number_double_e && other.m_type == number_double_e) ||
-             (m_type == number_double_e && other.m_type == number_int_e) ||
-             (m_type == number_int_e && other.m_type == number_double_e))
+
+    json_object &target = object_for_update();
+
+    // The members of the patch are only moved from if nothing else shares them.
+    if (patch.m_shaped)
     {
-        return static_cast<double>(*this) < static_cast<double>(other);
+        shaped_object &s = *patch.m_value.u_shaped;
+        const auto &names = s.m_shape->get_names();
+        bool owned = s.m_refs.load(std::memory_order_acquire) == 1;
+
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            merge_member(target, names[i], owned ? std::move(s.m_values[i]) : json(s.m_values[i]));
+        }
     }
     else
     {
-        throw json_exception(
-                        json_exception::types_not_comparable_e,
-                        get_instance_type_name(),
-                        other.get_instance_type_name());
+        bool owned = !patch.m_value.u_object->is_shared();
+
+        for (auto &m : patch.m_value.u_object->m_value)
+        {
+            merge_member(target, m.first, owned ? std::move(m.second) : json(m.second));
+        }
     }
 }
 
-bool json::operator<=(const json &other) const
+void json::merge_member(json_object &target, const std::string &name, json &&value)
 {
-    if (m_type == string_e && other.m_type == string_e)
+    auto m = target.find(name);
+
+    if (value.m_type == null_e)
     {
-        return static_cast<std::string>(*this) <= static_cast<std::string>(other);
+        if (m != target.end())
+        {
+            target.erase(m);
+        }
     }
-    else if (m_type == number_int_e && other.m_type == number_int_e)
+    else if (m != target.end())
     {
-        return static_cast<int>(*this) <= static_cast<int>(other);
+        m->second.merge_patch(std::move(value), target.get_allocator().resource());
     }
-    else if ((m_type == number_double_e && other.m_type == number_double_e) ||
-             (m_type == number_double_e && other.m_type == number_int_e) ||
-             (m_type == number_int_e && other.m_type == number_double_e))
+    else if (value.m_type == object_e && value.has_null_member())
     {
-        return static_cast<double>(*this) <= static_cast<double>(other);
+        // merged into nothing, which drops the nulls
+        target.emplace(name, json(object_e, target.get_allocator().resource())).first->second.merge_patch(std::move(value));
     }
     else
     {
-        throw json_exception(
-                        json_exception::types_not_comparable_e,
-                        get_instance_type_name(),
-                        other.get_instance_type_name());
+        target.emplace(name, std::move(value));
     }
 }
 
-bool json::operator>(const json &other) const
+bool json::has_null_member() const
 {
-    return !(*this <= other);
+    if (m_shaped)
+    {
+        for (const auto &v : m_value.u_shaped->m_values)
+        {
+            if (v.m_type == null_e || (v.m_type == object_e && v.has_null_member()))
+            {
+                return true;
+            }
+        }
+    }
+    else
+    {
+        for (const auto &m : m_value.u_object->m_value)
+        {
+            if (m.second.m_type == null_e || (m.second.m_type == object_e && m.second.has_null_member()))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
-bool json::operator>=(const json &other) const
+// Tokens from i on can go into new, empty containers if every array index
+// among them is 0.
+static bool json_can_create(const std::vector<pointer::token> &path, size_t i)
 {
-    return !(*this < other);
+    for (; i < path.size(); i++)
+    {
+        if (path[i].get_type() == pointer::token::array_e && path[i].get_index() != 0)
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-const json &json::find(const pointer &p) const
+json *json::child_for_update(const std::vector<pointer::token> &path, size_t i, bool create)
 {
-    const json *res = this;
+    const pointer::token &t = path[i];
+
+    // what to make if the child is missing, only possible if there is a
+    // token after this one for it to apply to
+    create = create && i + 1 < path.size() && json_can_create(path, i + 1);
+    type missing = create && path[i + 1].get_type() == pointer::token::array_e ? array_e : object_e;
 
-    for (auto t : p.get_path())
+    if (t.get_type() == pointer::token::all_e)
+    {
+        return this;
+    }
+    else if (t.get_type() == pointer::token::object_e && m_type == object_e)
+    {
+        json_object &o = object_for_update();
+        auto m = o.find(t.get_name());
+        if (m != o.end())
+        {
+            return &m->second;
+        }
+        else if (create)
+        {
+            return &o.emplace(t.get_name(), json(missing, o.get_allocator().resource())).first->second;
+        }
+    }
+    else if (t.get_type() == pointer::token::array_e && m_type == array_e)
     {
-        switch (t.get_type())
+        json_array &a = array_for_update();
+        if (t.get_index() < a.size())
         {
-        case pointer::token::all_e:
-            break;
+            return &a[t.get_index()];
+        }
+        else if (create && t.get_index() == a.size())
+        {
+            a.emplace_back(missing, a.get_allocator().resource());
+            return &a.back();
+        }
+    }
 
-        case pointer::token::object_e:
-            if (res->m_type == object_e)
-            {
-                auto i = res->m_value.u_object.find(t.get_name());
-                if (i == res->m_value.u_object.end())
-                {
-                    throw json_exception(json_exception::pointer_not_matched_e);
-                }
-                else
-                {
-                    res = &i->second;
-                }
-            }
-            else
-            {
-                throw json_exception(json_exception::pointer_not_matched_e);
-            }
-            break;
+    return nullptr;
+}
 
-        case pointer::token::array_e:
-            if (res->m_type == array_e)
-            {
-                if (t.get_index() < res->m_value.u_array.size())
-                {
-                    res = &(res->m_value.u_array)[t.get_index()];
-                }
-                else
-                {
-                    throw json_exception(json_exception::pointer_not_matched_e);
-                }
-            }
-            else
-            {
-                throw json_exception(json_exception::pointer_not_matched_e);
-            }
-            break;
+json *json::parent_for_update(const std::vector<pointer::token> &path, bool create)
+{
+    json *res = this;
 
-        default:
-            throw json_exception(json_exception::pointer_token_type_invalid_e);
-        }
+    for (size_t i = 0; i + 1 < path.size() && res != nullptr; i++)
+    {
+        res = res->child_for_update(path, i, create);
     }
 
-    return *res;
+    return res;
+}
+
+json *json::find_for_update(const pointer &p)
+{
+    const auto &path = p.get_tokens();
+    json *res = this;
+
+    for (size_t i = 0; i < path.size() && res != nullptr; i++)
+    {
+        res = res->child_for_update(path, i, false);
+    }
+
+    return res;
 }
 
 void json::ensure_type(type t, int ex) const
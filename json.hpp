@@ -25,15 +25,80 @@
 
 /// \file json.hpp The json class.
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <map>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "common.hpp"
+#include "memory_resource.hpp"
 #include "pointer.hpp"
+#include "pointer_set.hpp"
+#include "shape.hpp"
 
 namespace NAMESPACE
 {
+    /**
+     * \brief A read only view of a contiguous sequence of values.
+     *
+     * A minimal stand in for C++20 std::span. Used to give direct access to the
+     * elements of packed numeric arrays.
+     */
+    template <typename T>
+    class span
+    {
+    public:
+
+        /// Construct a view of size elements starting at data.
+        span(T *data, size_t size) noexcept : m_data(data), m_size(size)
+        {
+        }
+
+        /// Pointer to the first element.
+        T *data() const noexcept
+        {
+            return m_data;
+        }
+
+        /// Number of elements.
+        size_t size() const noexcept
+        {
+            return m_size;
+        }
+
+        /// True if there are no elements.
+        bool empty() const noexcept
+        {
+            return m_size == 0;
+        }
+
+        /// Iterator to the first element.
+        T *begin() const noexcept
+        {
+            return m_data;
+        }
+
+        /// Iterator past the last element.
+        T *end() const noexcept
+        {
+            return m_data + m_size;
+        }
+
+        /// Element access. Not range checked.
+        T &operator[](size_t i) const noexcept
+        {
+            return m_data[i];
+        }
+
+    private:
+
+        T      *m_data;
+        size_t m_size;
+    };
+
     /**
      * \brief All json things are represented by instances of this class.
      *
@@ -67,8 +132,21 @@ namespace NAMESPACE
         // Convenience definition for creating null instances
         typedef decltype(nullptr) null_t;
 
-        typedef std::map<std::string, json> json_object;
-        typedef std::vector<json> json_array;
+        /**
+         * Objects. The allocator means the map nodes can live in a caller
+         * supplied memory_resource (see parser and json(type, memory_resource *)).
+         */
+        typedef std::map<
+                    std::string,
+                    json,
+                    std::less<std::string>,
+                    polymorphic_allocator<std::pair<const std::string, json>>> json_object;
+
+        /**
+         * Arrays. The allocator means the element buffer can live in a caller
+         * supplied memory_resource.
+         */
+        typedef std::vector<json, polymorphic_allocator<json>> json_array;
 
         /**
          * JSON types as per RFC 4627 but with numbers split into int and double.
@@ -96,13 +174,32 @@ namespace NAMESPACE
         ~json() noexcept;
 
         /**
-         * Copy constructor. Note that this is a full deep copy so use
-         * carefully to avoid performance problems.
+         * Copy constructor. Objects and arrays are copy on write: the copy
+         * shares the storage of the original, whatever its size, and each
+         * object or array along a path is only cloned when one of the
+         * instances sharing it is changed. The reference counts are atomic
+         * so copies can be handed to other threads. As with std::pmr containers,
+         * the copy does not inherit the memory resource of the original, it
+         * uses new_delete_resource(), so storage is only shared when the
+         * original uses that too; otherwise this is a full deep copy.
+         *
+         * An object or array is never shared again once a non-const reference
+         * to it or to one of its elements has been handed out (by get_object(),
+         * get_array() or a non-const operator[]) because changes made through
+         * that reference would otherwise show up in every copy.
          */
         json(const json &other);
 
         /**
-         * Move constructor - shallow copy.
+         * Copy into a specific memory resource. All objects and arrays in
+         * the copy, at any depth, are allocated using r (or shared with the
+         * original where it already uses r).
+         */
+        json(const json &other, memory_resource *r);
+
+        /**
+         * Move constructor - shallow copy. Object and array storage is taken
+         * over along with the memory resource it was allocated from.
          */
         json(json &&other) noexcept;
 
@@ -119,6 +216,13 @@ namespace NAMESPACE
          */
         json(type t);
 
+        /**
+         * As json(type t) but, for objects and arrays, allocate storage from
+         * the given memory resource. nullptr means new_delete_resource().
+         * \throw json_exception if t isn't a valid type.
+         */
+        json(type t, memory_resource *r);
+
         /**
          * New json instance of int, double or string type in the specific
          * situation where the underlying text representation couldn't be
@@ -139,6 +243,17 @@ namespace NAMESPACE
          */
         json(int i) noexcept;
 
+        /**
+         * New json instance of number int type.
+         */
+        json(int64_t i) noexcept;
+
+        /**
+         * New json instance of number int type. Values too big for an int64_t
+         * can only be read back with the uint64_t cast (see is_uint64()).
+         */
+        json(uint64_t i) noexcept;
+
         /**
          * New json instance of number double type.
          */
@@ -182,19 +297,39 @@ namespace NAMESPACE
         json(std::unique_ptr<std::string> s);
 
         /**
-         * New json instance of object type. All values are deep copied so this can
-         * be inefficient for large objects.
+         * New json instance of object type. Pass the map with std::move() to
+         * have the instance take it over. Otherwise all values are copied.
          */
         static json from_object(json_object o);
 
         /**
-         * New json instance of array type. All values are deep copied so this can
-         * be inefficient for large arrays.
+         * New json instance of array type. Pass the vector with std::move() to
+         * have the instance take it over. Otherwise all values are copied.
          */
         static json from_array(json_array a);
 
         /**
-         * Assignment. Full deep copy.
+         * New json instance of array type holding n ints in packed form. See
+         * is_packed() for details.
+         */
+        static json from_numbers(const int64_t *values, size_t n, memory_resource *r = nullptr);
+
+        /**
+         * New json instance of array type holding n doubles in packed form. See
+         * is_packed() for details.
+         */
+        static json from_numbers(const double *values, size_t n, memory_resource *r = nullptr);
+
+        /**
+         * New json instance of object type with the names in shape and the
+         * values in values, in the same order. See is_shaped() for details.
+         * The storage comes from the memory resource of values.
+         * \throw json_exception if the number of values doesn't match the shape.
+         */
+        static json from_shape(std::shared_ptr<const object_shape> shape, json_array values);
+
+        /**
+         * Assignment. Copy on write as for the copy constructor.
          */
         json &operator=(const json &other);
 
@@ -210,6 +345,18 @@ namespace NAMESPACE
          */
         json &operator=(int i);
 
+        /**
+         * Assign the instance an int64_t value. All previous values are erased and/or
+         * freed.
+         */
+        json &operator=(int64_t i);
+
+        /**
+         * Assign the instance a uint64_t value. All previous values are erased and/or
+         * freed.
+         */
+        json &operator=(uint64_t i);
+
         /**
          * Assign the instance a double value. All previous values are erased and/or
          * freed.
@@ -261,6 +408,12 @@ namespace NAMESPACE
          */
         json &operator=(const json_object &o);
 
+        /**
+         * Assign the instance an object value, taking over the map. All
+         * previous values are erased and/or freed.
+         */
+        json &operator=(json_object &&o);
+
         /**
          * Assign the instance an array value. All previous values are erased and/or
          * freed. All values are deep copied so this can be inefficient for large
@@ -268,6 +421,12 @@ namespace NAMESPACE
          */
         json &operator=(const json_array &a);
 
+        /**
+         * Assign the instance an array value, taking over the vector. All
+         * previous values are erased and/or freed.
+         */
+        json &operator=(json_array &&a);
+
         /**
          * Assign the instance a null value. All previous values are erased and/or
          * freed. All values are deep copied so this can be inefficient for large
@@ -285,36 +444,158 @@ namespace NAMESPACE
          */
         const char *get_instance_type_name() const;
 
+        /**
+         * Get the memory resource that the object or array storage of the
+         * instance was allocated from. Scalars return new_delete_resource().
+         */
+        memory_resource *get_memory_resource() const;
+
         /**
          * Get the underlying vector of JSON instances in an array JSON instance.
+         * A packed array is converted to the ordinary form first.
          * \throw json_exception if the instance isn't an array.
          */
         json_array &get_array();
 
         /**
          * Get the underlying const vector of JSON instances in a const array of JSON instances.
+         * For a packed array, the first call builds (in a thread safe way) a vector of
+         * json instances holding the same values and that is returned from then on.
+         * That is a full json instance per element, several times the memory of the
+         * packed values and kept for as long as the array, so prefer size() with
+         * operator[] or try_get(), or as_span(), for packed arrays.
          * \throw json_exception if the instance isn't an array.
          */
         const json_array &get_array() const;
 
+        /**
+         * Number of elements of an array or members of an object, 0 for
+         * anything else. Nothing is built for a packed array or shaped object.
+         */
+        size_t size() const noexcept;
+
+        /**
+         * True if the instance is an array holding its elements as a packed vector
+         * of int64_t or double values rather than a vector of json instances. The
+         * parser produces these for arrays where every element is an int, or every
+         * element is a double, and they can be made with from_numbers(). They
+         * behave exactly like any other array except that anything that gives
+         * non-const access to the elements (e.g. get_array(), operator[] or append())
+         * first converts the array back to the ordinary form. Const element access
+         * (operator[], try_get(), find()) makes json instances for the elements a
+         * small block at a time as they are asked for, kept for as long as the
+         * array. get_array() const makes them all (see there).
+         */
+        bool is_packed() const noexcept;
+
+        /**
+         * The type of the elements of a packed array, number_int_e or
+         * number_double_e. null_e if the instance isn't a packed array.
+         */
+        type get_packed_type() const noexcept;
+
+        /**
+         * Direct access to the elements of a packed array. T must be int64_t or
+         * double and match the type of the elements. The view is invalidated by
+         * any non-const access to the array.
+         * \throw json_exception if the instance isn't an array packed with T values.
+         */
+        template <typename T>
+        span<const T> as_span() const;
+
+        /**
+         * Sum of the elements of an array of numbers. Packed arrays are summed
+         * with a loop the compiler can vectorise, so the order of the additions
+         * (and therefore the rounding of a double result) is not strictly left to
+         * right.
+         * \throw json_exception if the instance isn't an array or an element isn't a number.
+         */
+        double sum() const;
+
+        /**
+         * Smallest element of an array of numbers.
+         * \throw json_exception if the instance isn't an array or an element isn't a number.
+         * \throw json_array_index_range_exception if the array is empty.
+         */
+        double minimum() const;
+
+        /**
+         * Largest element of an array of numbers.
+         * \throw json_exception if the instance isn't an array or an element isn't a number.
+         * \throw json_array_index_range_exception if the array is empty.
+         */
+        double maximum() const;
+
         /**
          * Get the underlying map of JSON instances in an object JSON instance.
+         * A shaped object is converted to the ordinary form first.
          * \throw json_exception if the instance isn't an object.
          */
         json_object &get_object();
 
         /**
          * Get the underlying const map of JSON instances in a const object JSON instance.
+         * For a shaped object, the first call builds (in a thread safe way) a map
+         * holding the same members and that is returned from then on. That map
+         * costs as much as the unshaped object would have, so code that may see
+         * shaped objects should read them with get_shape() and get_shape_values().
          * \throw json_exception if the instance isn't an object.
          */
         const json_object &get_object() const;
 
+        /**
+         * True if the instance is an object holding just a vector of values
+         * along with a shared object_shape that holds the names. The parser
+         * can produce these for every non-empty object (so all the records in an
+         * array of records share one shape) when asked to and they can be made with
+         * from_shape(). They behave exactly like any other object except that
+         * anything that gives non-const access to the members (e.g.
+         * get_object(), operator[] or insert()) first converts the object back
+         * to the ordinary form. Looking up a member of a const shaped object
+         * with operator[], has() or find() goes through the shape.
+         */
+        bool is_shaped() const noexcept;
+
+        /**
+         * The shape of a shaped object, nullptr if the instance isn't one.
+         */
+        std::shared_ptr<const object_shape> get_shape() const;
+
+        /**
+         * Direct access to the values of a shaped object. The value of the
+         * member named get_shape()->get_names()[i] is at index i. The view is
+         * invalidated by any non-const access to the object.
+         * \throw json_exception if the instance isn't a shaped object.
+         */
+        span<const json> get_shape_values() const;
+
         /**
          * Cast the object to an int.
-         * \throw json_exception if the instance isn't an int or a double.
+         * \throw json_exception if the instance isn't an int or a double or if
+         *                       an int value is out of range for an int.
          */
         operator int() const;
 
+        /**
+         * Cast the object to an int64_t.
+         * \throw json_exception if the instance isn't an int or a double or if
+         *                       an int value is too big for an int64_t.
+         */
+        operator int64_t() const;
+
+        /**
+         * Cast the object to a uint64_t.
+         * \throw json_exception if the instance isn't an int or a double or if
+         *                       an int value is negative.
+         */
+        operator uint64_t() const;
+
+        /**
+         * True if the instance is an int too big for an int64_t. Such values
+         * can only be read with the uint64_t cast.
+         */
+        bool is_uint64() const noexcept;
+
         /**
          * Cast the object to a double.
          * \throw json_exception if the instance isn't a double or an int.
@@ -333,6 +614,38 @@ namespace NAMESPACE
          */
         operator bool() const;
 
+        /**
+         * The value held, as with std::get_if, for code where a mismatch is
+         * common enough that an exception costs too much. T is bool,
+         * int64_t, uint64_t, double or std::string and has to match the type
+         * of the instance (uint64_t matching any int that isn't negative).
+         * \return The value or nullptr if the instance holds something else
+         *         or has a raw value.
+         */
+        template <typename T>
+        const T *get_if() const noexcept;
+
+        /**
+         * The instance cast to T as by the cast operators above, or fallback
+         * where the cast would throw. T is int, int64_t, uint64_t, double,
+         * bool, std::string or const char * (in which case the string is the
+         * one held by the instance). Never throws json_exception.
+         */
+        template <typename T>
+        T value_or(T fallback) const;
+
+        /**
+         * The member called name, or nullptr if there isn't one or the
+         * instance isn't an object. Never throws json_exception.
+         */
+        const json *try_get(const std::string &name) const;
+
+        /**
+         * The element at index, or nullptr if there isn't one or the instance
+         * isn't an array. Never throws json_exception.
+         */
+        const json *try_get(size_t index) const;
+
         /**
          * Find an entry in an object instance by name. If the entry
          * doesn't exist, a new one is created with a json(null_e)
@@ -404,12 +717,44 @@ namespace NAMESPACE
 
         /**
          * Append a value to an array instance. A copy is made of the value
-         * so this can be inefficient for large structures. In that case use
-         * the append method that takes a unique_ptr.
+         * (which shares the storage of any object or array with the original,
+         * see json(const json &)). Use the append method that takes an rvalue
+         * to avoid the copy altogether.
          * \throw json_exception if the instance isn't an array.
          */
         const json &append(const json &j);
 
+        /**
+         * Append a value to an array instance, moving it in. The passed
+         * instance is left null. E.g.:
+         * \code
+         * json array(json::array_e);
+         * json i(json::object_e);
+         * i.insert("id", json(1000));
+         * array.append(std::move(i));
+         * \endcode
+         * \throw json_exception if the instance isn't an array.
+         */
+        const json &append(json &&j);
+
+        /**
+         * Append a value to an array instance, constructing it in place from
+         * args with any of the json constructors. E.g.:
+         * \code
+         * json array(json::array_e);
+         * array.emplace_back(1000);
+         * array.emplace_back(json::object_e);
+         * \endcode
+         * \throw json_exception if the instance isn't an array.
+         */
+        template <typename... Args>
+        const json &emplace_back(Args&&... args)
+        {
+            json_array &a = array_for_update();
+            a.emplace_back(std::forward<Args>(args)...);
+            return a.back();
+        }
+
         /**
          * Append a value to an array instance. Ownership of the passed instance
          * is taken over. E.g.:
@@ -431,6 +776,50 @@ namespace NAMESPACE
          */
         const json &insert(const std::string &name, const json &j);
 
+        /**
+         * Insert a value into an object instance, moving it in. The passed
+         * instance is left null. Any existing slot with the same name will be
+         * overwritten.
+         * \throw json_exception if the instance isn't an object.
+         */
+        const json &insert(const std::string &name, json &&j);
+
+        /**
+         * Insert a value into an object instance, moving in both the name and
+         * the value. The passed instance is left null. Any existing slot with
+         * the same name will be overwritten.
+         * \throw json_exception if the instance isn't an object.
+         */
+        const json &insert(std::string &&name, json &&j);
+
+        /**
+         * Insert a value into an object instance, constructing it in place
+         * from args with any of the json constructors. Any existing slot with
+         * the same name will be overwritten. E.g.:
+         * \code
+         * json object(json::object_e);
+         * object.emplace("name", "bob");
+         * object.emplace("tags", json::array_e);
+         * \endcode
+         * \throw json_exception if the instance isn't an object.
+         */
+        template <typename... Args>
+        const json &emplace(std::string name, Args&&... args)
+        {
+            json_object &o = object_for_update();
+            auto i = o.lower_bound(name);
+            if (i != o.end() && i->first == name)
+            {
+                i->second = json(std::forward<Args>(args)...);
+                return i->second;
+            }
+            return o.emplace_hint(
+                        i,
+                        std::piecewise_construct,
+                        std::forward_as_tuple(std::move(name)),
+                        std::forward_as_tuple(std::forward<Args>(args)...))->second;
+        }
+
         /**
          * Insert a value into an object instance. Ownership of the passed
          * instance is taken over.
@@ -512,6 +901,10 @@ namespace NAMESPACE
         /// == operator - throws for raw values
         bool operator==(int i) const;
         /// == operator - throws for raw values
+        bool operator==(int64_t i) const;
+        /// == operator - throws for raw values
+        bool operator==(uint64_t i) const;
+        /// == operator - throws for raw values
         bool operator==(double d) const;
         /// == operator - throws for raw values
         bool operator==(const std::string &s) const;
@@ -520,6 +913,10 @@ namespace NAMESPACE
         /// != operator - throws for raw values
         bool operator!=(int i) const;
         /// != operator - throws for raw values
+        bool operator!=(int64_t i) const;
+        /// != operator - throws for raw values
+        bool operator!=(uint64_t i) const;
+        /// != operator - throws for raw values
         bool operator!=(double d) const;
         /// != operator - throws for raw values
         bool operator!=(const std::string &s) const;
@@ -528,6 +925,10 @@ namespace NAMESPACE
         /// < operator - throws for raw values
         bool operator<(int i) const;
         /// < operator - throws for raw values
+        bool operator<(int64_t i) const;
+        /// < operator - throws for raw values
+        bool operator<(uint64_t i) const;
+        /// < operator - throws for raw values
         bool operator<(double d) const;
         /// < operator - throws for raw values
         bool operator<(const std::string &s) const;
@@ -536,6 +937,10 @@ namespace NAMESPACE
         /// <= operator - throws for raw values
         bool operator<=(int i) const;
         /// <= operator - throws for raw values
+        bool operator<=(int64_t i) const;
+        /// <= operator - throws for raw values
+        bool operator<=(uint64_t i) const;
+        /// <= operator - throws for raw values
         bool operator<=(double d) const;
         /// <= operator - throws for raw values
         bool operator<=(const std::string &s) const;
@@ -544,6 +949,10 @@ namespace NAMESPACE
         /// > operator - throws for raw values
         bool operator>(int i) const;
         /// > operator - throws for raw values
+        bool operator>(int64_t i) const;
+        /// > operator - throws for raw values
+        bool operator>(uint64_t i) const;
+        /// > operator - throws for raw values
         bool operator>(double d) const;
         /// > operator - throws for raw values
         bool operator>(const std::string &s) const;
@@ -552,6 +961,10 @@ namespace NAMESPACE
         /// >= operator - throws for raw values
         bool operator>=(int i) const;
         /// >= operator - throws for raw values
+        bool operator>=(int64_t i) const;
+        /// >= operator - throws for raw values
+        bool operator>=(uint64_t i) const;
+        /// >= operator - throws for raw values
         bool operator>=(double d) const;
         /// >= operator - throws for raw values
         bool operator>=(const std::string &s) const;
@@ -564,16 +977,222 @@ namespace NAMESPACE
          */
         const json &find(const pointer &p) const;
 
+        /**
+         * As find() but returning nullptr rather than throwing if the pointer
+         * doesn't match.
+         */
+        const json *try_find(const pointer &p) const;
+
+        /**
+         * As try_find(p) but following the tokens of the path from index
+         * first on, this being what the earlier ones lead to. For callers
+         * that have found a prefix of the path some other way, e.g. path_index.
+         */
+        const json *try_find(const pointer &p, size_t first) const;
+
+        /**
+         * Find everything matched by a pointer in which a token of * (see
+         * pointer::token::is_wildcard()) matches every element of an array
+         * or member of an object. For example the tokens items, * and price
+         * give the price of every item. Matches are visited in document order, elements by
+         * index and members by name, in one walk of the document. Paths
+         * that don't match are skipped rather than being an error.
+         * \param p       The pointer.
+         * \param visit   Called with each match.
+         */
+        void find_all(const pointer &p, const std::function<void(const json &)> &visit) const;
+
+        /// As find_all(const pointer &, visit) returning the matches.
+        std::vector<const json *> find_all(const pointer &p) const;
+
+        /**
+         * Find everything pointed at by a set of pointers in one walk of the
+         * document, following each prefix the pointers share once.
+         * \param s       The pointers.
+         * \param results Set to one entry per pointer in s, in the same
+         *                order: what it points at or nullptr if it doesn't
+         *                match. Pass the same vector each time to avoid
+         *                allocating.
+         */
+        void find(const pointer_set &s, std::vector<const json *> &results) const;
+
+        /**
+         * Find the thing pointed at by a pointer so that it can be changed.
+         * Objects and arrays along the path that are shared with copies are
+         * cloned on the way down, as with the non-const operator[].
+         * \throw   json_exception  If the pointer didn't match.
+         */
+        json &find_mutable(const pointer &p);
+
+        /**
+         * Set the thing pointed at by a pointer to value in one walk along the
+         * path. The last token may name a new member of an object or be the
+         * index one past the end of an array, in which case value is appended.
+         * Pointing at the whole document replaces it.
+         * \param p       Where to put value.
+         * \param value   What to put there.
+         * \param create  If true, objects and arrays missing along the path are
+         *                created (an array if the next token is the index 0, an
+         *                object otherwise) and added to their parent.
+         * \return        The new value in place.
+         * \throw   json_exception  If the pointer didn't match, in which case
+         *                          nothing has been created.
+         */
+        const json &set(const pointer &p, json &&value, bool create = false);
+
+        /**
+         * Remove the member or array element pointed at by a pointer in one walk
+         * along the path. Erasing the whole document makes it null.
+         * \return    false if the pointer didn't match.
+         */
+        bool erase(const pointer &p);
+
+        /**
+         * Apply an RFC 7396 JSON Merge Patch in place. If patch is an object
+         * each of its members is merged into the member of the same name, a
+         * null value removing it, and the instance becomes an object first if
+         * it isn't one. Anything else replaces the instance. Values are moved
+         * out of patch rather than copied, or share its storage if that is
+         * shared with a copy, so layering patches onto a document is one pass
+         * over each patch. patch is left in an unspecified state.
+         */
+        void merge_patch(json &&patch);
+
+        /**
+         * Structural hash of the instance, consistent with operator== (so, for
+         * example, 1 and 1.0 hash the same). The value depends only on the
+         * contents of the instance, not on the platform, the process or the
+         * memory resource. The hash of each object and array is cached and
+         * dropped when it is changed so only the path to a change is rehashed.
+         * Objects and arrays that a non-const reference has been obtained for
+         * (see json(const json &)) aren't cached as there is no way to tell
+         * when they change.
+         */
+        size_t hash() const;
+
+        /**
+         * Make structurally identical objects and arrays within the instance
+         * share their storage. This is the same sharing that copies get (see
+         * json(const json &)) so it makes no difference to how the instance is
+         * read or changed but documents that repeat the same sub-objects many
+         * times can take much less memory. Objects and arrays are only shared
+         * when they are identical down to the type of every number, they use
+         * the same memory resource and no non-const reference to them has been
+         * obtained.
+         * \return The number of objects and arrays that now share storage
+         *         with an identical one.
+         */
+        size_t deduplicate();
+
+        /// Spare storage for building new instances, see below.
+        class recycler;
+
     private:
+
+        /// Applies patches through the *_for_update() functions.
+        friend class json_patch;
+
+        /// Reference counted storage shared by copies, defined in json.cpp.
+        template <typename T>
+        struct shared_node;
+
+        typedef shared_node<json_object> object_node;
+        typedef shared_node<json_array> array_node;
+
         void destroy_object() noexcept;
-        void construct_object();
+        void construct_object(memory_resource *r);
         void move_construct_object(json_object&& o);
-        void copy_construct_object(const json_object &o);
+        void copy_construct_object(const json_object &o, memory_resource *r);
+
+        /// the object's map, cloned first if it is shared with another instance
+        json_object &object_for_update();
 
         void destroy_array() noexcept;
-        void construct_array();
+        void construct_array(memory_resource *r);
         void move_construct_array(json_array&& a);
-        void copy_construct_array(const json_array &a);
+        void copy_construct_array(const json_array &a, memory_resource *r);
+
+        /// the array's vector, unpacked and cloned first if it is shared with another instance
+        json_array &array_for_update();
+
+        /// Storage for packed arrays, defined in json.cpp.
+        struct packed_array;
+
+        void destroy_packed() noexcept;
+        void construct_packed(type element_type, memory_resource *r);
+        void copy_construct_packed(const packed_array &p, memory_resource *r);
+
+        /// convert a packed array to an ordinary one
+        void unpack();
+
+        /// the elements of an array as json instances whether packed or not
+        const json_array &array_view() const;
+
+        /// element index of a packed array as a json instance, without building a view
+        const json &packed_element(size_t index) const;
+
+        /// Storage for shaped objects, defined in json.cpp.
+        struct shaped_object;
+
+        void destroy_shaped() noexcept;
+        void construct_shaped(std::shared_ptr<const object_shape> shape, json_array &&values);
+        void copy_construct_shaped(const shaped_object &s, memory_resource *r);
+
+        /// convert a shaped object to an ordinary one
+        void unshape();
+
+        /// the members of an object as a map whether shaped or not
+        const json_object &object_view() const;
+
+        /// the member called name or nullptr if there isn't one
+        const json *find_member(const std::string &name) const;
+
+        /// find_member() for a pointer token, using and updating its slot hint
+        const json *find_member(const pointer::token &t) const;
+
+        /// the child that token t leads to or nullptr
+        const json *child(const pointer::token &t) const;
+
+        /// find(const pointer_set &, results) for the subtree of node n
+        void find(const std::vector<pointer_set::node> &nodes, size_t n, std::vector<const json *> &results) const;
+
+        /// find_all() from token i of path on
+        void find_all(
+                const std::vector<pointer::token>           &path,
+                size_t                                      i,
+                const std::function<void(const json &)>     &visit) const;
+
+        /// the child for token i of path, made ready to change, or nullptr. If
+        /// create is true a missing child is made if the rest of path allows.
+        json *child_for_update(const std::vector<pointer::token> &path, size_t i, bool create);
+
+        /// the instance that the last token of path applies to, or nullptr
+        json *parent_for_update(const std::vector<pointer::token> &path, bool create);
+
+        /// what p points at made ready to change, or nullptr. Unlike
+        /// find_mutable() nothing along the path is marked unshareable, the
+        /// caller mustn't keep a reference once it has finished the change.
+        json *find_for_update(const pointer &p);
+
+        /// the cast operators without the exceptions, false where they would throw
+        bool convert(int &value) const noexcept;
+        bool convert(int64_t &value) const noexcept;
+        bool convert(uint64_t &value) const noexcept;
+        bool convert(double &value) const noexcept;
+        bool convert(bool &value) const noexcept;
+
+        /// throw what a numeric cast of the instance that has failed should
+        [[noreturn]] void cast_failed() const;
+
+        /// merge_patch() where r is the resource for the object made if the
+        /// instance isn't one, that of its parent for a scalar member
+        void merge_patch(json &&patch, memory_resource *r);
+
+        /// merge_patch() for one member of the patch
+        static void merge_member(json_object &target, const std::string &name, json &&value);
+
+        /// true if a member of the object, or of an object in it, is null
+        bool has_null_member() const;
 
 
         void become_string(std::string s);
@@ -591,14 +1210,20 @@ namespace NAMESPACE
             json_value() { }
             ~json_value() { }
 
-            /// Objects - represented as an STL map of name -> json instance.
-            json_object u_object;
-            /// Arrays - STL vector of json instances.
-            json_array u_array;
+            /// Objects - represented as an STL map of name -> json instance, possibly shared.
+            object_node *u_object;
+            /// Arrays - STL vector of json instances, possibly shared.
+            array_node *u_array;
+            /// Arrays of numbers in packed form.
+            packed_array *u_packed;
+            /// Objects held as a shape and a vector of values.
+            shaped_object *u_shaped;
             /// Bool value.
             bool u_boolean;
             /// int representation of a number (not set if the raw option is used).
-            int u_number_int;
+            int64_t u_number_int;
+            /// int representation of a number too big for an int64_t (see m_unsigned).
+            uint64_t u_number_uint;
             /// double representation of a number (not set if the raw option is used).
             double u_number_double;
             /// UTF-8 string representation of tha value (not set if the raw option is used).
@@ -613,6 +1238,15 @@ namespace NAMESPACE
          */
         type m_type;
 
+        /// True if the instance is an array held in u_packed rather than u_array.
+        bool m_packed = false;
+
+        /// True if the instance is an object held in u_shaped rather than u_object.
+        bool m_shaped = false;
+
+        /// True if the instance is an int held in u_number_uint rather than u_number_int.
+        bool m_unsigned = false;
+
         /// Value for the instance.
         json_value m_value;
 
@@ -633,8 +1267,8 @@ namespace NAMESPACE
          */
         void reset() noexcept;
 
-        /// copy the other object to this one
-        void copy_json(const json &other);
+        /// copy the other object to this one allocating containers from r
+        void copy_json(const json &other, memory_resource *r);
 
         /// move the other object to this one
         void move_json(json &other);
@@ -642,6 +1276,27 @@ namespace NAMESPACE
         /// operator == helper method for numbers
         bool number_equal(const json &other) const;
 
+        /// comparison helper for ints, returns <0, 0 or >0 like strcmp
+        int compare_int(int64_t i) const;
+
+        /// comparison helper for ints, returns <0, 0 or >0 like strcmp
+        int compare_int(uint64_t i) const;
+
+        /// comparison helper for two int instances
+        int compare_int(const json &other) const;
+
+        /// the cached hash of an object or array, 0 if there isn't one
+        size_t cached_hash() const noexcept;
+
+        /// Objects and arrays seen so far by deduplicate(), defined in json.cpp.
+        struct dedup_table;
+
+        /// deduplicate() helper
+        void deduplicate(dedup_table &seen, size_t &count);
+
+        /// true if the instances are equal and have exactly the same types all the way down
+        bool identical(const json &other) const;
+
         /// operator == helper method for strings
         bool string_equal(const json &other) const;
 
@@ -655,6 +1310,158 @@ namespace NAMESPACE
         void ensure_type(type t, int ex) const;
 
     };
+
+    /**
+     * \brief Spare storage taken from json instances that are no longer needed.
+     *
+     * recycle() takes an instance apart, keeping its strings, vectors and
+     * array and object storage. Instances built with the methods below reuse
+     * those, in the order the instance was taken apart, before allocating
+     * anything new. parser::parse_into() uses this so that parsing a stream of
+     * messages with the same structure into the same target allocates next to
+     * nothing once it has warmed up. Only storage that isn't shared with
+     * another instance and comes from the recycler's memory resource is kept.
+     * Not thread safe.
+     */
+    class json::recycler
+    {
+    public:
+
+        /**
+         * Constructor.
+         * \param r Memory resource of the storage to keep and allocate from.
+         *          nullptr means new_delete_resource().
+         */
+        explicit recycler(memory_resource *r = nullptr);
+
+        /// Destructor - frees anything left.
+        ~recycler();
+
+        /**
+         * Free anything left from the last call and then take j apart, leaving
+         * it null.
+         */
+        void recycle(json &&j);
+
+        /// Free everything.
+        void clear() noexcept;
+
+        /// An empty string, with capacity if there is a spare one.
+        std::string take_string();
+
+        /// An empty vector, with capacity if there is a spare one.
+        json_array take_array();
+
+        /// As json::from_array() but reusing spare array storage.
+        json make_array(json_array &&values);
+
+        /// As json::from_shape() but reusing spare object storage.
+        json make_shaped(std::shared_ptr<const object_shape> shape, json_array &&values);
+
+        /// As json::from_numbers() but reusing spare packed array storage.
+        json make_numbers(const int64_t *values, size_t n);
+
+        /// As json::from_numbers() but reusing spare packed array storage.
+        json make_numbers(const double *values, size_t n);
+
+    private:
+
+        recycler(const recycler &other) = delete;
+        recycler &operator=(const recycler &other) = delete;
+
+        /// Move the storage of j and everything in it to the spares, children first.
+        void take_apart(json &j);
+
+        /// The next spare packed array or nullptr.
+        packed_array *take_packed(type element_type);
+
+        /// Where the kept storage is from.
+        memory_resource *m_resource;
+
+        std::vector<std::string> m_strings;
+        size_t m_next_string;
+
+        std::vector<json_array> m_arrays;
+        size_t m_next_array;
+
+        std::vector<array_node *> m_array_nodes;
+        size_t m_next_array_node;
+
+        std::vector<shaped_object *> m_shaped;
+        size_t m_next_shaped;
+
+        std::vector<packed_array *> m_packed;
+        size_t m_next_packed;
+    };
+
+    /// Packed int elements. See json::as_span().
+    template <>
+    span<const int64_t> json::as_span<int64_t>() const;
+
+    /// Packed double elements. See json::as_span().
+    template <>
+    span<const double> json::as_span<double>() const;
+
+    /// See json::get_if().
+    template <>
+    const bool *json::get_if<bool>() const noexcept;
+
+    /// See json::get_if().
+    template <>
+    const int64_t *json::get_if<int64_t>() const noexcept;
+
+    /// See json::get_if().
+    template <>
+    const uint64_t *json::get_if<uint64_t>() const noexcept;
+
+    /// See json::get_if().
+    template <>
+    const double *json::get_if<double>() const noexcept;
+
+    /// See json::get_if().
+    template <>
+    const std::string *json::get_if<std::string>() const noexcept;
+
+    /// See json::value_or().
+    template <>
+    int json::value_or<int>(int fallback) const;
+
+    /// See json::value_or().
+    template <>
+    int64_t json::value_or<int64_t>(int64_t fallback) const;
+
+    /// See json::value_or().
+    template <>
+    uint64_t json::value_or<uint64_t>(uint64_t fallback) const;
+
+    /// See json::value_or().
+    template <>
+    double json::value_or<double>(double fallback) const;
+
+    /// See json::value_or().
+    template <>
+    bool json::value_or<bool>(bool fallback) const;
+
+    /// See json::value_or().
+    template <>
+    std::string json::value_or<std::string>(std::string fallback) const;
+
+    /// See json::value_or().
+    template <>
+    const char *json::value_or<const char *>(const char *fallback) const;
+}
+
+namespace std
+{
+    /// So that json instances can be used as keys in unordered containers.
+    template <>
+    struct hash<NAMESPACE::json>
+    {
+        size_t operator()(const NAMESPACE::json &j) const
+        {
+            return j.hash();
+        }
+    };
 }
 
 #endif
@@ -0,0 +1,1126 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/// \file json_bench.cpp Argo benchmarks. Build with -DCMAKE_BUILD_TYPE=Release for meaningful timings.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "argo.hpp"
+
+using namespace std;
+using namespace argo;
+
+// Count every heap allocation made by the process, and the bytes currently
+// allocated, so that benchmarks can report memory use as well as time. The
+// size of each block is kept in a header in front of it.
+
+static atomic<size_t> num_allocations(0);
+static atomic<size_t> live_bytes(0);
+static const size_t header_size = alignof(max_align_t);
+
+void *operator new(size_t n)
+{
+    num_allocations++;
+    char *p = static_cast<char *>(malloc(n + header_size));
+    if (p == nullptr)
+    {
+        throw bad_alloc();
+    }
+    *reinterpret_cast<size_t *>(p) = n;
+    live_bytes += n;
+    return p + header_size;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (p != nullptr)
+    {
+        char *h = static_cast<char *>(p) - header_size;
+        live_bytes -= *reinterpret_cast<size_t *>(h);
+        free(h);
+    }
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+class timer
+{
+public:
+
+    timer() : m_start(chrono::steady_clock::now()), m_allocations(num_allocations) { }
+
+    double elapsed_ms() const
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - m_start).count();
+    }
+
+    size_t allocations() const
+    {
+        return num_allocations - m_allocations;
+    }
+
+private:
+
+    chrono::steady_clock::time_point m_start;
+    size_t m_allocations;
+};
+
+size_t count_values(const json &j)
+{
+    size_t n = 1;
+
+    if (j.get_instance_type() == json::object_e)
+    {
+        for (const auto &p : j.get_object())
+        {
+            n += count_values(p.second);
+        }
+    }
+    else if (j.get_instance_type() == json::array_e)
+    {
+        for (const auto &e : j.get_array())
+        {
+            n += count_values(e);
+        }
+    }
+
+    return n;
+}
+
+/// An array of records made up of small arrays and objects.
+string make_small_containers(int num_records)
+{
+    ostringstream s;
+
+    s << '[';
+    for (int i = 0; i < num_records; i++)
+    {
+        if (i > 0)
+        {
+            s << ',';
+        }
+        s << "{\"id\":" << i
+          << ",\"point\":[" << i << "," << i * 2 << "]"
+          << ",\"rgba\":[" << i % 256 << "," << (i + 1) % 256 << "," << (i + 2) % 256 << ",255]"
+          << ",\"meta\":{\"ok\":true}"
+          << ",\"pair\":[\"a\",\"b\",\"c\"]}";
+    }
+    s << ']';
+
+    return s.str();
+}
+
+void bench_parse_small_containers()
+{
+    string s = make_small_containers(100000);
+
+    timer t;
+    auto j = parser::parse(s);
+    double ms = t.elapsed_ms();
+    size_t allocations = t.allocations();
+    size_t values = count_values(*j);
+
+    cout << "parse_small_containers: " << values << " values, "
+         << ms << " ms, "
+         << allocations << " allocations, "
+         << static_cast<double>(allocations) / values << " allocations per value" << endl;
+}
+
+/// A time series of one million doubles summed packed and as generic json.
+void bench_sum_time_series()
+{
+    ostringstream os;
+    os << '[';
+    for (int i = 0; i < 1000000; i++)
+    {
+        os << (i > 0 ? "," : "") << (i % 1000) * 0.25 + 0.125;
+    }
+    os << ']';
+    string s = os.str();
+
+    timer t1;
+    auto packed = parser::parse(s);
+    double parse_ms = t1.elapsed_ms();
+    bool is_packed = packed->is_packed();
+
+    timer t2;
+    double packed_sum = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        packed_sum += packed->sum();
+    }
+    double packed_ms = t2.elapsed_ms();
+
+    // one element of the series, then all of them as json instances
+    const json &cp = *packed;
+    size_t bytes = live_bytes;
+    timer t4;
+    double element = cp[500000];
+    double element_us = t4.elapsed_ms() * 1000;
+    size_t element_bytes = live_bytes - bytes;
+    timer t5;
+    element += static_cast<double>(cp.get_array()[500001]);
+    double view_ms = t5.elapsed_ms();
+    size_t view_bytes = live_bytes - bytes - element_bytes;
+
+    json generic = json::from_array(packed->get_array());
+
+    timer t3;
+    double generic_sum = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        generic_sum += generic.sum();
+    }
+    double generic_ms = t3.elapsed_ms();
+
+    cout << "sum_time_series: parse " << parse_ms << " ms, packed " << is_packed << ", "
+         << "100 packed sums " << packed_ms << " ms, "
+         << "100 generic sums " << generic_ms << " ms, "
+         << (packed_sum == generic_sum ? "same" : "different") << " result, "
+         << "first element access " << element_us << " us " << element_bytes << " bytes, "
+         << "get_array() " << view_ms << " ms " << view_bytes / (1024 * 1024) << " MB (" << element << ")" << endl;
+}
+
+/// Copies of a 50MB document as handed to many request contexts.
+void bench_copy_large_document()
+{
+    string s = make_small_containers(520000);
+    istringstream is(s);
+    stream_reader r(&is, s.size() + 1, true);
+    parser p(r);
+    auto j = p.parse();
+    const json &original = *j;
+
+    timer t1;
+    monotonic_buffer_resource pool;
+    json deep(original, &pool);
+    double deep_ms = t1.elapsed_ms();
+
+    timer t2;
+    size_t n = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        json c(original);
+        n += c.get_instance_type() == json::array_e;
+    }
+    double copy_ms = t2.elapsed_ms();
+    size_t copy_allocations = t2.allocations();
+
+    timer t3;
+    json c(original);
+    c[260000]["id"] = -1;
+    double update_ms = t3.elapsed_ms();
+    size_t update_allocations = t3.allocations();
+
+    cout << "copy_large_document: " << s.size() / (1024 * 1024) << " MB, "
+         << "1 deep copy " << deep_ms << " ms, "
+         << n << " shared copies " << copy_ms << " ms "
+         << copy_allocations << " allocations, "
+         << "copy and update one member " << update_ms << " ms "
+         << update_allocations << " allocations" << endl;
+}
+
+/// A catalog in which every product repeats one of a few address, price and permission blocks.
+void bench_deduplicate_catalog()
+{
+    ostringstream os;
+    os << '[';
+    for (int i = 0; i < 100000; i++)
+    {
+        os << (i > 0 ? "," : "")
+           << "{\"sku\":" << i
+           << ",\"warehouse\":{\"street\":\"" << i % 5 << " Dock Road\",\"city\":\"Leeds\",\"postcode\":\"LS1 4AP\",\"country\":\"GB\"}"
+           << ",\"price\":{\"currency\":\"GBP\",\"symbol\":\"\\u00a3\",\"decimals\":2,\"vat\":" << (i % 2 ? 20 : 5) << "}"
+           << ",\"permissions\":[\"read\",\"list\"" << (i % 3 ? ",\"write\"" : "") << "]}";
+    }
+    os << ']';
+    string s = os.str();
+
+    istringstream is(s);
+    stream_reader r(&is, s.size() + 1, true);
+    parser p(r);
+    size_t base = live_bytes;
+    auto j = p.parse();
+    size_t before = live_bytes - base;
+
+    timer t;
+    size_t n = j->deduplicate();
+    double ms = t.elapsed_ms();
+    size_t after = live_bytes - base;
+
+    cout << "deduplicate_catalog: " << n << " objects and arrays shared in " << ms << " ms, "
+         << before / 1024 << " KB before, " << after / 1024 << " KB after, "
+         << 100.0 * (before - after) / before << "% saved" << endl;
+}
+
+void bench_record_array()
+{
+    ostringstream os;
+    os << '[';
+    for (int i = 0; i < 200000; i++)
+    {
+        os << (i > 0 ? "," : "")
+           << "{\"id\":" << i << ",\"name\":\"item" << i << "\",\"price\":" << i % 100
+           << ",\"qty\":" << i % 7 << ",\"active\":" << (i % 2 ? "true" : "false")
+           << ",\"category\":\"c" << i % 10 << "\",\"rating\":" << (i % 5) + 0.5
+           << ",\"updated\":" << 1700000000 + i << "}";
+    }
+    os << ']';
+    string s = os.str();
+
+    for (int shaped = 0; shaped < 2; shaped++)
+    {
+        istringstream is(s);
+        stream_reader r(&is, s.size() + 1, true);
+        parser p(r, true, parser::max_token_length, parser::max_nesting_depth,
+                 true, true, true, nullptr, true, shaped != 0);
+        size_t base = live_bytes;
+        timer pt;
+        auto j = p.parse();
+        double parse_ms = pt.elapsed_ms();
+        size_t bytes = live_bytes - base;
+
+        const json &records = *j;
+        int64_t total = 0;
+        timer t;
+        for (int pass = 0; pass < 10; pass++)
+        {
+            for (const auto &rec : records.get_array())
+            {
+                total += static_cast<int64_t>(rec["price"]) * static_cast<int64_t>(rec["qty"]);
+            }
+        }
+        double ms = t.elapsed_ms();
+
+        const parser::statistics &stats = p.get_statistics();
+        cout << "record_array (" << (shaped ? "shaped" : "maps") << "): " << bytes / 1024 << " KB, parsed in "
+             << parse_ms << " ms (name hit rate " << stats.name_hit_rate() << ", " << stats.m_shape_hits
+             << " shape hits), 10 passes of field access in " << ms << " ms, total " << total << endl;
+    }
+}
+
+void bench_build_response()
+{
+    const int n = 200000;
+    const string description(64, 'd');
+
+    for (int moving = 0; moving < 2; moving++)
+    {
+        size_t allocations = num_allocations;
+        timer t;
+
+        json response(json::object_e);
+        json items(json::array_e);
+        for (int i = 0; i < n; i++)
+        {
+            json item(json::object_e);
+            json id(i);
+            json text(description);
+            json tags(json::array_e);
+            json tag("sale");
+
+            if (moving)
+            {
+                tags.append(std::move(tag));
+                item.insert("id", std::move(id));
+                item.insert("description", std::move(text));
+                item.insert("tags", std::move(tags));
+                items.append(std::move(item));
+            }
+            else
+            {
+                tags.append(tag);
+                item.insert("id", id);
+                item.insert("description", text);
+                item.insert("tags", tags);
+                items.append(item);
+            }
+        }
+        if (moving)
+        {
+            response.insert("items", std::move(items));
+        }
+        else
+        {
+            response.insert("items", items);
+        }
+
+        cout << "build_response (" << (moving ? "move" : "copy") << "): " << n << " items in " << t.elapsed_ms()
+             << " ms, " << num_allocations - allocations << " allocations" << endl;
+    }
+}
+
+void bench_parse_into()
+{
+    const int n = 100000;
+    ostringstream os;
+    for (int i = 0; i < n; i++)
+    {
+        os << "{\"event\":\"page_view_" << i % 10 << "\",\"user\":{\"id\":" << i
+           << ",\"name\":\"customer number " << 1000000 + i << "\",\"roles\":[\"reader\",\"subscriber\"]},"
+           << "\"position\":[" << i % 100 << "," << i % 50 << "],\"score\":" << i * 0.5
+           << ",\"items\":[{\"sku\":\"A-" << i << "\",\"qty\":1},{\"sku\":\"B-" << i << "\",\"qty\":2}]}\n";
+    }
+    string s = os.str();
+
+    for (int reuse = 0; reuse < 2; reuse++)
+    {
+        istringstream is(s);
+        stream_reader r(&is, s.size() + 1, false);
+        parser p(r, false);
+        json target;
+        size_t allocations = 0;
+        int64_t total = 0;
+        timer t;
+
+        for (int i = 0; i < n; i++)
+        {
+            // the first 100 are warm up
+            if (i == 100)
+            {
+                allocations = num_allocations;
+            }
+
+            if (reuse)
+            {
+                p.parse_into(target);
+            }
+            else
+            {
+                target = std::move(*p.parse());
+            }
+
+            const json &c = target;
+            total += static_cast<int64_t>(c["user"]["id"]);
+        }
+
+        cout << "parse_into (" << (reuse ? "parse_into" : "parse") << "): " << n << " messages in " << t.elapsed_ms()
+             << " ms, " << static_cast<double>(num_allocations - allocations) / (n - 100)
+             << " allocations per message after warm up, total " << total << endl;
+    }
+}
+
+void bench_pointer_find()
+{
+    const int n = 1000;
+    ostringstream os;
+    os << "{\"orders\":[";
+    for (int i = 0; i < n; i++)
+    {
+        os << (i ? "," : "") << "{\"id\":" << i << ",\"customer\":{\"name\":\"c" << i
+           << "\",\"address\":{\"city\":\"town\",\"zip\":\"" << 10000 + i << "\"}},\"lines\":[{\"qty\":" << i % 7 << "}]}";
+    }
+    os << "]}";
+    auto doc = parser::parse(os.str());
+    const json &d = *doc;
+
+    // built once, applied millions of times
+    vector<pointer> pointers;
+    for (int i = 0; i < 16; i++)
+    {
+        ostringstream p;
+        p << "/orders/" << i * 61 << (i % 2 ? "/customer/address/zip" : "/lines/0/qty");
+        pointers.push_back(pointer(p.str()));
+    }
+
+    const int lookups = 10000000;
+    size_t allocations = num_allocations;
+    size_t found = 0;
+    timer t;
+
+    for (int i = 0; i < lookups; i++)
+    {
+        found += d.find(pointers[i % pointers.size()]).get_instance_type();
+    }
+
+    cout << "pointer_find: " << lookups << " lookups in " << t.elapsed_ms() << " ms, "
+         << num_allocations - allocations << " allocations, " << found << endl;
+
+    // a pointer built on every call against a literal one built once
+    for (int literal = 0; literal < 2; literal++)
+    {
+        const int calls = 1000000;
+        allocations = num_allocations;
+        timer t2;
+
+        for (int i = 0; i < calls; i++)
+        {
+            if (literal)
+            {
+                found += d.find(ARGO_POINTER("/orders/500/customer/address/zip")).get_instance_type();
+            }
+            else
+            {
+                found += d.find(pointer("/orders/500/customer/address/zip")).get_instance_type();
+            }
+        }
+
+        cout << "pointer_find (" << (literal ? "ARGO_POINTER" : "pointer per call") << "): " << calls
+             << " lookups in " << t2.elapsed_ms() << " ms, " << num_allocations - allocations << " allocations" << endl;
+    }
+
+    // every zip code, a find per index against one wildcard walk
+    for (int wildcard = 0; wildcard < 2; wildcard++)
+    {
+        const int rounds = 1000;
+        pointer all("/orders/*/customer/address/zip");
+        size_t zips = 0;
+        timer t3;
+
+        for (int r = 0; r < rounds; r++)
+        {
+            if (wildcard)
+            {
+                d.find_all(all, [&zips](const json &) { zips++; });
+            }
+            else
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    ostringstream p;
+                    p << "/orders/" << i << "/customer/address/zip";
+                    zips += d.find(pointer(p.str())).get_instance_type() == json::string_e;
+                }
+            }
+        }
+
+        cout << "pointer_find (" << (wildcard ? "find_all" : "find per index") << "): " << zips << " matches in "
+             << t3.elapsed_ms() << " ms" << endl;
+    }
+}
+
+void bench_pointer_set()
+{
+    const int n = 100000;
+    vector<string> messages;
+    for (int i = 0; i < 100; i++)
+    {
+        ostringstream os;
+        os << "{\"payload\":{\"meta\":{\"id\":" << i << ",\"source\":\"web\",\"region\":\"eu\",\"tenant\":\"t" << i % 5
+           << "\"},\"user\":{\"id\":" << i * 3 << ",\"name\":\"u\",\"address\":{\"city\":\"c\",\"zip\":\"z\",\"country\":\"nz\"}},"
+           << "\"lines\":[{\"sku\":\"a\",\"qty\":1},{\"sku\":\"b\",\"qty\":2},{\"sku\":\"c\",\"qty\":3}]},\"version\":2}";
+        messages.push_back(os.str());
+    }
+    vector<unique_ptr<json>> docs;
+    for (const auto &m : messages)
+    {
+        docs.push_back(parser::parse(m));
+    }
+
+    // 40 pointers sharing a handful of prefixes, a few of them missing
+    vector<pointer> pointers;
+    const char *leaves[] = {
+        "/payload/meta/id", "/payload/meta/source", "/payload/meta/region", "/payload/meta/tenant", "/payload/meta/trace",
+        "/payload/user/id", "/payload/user/name", "/payload/user/address/city", "/payload/user/address/zip",
+        "/payload/user/address/country", "/version"
+    };
+    for (auto l : leaves)
+    {
+        pointers.push_back(pointer(l));
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        for (auto f : {"/sku", "/qty", "/price"})
+        {
+            ostringstream p;
+            p << "/payload/lines/" << i << f;
+            pointers.push_back(pointer(p.str()));
+        }
+    }
+    while (pointers.size() < 40)
+    {
+        pointers.push_back(pointers[pointers.size() % 11]);
+    }
+    pointer_set s(pointers);
+
+    for (int set = 0; set < 2; set++)
+    {
+        vector<const json *> results(pointers.size());
+        size_t found = 0;
+        size_t allocations = num_allocations;
+        timer t;
+
+        for (int i = 0; i < n; i++)
+        {
+            const json &d = *docs[i % docs.size()];
+
+            if (set)
+            {
+                d.find(s, results);
+            }
+            else
+            {
+                for (size_t p = 0; p < pointers.size(); p++)
+                {
+                    results[p] = d.try_find(pointers[p]);
+                }
+            }
+
+            for (auto r : results)
+            {
+                found += r != nullptr;
+            }
+        }
+
+        cout << "pointer_set (" << (set ? "pointer_set" : "try_find each") << "): " << n << " messages x "
+             << pointers.size() << " pointers in " << t.elapsed_ms() << " ms, " << num_allocations - allocations
+             << " allocations, " << found << " found" << endl;
+    }
+}
+
+void bench_json_index()
+{
+    const int n = 100000;
+    ostringstream os;
+    os << "[";
+    for (int i = 0; i < n; i++)
+    {
+        os << (i ? "," : "") << "{\"id\":" << i * 7 << ",\"owner\":\"o" << i << "\",\"balance\":" << i % 1000 << "}";
+    }
+    os << "]";
+    auto accounts = parser::parse(os.str());
+    const json &a = *accounts;
+
+    // a scan as done without an index
+    const int scans = 1000;
+    size_t found = 0;
+    timer t;
+    for (int64_t q = 0; q < scans; q++)
+    {
+        int64_t id = (q * 7919 % n) * 7;
+        for (const auto &e : a.get_array())
+        {
+            if (e["id"] == id)
+            {
+                found++;
+                break;
+            }
+        }
+    }
+    double scan_ms = t.elapsed_ms();
+
+    timer b;
+    json_index by_id(*accounts, pointer("/id"));
+    double build_ms = b.elapsed_ms();
+
+    const int lookups = 1000000;
+    timer l;
+    for (int64_t q = 0; q < lookups; q++)
+    {
+        found += by_id.find(json((q * 7919 % n) * 7)) != nullptr;
+    }
+    double lookup_ms = l.elapsed_ms();
+
+    cout << "json_index: " << n << " elements, scan " << scan_ms * 1000000 / scans << " ns per lookup, index built in "
+         << build_ms << " ms, " << lookup_ms * 1000000 / lookups << " ns per lookup, " << found << " found" << endl;
+}
+
+// an object of objects depth levels deep with width members at each level
+static void write_config(ostream &os, int depth, int width)
+{
+    if (depth == 0)
+    {
+        os << "{\"enabled\":true,\"limit\":" << width << "}";
+        return;
+    }
+    os << "{";
+    for (int i = 0; i < width; i++)
+    {
+        os << (i ? "," : "") << "\"section_" << i << "\":";
+        write_config(os, depth - 1, width);
+    }
+    os << "}";
+}
+
+// turn every shaped object back into an ordinary one, as editing a document does
+static void unshape(json &j)
+{
+    if (j.get_instance_type() == json::object_e)
+    {
+        for (auto &m : j.get_object())
+        {
+            unshape(m.second);
+        }
+    }
+}
+
+void bench_path_index()
+{
+    const int depth = 5;
+    const int width = 8;
+    ostringstream os;
+    write_config(os, depth, width);
+    string s = os.str();
+    istringstream is(s);
+    stream_reader config_reader(&is, s.size() + 1, true);
+    parser config_parser(config_reader, true, parser::max_token_length, parser::max_nesting_depth,
+                         true, true, true, nullptr, true, true);
+    auto doc = config_parser.parse();
+
+    vector<pointer> pointers;
+    for (int i = 0; i < 4096; i++)
+    {
+        ostringstream p;
+        for (int level = 0, r = i * 2654435761u % 32768; level < depth; level++, r /= width)
+        {
+            p << "/section_" << r % width;
+        }
+        p << "/limit";
+        pointers.push_back(pointer(p.str()));
+    }
+
+    // as parsed, then with every object a std::map
+    for (int shaped = 1; shaped >= 0; shaped--)
+    {
+        if (!shaped)
+        {
+            unshape(*doc);
+        }
+        const json &d = *doc;
+
+        const int lookups = 4000000;
+        size_t found = 0;
+        timer w;
+        for (int i = 0; i < lookups; i++)
+        {
+            found += d.find(pointers[i % pointers.size()]).get_instance_type();
+        }
+        double walk_ms = w.elapsed_ms();
+
+        timer b;
+        path_index index(d);
+        double build_ms = b.elapsed_ms();
+
+        timer l;
+        for (int i = 0; i < lookups; i++)
+        {
+            found += index.find(pointers[i % pointers.size()]).get_instance_type();
+        }
+        double index_ms = l.elapsed_ms();
+
+        cout << "path_index (" << (shaped ? "shaped" : "map") << "): " << index.size() << " nodes indexed in "
+             << build_ms << " ms, " << depth + 1 << " tokens per pointer, walk " << walk_ms * 1000000 / lookups
+             << " ns per lookup, index " << index_ms * 1000000 / lookups << " ns per lookup, " << found << endl;
+    }
+}
+
+void bench_json_patch()
+{
+    const int n = 200000;
+    ostringstream os;
+    os << "{\"accounts\":[";
+    for (int i = 0; i < n; i++)
+    {
+        os << (i ? "," : "") << "{\"id\":" << i << ",\"owner\":{\"name\":\"o" << i << "\",\"city\":\"town\"},"
+           << "\"balance\":" << i % 1000 << ",\"tags\":[\"a\",\"b\"],\"note\":\"none\"}";
+    }
+    os << "]}";
+    string s = os.str();
+    istringstream is(s);
+    stream_reader r(&is, s.size() + 1, true);
+    parser pr(r);
+    auto doc = pr.parse();
+
+    // small patches to random accounts, each compiled from its text as it arrives
+    vector<string> patches;
+    for (int64_t i = 0; i < 1000; i++)
+    {
+        int64_t a = i * 7919 % n;
+        ostringstream p;
+        p << "[{\"op\":\"replace\",\"path\":\"/accounts/" << a << "/balance\",\"value\":" << i << "},"
+          << "{\"op\":\"add\",\"path\":\"/accounts/" << a << "/tags/-\",\"value\":\"p" << i << "\"},"
+          << "{\"op\":\"move\",\"from\":\"/accounts/" << a << "/note\",\"path\":\"/accounts/" << a << "/owner/note\"},"
+          << "{\"op\":\"copy\",\"from\":\"/accounts/" << a << "/owner/note\",\"path\":\"/accounts/" << a << "/note\"},"
+          << "{\"op\":\"test\",\"path\":\"/accounts/" << a << "/id\",\"value\":" << a << "}]";
+        patches.push_back(p.str());
+    }
+
+    timer t;
+    for (const auto &p : patches)
+    {
+        json_patch(*parser::parse(p)).apply(*doc);
+    }
+    double patch_ms = t.elapsed_ms();
+
+    // all or nothing by working on a copy that replaces the document on success
+    const int copies = 10;
+    timer c;
+    for (int i = 0; i < copies; i++)
+    {
+        json copy(*doc, new_delete_resource());
+        json_patch(*parser::parse(patches[i])).apply(copy);
+        *doc = std::move(copy);
+    }
+    double copy_ms = c.elapsed_ms();
+
+    // a patch that fails at its last operation and is undone
+    string failing = patches[0];
+    failing.insert(failing.size() - 1, ",{\"op\":\"test\",\"path\":\"/accounts/0/id\",\"value\":-1}");
+    json_patch undone(*parser::parse(failing));
+    const int failures = 1000;
+    timer f;
+    for (int i = 0; i < failures; i++)
+    {
+        try
+        {
+            undone.apply(*doc);
+        }
+        catch (json_exception &)
+        {
+        }
+    }
+    double fail_ms = f.elapsed_ms();
+
+    cout << "json_patch: " << s.size() / (1024 * 1024) << " MB, 5 operation patches in place "
+         << patch_ms * 1000 / patches.size() << " us each, on a copy " << copy_ms * 1000 / copies
+         << " us each, failing and undone " << fail_ms * 1000 / failures << " us each" << endl;
+}
+
+void bench_json_diff()
+{
+    const int n = 100000;
+    ostringstream os, changed;
+    os << "{\"accounts\":[";
+    changed << "{\"accounts\":[";
+    for (int i = 0; i < n; i++)
+    {
+        for (int c = 0; c < 2; c++)
+        {
+            // the second version has 10 balances changed and 10 accounts appended
+            int balance = c && i % (n / 10) == 0 ? -1 : i % 1000;
+            (c ? changed : os) << (i ? "," : "") << "{\"id\":" << i << ",\"owner\":{\"name\":\"o" << i
+                               << "\",\"city\":\"town\"},\"balance\":" << balance << ",\"tags\":[\"a\",\"b\"]}";
+        }
+    }
+    for (int i = n; i < n + 10; i++)
+    {
+        changed << ",{\"id\":" << i << "}";
+    }
+    os << "]}";
+    changed << "]}";
+
+    string s = os.str();
+    string t = changed.str();
+    istringstream is(s), it(t), iu(s);
+    stream_reader rs(&is, s.size() + 1, true), rt(&it, t.size() + 1, true), ru(&iu, s.size() + 1, true);
+    parser ps(rs), pt(rt), pu(ru);
+    auto source = ps.parse();
+    auto target = pt.parse();
+    auto same = pu.parse();
+
+    // the time to compare two equal documents sets the scale
+    timer e;
+    bool equal = *source == *same;
+    double equal_ms = e.elapsed_ms();
+
+    timer d;
+    json patch = json_patch::diff(*source, *target);
+    double diff_ms = d.elapsed_ms();
+
+    // again, now that the hashes are known
+    timer d2;
+    json again = json_patch::diff(*source, *target);
+    double again_ms = d2.elapsed_ms();
+
+    ostringstream out;
+    out << patch;
+
+    cout << "json_diff: " << s.size() / (1024 * 1024) << " MB, " << patch.get_array().size() << " operations ("
+         << out.str().size() << " bytes) in " << diff_ms << " ms, " << again_ms << " ms with the hashes known, "
+         << "operator== on equal documents " << equal_ms << " ms " << equal << endl;
+}
+
+// a merge as written by hand, copying what it takes from the patch
+static void copy_merge(json &target, const json &patch)
+{
+    if (patch.get_instance_type() != json::object_e)
+    {
+        target = json(patch, new_delete_resource());
+        return;
+    }
+    if (target.get_instance_type() != json::object_e)
+    {
+        target = json(json::object_e);
+    }
+    json::json_object &o = target.get_object();
+    for (const auto &m : patch.get_object())
+    {
+        if (m.second.get_instance_type() == json::null_e)
+        {
+            o.erase(m.first);
+        }
+        else
+        {
+            copy_merge(o[m.first], m.second);
+        }
+    }
+}
+
+void bench_merge_patch()
+{
+    const int sections = 2000;
+    const int overlays = 8;
+    ostringstream base;
+    base << "{";
+    for (int i = 0; i < sections; i++)
+    {
+        base << (i ? "," : "") << "\"s" << i << "\":{\"enabled\":true,\"limit\":" << i
+             << ",\"hosts\":[\"a\",\"b\",\"c\"],\"retry\":{\"count\":3,\"delay\":1.5}}";
+    }
+    base << "}";
+
+    // each overlay changes, removes and adds settings in a tenth of the sections
+    vector<string> texts;
+    for (int o = 0; o < overlays; o++)
+    {
+        ostringstream os;
+        os << "{";
+        for (int i = o; i < sections; i += 10)
+        {
+            os << (i != o ? "," : "") << "\"s" << i << "\":{\"limit\":" << -i << ",\"enabled\":null,"
+               << "\"retry\":{\"delay\":" << o << "},\"extra\":{\"owner\":\"team" << o
+               << "\",\"tags\":[\"x\",\"y\"]}}";
+        }
+        os << "}";
+        texts.push_back(os.str());
+    }
+
+    const int reloads = 50;
+    double times[2] = {0, 0};
+    size_t allocations[2] = {0, 0};
+    size_t check[2] = {0, 0};
+
+    for (int r = 0; r < reloads; r++)
+    {
+        for (int moved = 0; moved < 2; moved++)
+        {
+            auto config = parser::parse(base.str());
+            vector<unique_ptr<json>> layers;
+            for (const auto &t : texts)
+            {
+                layers.push_back(parser::parse(t));
+            }
+
+            timer t;
+            for (auto &l : layers)
+            {
+                if (moved)
+                {
+                    config->merge_patch(std::move(*l));
+                }
+                else
+                {
+                    copy_merge(*config, *l);
+                }
+            }
+            times[moved] += t.elapsed_ms();
+            allocations[moved] += t.allocations();
+            check[moved] += config->hash();
+        }
+    }
+
+    cout << "merge_patch: " << overlays << " overlays onto " << sections << " sections, copying "
+         << times[0] * 1000 / reloads << " us " << allocations[0] / reloads << " allocations, moving "
+         << times[1] * 1000 / reloads << " us " << allocations[1] / reloads << " allocations, same result "
+         << (check[0] == check[1]) << endl;
+}
+
+void bench_exception_free()
+{
+    // records from a loosely specified feed, a third missing the optional
+    // field and a third with it in the wrong type
+    const int records = 100000;
+    ostringstream os;
+    os << "[";
+    for (int i = 0; i < records; i++)
+    {
+        os << (i ? "," : "") << "{\"id\":" << i;
+        if (i % 3 == 1)
+        {
+            os << ",\"weight\":" << i % 100;
+        }
+        else if (i % 3 == 2)
+        {
+            os << ",\"weight\":\"n/a\"";
+        }
+        os << "}";
+    }
+    os << "]";
+
+    auto doc = parser::parse(os.str());
+    const json &a = *doc;
+
+    timer t;
+    int64_t sum[2] = {0, 0};
+    for (size_t i = 0; i < records; i++)
+    {
+        try
+        {
+            sum[0] += static_cast<int>(a[i]["weight"]);
+        }
+        catch (json_exception &)
+        {
+            sum[0] += 1;
+        }
+    }
+    double throwing = t.elapsed_ms();
+
+    t = timer();
+    for (size_t i = 0; i < records; i++)
+    {
+        const json *w = a[i].try_get("weight");
+        sum[1] += w ? w->value_or(1) : 1;
+    }
+    double exception_free = t.elapsed_ms();
+
+    cout << "exception_free: " << records << " records, throw and catch " << throwing << " ms, try_get and value_or "
+         << exception_free << " ms, same result " << (sum[0] == sum[1]) << endl;
+}
+
+void bench_parse_parallel()
+{
+    // an import file, one big array of records
+    const int records = 300000;
+    ostringstream os;
+    os << "[\n";
+    for (int i = 0; i < records; i++)
+    {
+        os << (i ? ",\n" : "") << "{\"id\":" << i << ",\"name\":\"customer " << i << "\",\"balance\":" << i * 0.25
+           << ",\"active\":" << (i % 2 ? "true" : "false") << ",\"tags\":[\"t" << i % 7 << "\",\"t" << i % 11
+           << "\"],\"address\":{\"street\":\"" << i << " Main St\",\"zip\":\"" << 10000 + i % 90000 << "\"}}";
+    }
+    os << "\n]\n";
+    string s = os.str();
+
+    timer t1;
+    memory_reader r(s.data(), s.size(), SIZE_MAX);
+    parser p(r);
+    auto sequential = p.parse();
+    double single = t1.elapsed_ms();
+
+    cout << "parse_parallel: " << s.size() / (1024 * 1024) << " MB, " << thread::hardware_concurrency()
+         << " cores, one thread " << single << " ms";
+
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u})
+    {
+        timer t2;
+        auto parallel = parser::parse_parallel(s.data(), s.size(), threads);
+        cout << ", " << threads << " threads " << t2.elapsed_ms() << " ms";
+        if (*parallel != *sequential)
+        {
+            cout << " (different)";
+        }
+    }
+    cout << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    string which = argc > 1 ? argv[1] : "";
+
+    try
+    {
+        if (which == "" || which == "parse_small_containers")
+        {
+            bench_parse_small_containers();
+        }
+        if (which == "" || which == "sum_time_series")
+        {
+            bench_sum_time_series();
+        }
+        if (which == "" || which == "copy_large_document")
+        {
+            bench_copy_large_document();
+        }
+        if (which == "" || which == "deduplicate_catalog")
+        {
+            bench_deduplicate_catalog();
+        }
+        if (which == "" || which == "record_array")
+        {
+            bench_record_array();
+        }
+        if (which == "" || which == "build_response")
+        {
+            bench_build_response();
+        }
+        if (which == "" || which == "parse_into")
+        {
+            bench_parse_into();
+        }
+        if (which == "" || which == "pointer_find")
+        {
+            bench_pointer_find();
+        }
+        if (which == "" || which == "pointer_set")
+        {
+            bench_pointer_set();
+        }
+        if (which == "" || which == "json_index")
+        {
+            bench_json_index();
+        }
+        if (which == "" || which == "path_index")
+        {
+            bench_path_index();
+        }
+        if (which == "" || which == "json_patch")
+        {
+            bench_json_patch();
+        }
+        if (which == "" || which == "json_diff")
+        {
+            bench_json_diff();
+        }
+        if (which == "" || which == "merge_patch")
+        {
+            bench_merge_patch();
+        }
+        if (which == "" || which == "exception_free")
+        {
+            bench_exception_free();
+        }
+        if (which == "" || which == "parse_parallel")
+        {
+            bench_parse_parallel();
+        }
+    }
+    catch (json_exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -52,6 +52,24 @@ json_exception::json_exception(exception_type et) noexcept : exception(), m_type
     case pointer_token_type_invalid_e:
         strncpy(m_message, "pointer token type is invalid", max_message_length);
         break;
+    case number_out_of_range_e:
+        strncpy(m_message, "number is out of range for the requested type", max_message_length);
+        break;
+    case not_packed_array_e:
+        strncpy(m_message, "instance is not an array packed with numbers of the requested type", max_message_length);
+        break;
+    case not_shaped_object_e:
+        strncpy(m_message, "instance is not a shaped object", max_message_length);
+        break;
+    case shape_size_mismatch_e:
+        strncpy(m_message, "number of values doesn't match the number of names in the shape", max_message_length);
+        break;
+    case invalid_patch_e:
+        strncpy(m_message, "patch is not a valid JSON Patch document", max_message_length);
+        break;
+    case patch_test_failed_e:
+        strncpy(m_message, "patch test operation failed", max_message_length);
+        break;
     default:
         strncpy(m_message, "generic", max_message_length);
         break;
@@ -88,6 +88,12 @@ namespace NAMESPACE
             pointer_not_matched_e,
             /// Invalid pointer token type
             pointer_token_type_invalid_e,
+            /// Attempt to get the packed elements of an array that isn't packed with the requested type
+            not_packed_array_e,
+            /// Attempt to get the values of an object that isn't shaped
+            not_shaped_object_e,
+            /// The number of values doesn't match the number of names in the shape
+            shape_size_mismatch_e,
 
             /// The stdio fgetc call failed in an unexpected way.
             fgetc_failed_e,
@@ -139,7 +145,14 @@ namespace NAMESPACE
             invalid_hex_number_e,
 
             /// Syntax error parsing a pointer definition
-            syntax_error_in_pointer_string_e
+            syntax_error_in_pointer_string_e,
+            /// Syntax error parsing a JSONPath expression
+            syntax_error_in_json_path_e,
+
+            /// A JSON Patch document isn't as RFC 6902 describes
+            invalid_patch_e,
+            /// The test operation of a JSON Patch failed
+            patch_test_failed_e
         }
         exception_type;
 
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file json_index.cpp The json_index class implementation.
+
+#include <algorithm>
+#include <utility>
+
+#include "common.hpp"
+#include "json_index.hpp"
+#include "json_exception.hpp"
+
+using namespace NAMESPACE;
+
+json_index::json_index(json &array, const pointer &key) : m_array(array), m_key(key), m_mask(0), m_size(0)
+{
+    rebuild();
+}
+
+const json *json_index::find(const json &key) const
+{
+    if (m_size == 0)
+    {
+        return nullptr;
+    }
+
+    size_t h = key.hash();
+
+    // Linear probing from the hash, positions with the same hash are met
+    // in the order they were added which is array order.
+    for (size_t i = h & m_mask; m_slots[i].m_position != 0; i = (i + 1) & m_mask)
+    {
+        if (m_slots[i].m_hash == h)
+        {
+            const json &e = element(m_slots[i].m_position - 1);
+            const json *k = e.try_find(m_key);
+            if (k != nullptr && *k == key)
+            {
+                return &e;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+std::vector<const json *> json_index::find_all(const json &key) const
+{
+    std::vector<const json *> res;
+
+    if (m_size == 0)
+    {
+        return res;
+    }
+
+    size_t h = key.hash();
+
+    for (size_t i = h & m_mask; m_slots[i].m_position != 0; i = (i + 1) & m_mask)
+    {
+        if (m_slots[i].m_hash == h)
+        {
+            const json &e = element(m_slots[i].m_position - 1);
+            const json *k = e.try_find(m_key);
+            if (k != nullptr && *k == key)
+            {
+                res.push_back(&e);
+            }
+        }
+    }
+
+    return res;
+}
+
+const json &json_index::append(json &&element)
+{
+    const json &res = m_array.append(std::move(element));
+    add(m_array.size() - 1);
+    return res;
+}
+
+void json_index::rebuild()
+{
+    if (m_array.get_instance_type() != json::array_e)
+    {
+        throw json_exception(json_exception::not_an_array_e);
+    }
+
+    size_t n = m_array.size();
+
+    m_slots.clear();
+    m_mask = 0;
+    m_size = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        add(i);
+    }
+}
+
+size_t json_index::size() const noexcept
+{
+    return m_size;
+}
+
+void json_index::add(size_t i)
+{
+    const json *k = element(i).try_find(m_key);
+
+    if (k == nullptr)
+    {
+        return;
+    }
+
+    // Keep the table at most half full. Growing re-inserts in the existing
+    // table order, which keeps equal hashes in array order.
+    if ((m_size + 1) * 2 > m_slots.size())
+    {
+        std::vector<slot> old;
+        old.swap(m_slots);
+
+        size_t n = old.empty() ? 16 : old.size() * 2;
+        m_slots.assign(n, slot{0, 0});
+        m_mask = n - 1;
+
+        std::vector<const slot *> used;
+        used.reserve(m_size);
+        for (const auto &s : old)
+        {
+            if (s.m_position != 0)
+            {
+                used.push_back(&s);
+            }
+        }
+        std::sort(used.begin(), used.end(), [](const slot *x, const slot *y) { return x->m_position < y->m_position; });
+        for (auto s : used)
+        {
+            insert(s->m_hash, s->m_position);
+        }
+    }
+
+    insert(k->hash(), i + 1);
+    m_size++;
+}
+
+void json_index::insert(size_t hash, size_t position)
+{
+    size_t i = hash & m_mask;
+
+    while (m_slots[i].m_position != 0)
+    {
+        i = (i + 1) & m_mask;
+    }
+
+    m_slots[i] = slot{hash, position};
+}
+
+const json &json_index::element(size_t i) const
+{
+    return static_cast<const json &>(m_array)[i];
+}
@@ -0,0 +1,112 @@
+#ifndef _json_index_hpp_
+#define _json_index_hpp_
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file json_index.hpp The json_index class.
+
+#include <vector>
+
+#include "common.hpp"
+#include "json.hpp"
+#include "pointer.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * \brief A hash index over an array of objects.
+     *
+     * Maps the value found at a key pointer in each element, e.g. /id, to
+     * the position of the element so that finding the element with a given
+     * key doesn't need a scan of the array. Keys are hashed with json::hash()
+     * and compared with operator== so, as for those, 1 and 1.0 are the same
+     * key. Elements without the key aren't indexed.
+     *
+     * The index keeps itself up to date for elements added with append().
+     * After any other change to the array call rebuild(). Pointers returned
+     * by find() are into the array and are valid until it is next changed.
+     * Any number of threads may call the const methods at once.
+     */
+    class json_index
+    {
+    public:
+
+        /**
+         * Index the elements of array.
+         * \param array   The array, which must outlive the index.
+         * \param key     Where the key is in each element.
+         * \throw json_exception if array isn't an array.
+         */
+        json_index(json &array, const pointer &key);
+
+        /// The first element, in array order, whose key equals key or nullptr.
+        const json *find(const json &key) const;
+
+        /// Every element whose key equals key, in array order.
+        std::vector<const json *> find_all(const json &key) const;
+
+        /**
+         * Append an element to the array and index it.
+         * \return    The element in place.
+         */
+        const json &append(json &&element);
+
+        /// Index the array again from scratch.
+        void rebuild();
+
+        /// The number of elements indexed.
+        size_t size() const noexcept;
+
+    private:
+
+        /// A slot of the open addressing table, m_position is 0 if it's free.
+        struct slot
+        {
+            size_t m_hash;
+            size_t m_position;
+        };
+
+        /// Add element i of the array, growing the table if needed.
+        void add(size_t i);
+
+        /// Put a position in the table without checking the load.
+        void insert(size_t hash, size_t position);
+
+        /// Element i of the indexed array, read const so that a packed
+        /// array isn't unpacked or given a view of all its elements.
+        const json &element(size_t i) const;
+
+        json &m_array;
+        pointer m_key;
+
+        /// Positions are stored plus one so that 0 marks a free slot.
+        std::vector<slot> m_slots;
+
+        /// m_slots.size() - 1, the table size is a power of two.
+        size_t m_mask;
+
+        size_t m_size;
+    };
+}
+
+#endif
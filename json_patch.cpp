@@ -0,0 +1,651 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file json_patch.cpp The json_patch class implementation.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "common.hpp"
+#include "json_exception.hpp"
+#include "json_patch.hpp"
+#include "utf8.hpp"
+
+using namespace NAMESPACE;
+
+static bool patch_same_token(const pointer::token &a, const pointer::token &b)
+{
+    if (a.get_type() != b.get_type())
+    {
+        return false;
+    }
+    else if (a.get_type() == pointer::token::object_e)
+    {
+        return a.get_name() == b.get_name();
+    }
+    else
+    {
+        return a.get_index() == b.get_index();
+    }
+}
+
+// True if a is a proper prefix of b.
+static bool patch_is_prefix(const pointer &a, const pointer &b)
+{
+    const auto &ap = a.get_tokens();
+    const auto &bp = b.get_tokens();
+
+    if (ap.back().get_type() == pointer::token::all_e)
+    {
+        return bp.back().get_type() != pointer::token::all_e;
+    }
+    else if (ap.size() >= bp.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < ap.size(); i++)
+    {
+        if (!patch_same_token(ap[i], bp[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static const std::string &patch_string_member(const json &op, const char *name)
+{
+    if (!op.has(name) || op[name].get_instance_type() != json::string_e)
+    {
+        throw json_exception(json_exception::invalid_patch_e);
+    }
+    return op[name];
+}
+
+// Escape a member name as a pointer token.
+static void patch_append_token(std::string &path, const std::string &name)
+{
+    path += '/';
+    for (auto c : name)
+    {
+        if (c == '~')
+        {
+            path += "~0";
+        }
+        else if (c == '/')
+        {
+            path += "~1";
+        }
+        else
+        {
+            path += c;
+        }
+    }
+}
+
+static void patch_append_token(std::string &path, size_t index)
+{
+    path += '/';
+    path += std::to_string(index);
+}
+
+static void patch_append_operation(json &patch, const char *op, const std::string &path, const json *value)
+{
+    json o(json::object_e);
+    o.insert("op", json(op));
+    o.insert("path", json(path));
+    if (value != nullptr)
+    {
+        o.insert("value", json(*value));
+    }
+    patch.append(std::move(o));
+}
+
+// Element i of source against element j of target, straight from the values
+// when both are packed the same way so that neither needs its elements built.
+static bool patch_same_element(const json &source, size_t i, const json &target, size_t j)
+{
+    json::type packed = source.get_packed_type();
+
+    if (packed != json::null_e && packed == target.get_packed_type())
+    {
+        return packed == json::number_int_e ?
+                    source.as_span<int64_t>()[i] == target.as_span<int64_t>()[j] :
+                    source.as_span<double>()[i] == target.as_span<double>()[j];
+    }
+    return source[i] == target[j];
+}
+
+/*
+ * Walks the members of an object in name order, straight off the shape for
+ * a shaped object so that diffing never builds its map view.
+ */
+class patch_member_cursor
+{
+public:
+    explicit patch_member_cursor(const json &j) :
+        m_shaped(j.is_shaped()),
+        m_names(m_shaped ? &j.get_shape()->get_names() : nullptr),
+        m_values(m_shaped ? j.get_shape_values() : span<const json>(nullptr, 0)),
+        m_index(0)
+    {
+        if (!m_shaped)
+        {
+            m_object = &j.get_object();
+            m_it = m_object->begin();
+        }
+    }
+
+    bool done() const
+    {
+        return m_shaped ? m_index == m_names->size() : m_it == m_object->end();
+    }
+
+    const std::string &name() const
+    {
+        return m_shaped ? (*m_names)[m_index] : m_it->first;
+    }
+
+    const json &value() const
+    {
+        return m_shaped ? m_values[m_index] : m_it->second;
+    }
+
+    void next()
+    {
+        if (m_shaped)
+        {
+            m_index++;
+        }
+        else
+        {
+            ++m_it;
+        }
+    }
+
+private:
+    bool m_shaped;
+    const std::vector<std::string> *m_names;
+    span<const json> m_values;
+    size_t m_index;
+    const json::json_object *m_object = nullptr;
+    json::json_object::const_iterator m_it;
+};
+
+json_patch::location::location(const json &op, const char *member) :
+                            m_root(false),
+                            m_parent(std::vector<pointer::token>()),
+                            m_index(SIZE_MAX),
+                            m_path(*utf8::utf8_to_json_string(patch_string_member(op, member)))
+{
+    const auto &path = m_path.get_tokens();
+    const pointer::token &last = path.back();
+
+    if (last.get_type() == pointer::token::all_e)
+    {
+        m_root = true;
+        return;
+    }
+
+    m_parent = pointer(std::vector<pointer::token>(path.begin(), path.end() - 1));
+
+    // An index is only an index if the container turns out to be an
+    // array, in an object it's the member name.
+    if (last.get_type() == pointer::token::array_e)
+    {
+        m_index = last.get_index();
+        m_name = std::to_string(m_index);
+    }
+    else
+    {
+        m_name = last.get_name();
+    }
+}
+
+json_patch::operation_type json_patch::operation::get_type(const json &op)
+{
+    if (op.get_instance_type() != json::object_e)
+    {
+        throw json_exception(json_exception::invalid_patch_e);
+    }
+
+    const std::string &s = patch_string_member(op, "op");
+
+    if (s == "add")
+    {
+        return add_e;
+    }
+    else if (s == "remove")
+    {
+        return remove_e;
+    }
+    else if (s == "replace")
+    {
+        return replace_e;
+    }
+    else if (s == "move")
+    {
+        return move_e;
+    }
+    else if (s == "copy")
+    {
+        return copy_e;
+    }
+    else if (s == "test")
+    {
+        return test_e;
+    }
+    else
+    {
+        throw json_exception(json_exception::invalid_patch_e);
+    }
+}
+
+json_patch::operation::operation(const json &op) :
+                            m_type(get_type(op)),
+                            m_path(op, "path"),
+                            m_from(op, m_type == move_e || m_type == copy_e ? "from" : "path")
+{
+    if (m_type == add_e || m_type == replace_e || m_type == test_e)
+    {
+        if (!op.has("value"))
+        {
+            throw json_exception(json_exception::invalid_patch_e);
+        }
+        m_value = op["value"];
+    }
+    else if (m_type == move_e && patch_is_prefix(m_from.m_path, m_path.m_path))
+    {
+        // a location can't be moved into one of its own children
+        throw json_exception(json_exception::invalid_patch_e);
+    }
+}
+
+json_patch::json_patch(const json &patch)
+{
+    if (patch.get_instance_type() != json::array_e)
+    {
+        throw json_exception(json_exception::invalid_patch_e);
+    }
+
+    for (const auto &op : patch.get_array())
+    {
+        m_operations.emplace_back(op);
+    }
+}
+
+void json_patch::apply(json &target) const
+{
+    // At most two changes per operation, reserving means that references
+    // into the log stay valid.
+    std::vector<change> log;
+    log.reserve(m_operations.size() * 2);
+
+    try
+    {
+        for (const auto &op : m_operations)
+        {
+            switch (op.m_type)
+            {
+            case add_e:
+                put(target, op.m_path, json(op.m_value), false, log);
+                break;
+
+            case replace_e:
+                put(target, op.m_path, json(op.m_value), true, log);
+                break;
+
+            case remove_e:
+                take(target, op.m_path, log);
+                break;
+
+            case move_e:
+            {
+                take(target, op.m_from, log);
+                size_t t = log.size() - 1;
+                put(target, op.m_path, std::move(log[t].m_value), false, log);
+                log[t].m_moved = true;
+                break;
+            }
+
+            case copy_e:
+            {
+                const json *from = target.try_find(op.m_from.m_path);
+                if (from == nullptr)
+                {
+                    throw json_exception(json_exception::pointer_not_matched_e);
+                }
+                put(target, op.m_path, json(*from), false, log);
+                break;
+            }
+
+            case test_e:
+            {
+                const json *j = target.try_find(op.m_path.m_path);
+                if (j == nullptr || !(*j == op.m_value))
+                {
+                    throw json_exception(json_exception::patch_test_failed_e);
+                }
+                break;
+            }
+            }
+        }
+    }
+    catch (...)
+    {
+        json moved;
+        for (size_t i = log.size(); i-- > 0;)
+        {
+            undo(target, log[i], moved);
+        }
+        throw;
+    }
+}
+
+size_t json_patch::size() const noexcept
+{
+    return m_operations.size();
+}
+
+json json_patch::diff(const json &source, const json &target)
+{
+    // This caches the hash of every object and array in both.
+    source.hash();
+    target.hash();
+
+    json patch(json::array_e);
+    std::string path;
+    diff(source, target, path, patch);
+    return patch;
+}
+
+void json_patch::diff(const json &source, const json &target, std::string &path, json &patch)
+{
+    // With the hashes cached this is quick when the two differ and, for
+    // copies, when they share storage.
+    if (source == target)
+    {
+        return;
+    }
+    else if (source.get_instance_type() == json::object_e && target.get_instance_type() == json::object_e)
+    {
+        diff_objects(source, target, path, patch);
+    }
+    else if (source.get_instance_type() == json::array_e && target.get_instance_type() == json::array_e)
+    {
+        diff_arrays(source, target, path, patch);
+    }
+    else
+    {
+        patch_append_operation(patch, "replace", path, &target);
+    }
+}
+
+void json_patch::diff_objects(const json &source, const json &target, std::string &path, json &patch)
+{
+    size_t length = path.size();
+
+    patch_member_cursor i(source);
+    patch_member_cursor j(target);
+
+    while (!i.done() || !j.done())
+    {
+        if (j.done() || (!i.done() && i.name() < j.name()))
+        {
+            patch_append_token(path, i.name());
+            patch_append_operation(patch, "remove", path, nullptr);
+            i.next();
+        }
+        else if (i.done() || j.name() < i.name())
+        {
+            patch_append_token(path, j.name());
+            patch_append_operation(patch, "add", path, &j.value());
+            j.next();
+        }
+        else
+        {
+            patch_append_token(path, i.name());
+            diff(i.value(), j.value(), path, patch);
+            i.next();
+            j.next();
+        }
+        path.resize(length);
+    }
+}
+
+void json_patch::diff_arrays(const json &source, const json &target, std::string &path, json &patch)
+{
+    size_t length = path.size();
+    size_t s_size = source.size();
+    size_t t_size = target.size();
+
+    // Skip what the two have in common at the start and the end, what's
+    // left in the middle is changed element by element with the elements
+    // left over in one or the other removed or added. Elements are read by
+    // index so that packed arrays aren't given a view of every element.
+    size_t start = 0;
+    while (start < s_size && start < t_size && patch_same_element(source, start, target, start))
+    {
+        start++;
+    }
+
+    size_t end = 0;
+    while (end < s_size - start && end < t_size - start &&
+           patch_same_element(source, s_size - 1 - end, target, t_size - 1 - end))
+    {
+        end++;
+    }
+
+    size_t s_middle = s_size - start - end;
+    size_t t_middle = t_size - start - end;
+    size_t common = s_middle < t_middle ? s_middle : t_middle;
+
+    for (size_t i = start; i < start + common; i++)
+    {
+        patch_append_token(path, i);
+        diff(source[i], target[i], path, patch);
+        path.resize(length);
+    }
+
+    for (size_t i = start + common; i < start + t_middle; i++)
+    {
+        if (end == 0)
+        {
+            path += "/-";
+        }
+        else
+        {
+            patch_append_token(path, i);
+        }
+        patch_append_operation(patch, "add", path, &target[i]);
+        path.resize(length);
+    }
+
+    // from the last so that the indices of the others don't change
+    for (size_t i = start + s_middle; i-- > start + common;)
+    {
+        patch_append_token(path, i);
+        patch_append_operation(patch, "remove", path, nullptr);
+        path.resize(length);
+    }
+}
+
+void json_patch::put(json &target, const location &l, json &&value, bool must_exist, std::vector<change> &log)
+{
+    // Everything is checked before value is moved from so that it's intact
+    // if this throws.
+    if (l.m_root)
+    {
+        log.push_back(change{&l, 0, true, true, false, json()});
+        log.back().m_value = std::move(target);
+        target = std::move(value);
+        return;
+    }
+
+    json *parent = target.find_for_update(l.m_parent);
+
+    if (parent != nullptr && parent->get_instance_type() == json::array_e)
+    {
+        json::json_array &a = parent->array_for_update();
+        size_t i = l.m_index == SIZE_MAX && l.m_name == "-" && !must_exist ? a.size() : l.m_index;
+
+        if (i < a.size() && must_exist)
+        {
+            log.push_back(change{&l, i, true, true, false, json()});
+            log.back().m_value = std::move(a[i]);
+            a[i] = std::move(value);
+            return;
+        }
+        else if (i <= a.size() && !must_exist)
+        {
+            a.insert(a.begin() + i, std::move(value));
+            log.push_back(change{&l, i, true, false, false, json()});
+            return;
+        }
+    }
+    else if (parent != nullptr && parent->get_instance_type() == json::object_e)
+    {
+        json::json_object &o = parent->object_for_update();
+        auto m = o.find(l.m_name);
+
+        if (m != o.end())
+        {
+            log.push_back(change{&l, 0, true, true, false, json()});
+            log.back().m_value = std::move(m->second);
+            m->second = std::move(value);
+            return;
+        }
+        else if (!must_exist)
+        {
+            o.emplace(l.m_name, std::move(value));
+            log.push_back(change{&l, 0, true, false, false, json()});
+            return;
+        }
+    }
+
+    throw json_exception(json_exception::pointer_not_matched_e);
+}
+
+void json_patch::take(json &target, const location &l, std::vector<change> &log)
+{
+    if (l.m_root)
+    {
+        log.push_back(change{&l, 0, false, false, false, json()});
+        log.back().m_value = std::move(target);
+        target = json();
+        return;
+    }
+
+    json *parent = target.find_for_update(l.m_parent);
+
+    if (parent != nullptr && parent->get_instance_type() == json::array_e)
+    {
+        json::json_array &a = parent->array_for_update();
+
+        if (l.m_index < a.size())
+        {
+            log.push_back(change{&l, l.m_index, false, false, false, json()});
+            log.back().m_value = std::move(a[l.m_index]);
+            a.erase(a.begin() + l.m_index);
+            return;
+        }
+    }
+    else if (parent != nullptr && parent->get_instance_type() == json::object_e)
+    {
+        json::json_object &o = parent->object_for_update();
+        auto m = o.find(l.m_name);
+
+        if (m != o.end())
+        {
+            log.push_back(change{&l, 0, false, false, false, json()});
+            log.back().m_value = std::move(m->second);
+            o.erase(m);
+            return;
+        }
+    }
+
+    throw json_exception(json_exception::pointer_not_matched_e);
+}
+
+void json_patch::undo(json &target, change &c, json &moved)
+{
+    const location &l = *c.m_location;
+    json &value = c.m_moved ? moved : c.m_value;
+
+    if (l.m_root)
+    {
+        if (c.m_put)
+        {
+            moved = std::move(target);
+        }
+        target = std::move(value);
+        return;
+    }
+
+    // The later changes have been undone so the container is where it was.
+    json &parent = *target.find_for_update(l.m_parent);
+
+    if (parent.get_instance_type() == json::array_e)
+    {
+        json::json_array &a = parent.array_for_update();
+
+        if (!c.m_put)
+        {
+            a.insert(a.begin() + c.m_index, std::move(value));
+        }
+        else if (c.m_replaced)
+        {
+            moved = std::move(a[c.m_index]);
+            a[c.m_index] = std::move(c.m_value);
+        }
+        else
+        {
+            moved = std::move(a[c.m_index]);
+            a.erase(a.begin() + c.m_index);
+        }
+    }
+    else
+    {
+        json::json_object &o = parent.object_for_update();
+
+        if (!c.m_put)
+        {
+            o.emplace(l.m_name, std::move(value));
+        }
+        else
+        {
+            auto m = o.find(l.m_name);
+            moved = std::move(m->second);
+            if (c.m_replaced)
+            {
+                m->second = std::move(c.m_value);
+            }
+            else
+            {
+                o.erase(m);
+            }
+        }
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef _json_patch_hpp_
+#define _json_patch_hpp_
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file json_patch.hpp The json_patch class.
+
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "json.hpp"
+#include "pointer.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * \brief A compiled RFC 6902 JSON Patch.
+     *
+     * The constructor checks the patch document and decodes every path once
+     * so a patch can be applied to any number of documents. Applying it
+     * changes the target in place: add, remove and replace touch only the
+     * container that holds the location, move takes the value out of one
+     * container and puts it in another without copying it, and copy shares
+     * the storage of the value copied in the same way as the copy
+     * constructor.
+     *
+     * A patch is all or nothing. What each operation removes or replaces is
+     * kept until the patch is complete and if an operation fails the ones
+     * before it are undone in reverse order, so the target is as it was
+     * without having been copied first.
+     *
+     * As in the RFC, a final token of - in an add, move or copy appends to an
+     * array. The containers along each path are changed as by
+     * json::find_mutable().
+     */
+    class json_patch
+    {
+    public:
+
+        /**
+         * Compile a patch.
+         * \param patch   An array of operation objects as per RFC 6902.
+         * \throw json_exception if the patch isn't valid, json_pointer_exception
+         *        if a path isn't.
+         */
+        explicit json_patch(const json &patch);
+
+        /**
+         * Apply the patch to target. If this throws, target is unchanged.
+         * \throw json_exception of type pointer_not_matched_e if a location
+         *        doesn't exist or patch_test_failed_e if a test fails.
+         */
+        void apply(json &target) const;
+
+        /// The number of operations.
+        size_t size() const noexcept;
+
+        /**
+         * A patch document that turns source into target. Members of objects
+         * are compared in a single merge of the two sorted lists of names and
+         * only objects and arrays that differ are looked into, the hash of
+         * each one being worked out once so that a difference is seen without
+         * comparing the contents. For arrays the elements the two have in
+         * common at the start and end are skipped, so appending to an array
+         * gives one add per new element. Numbers that compare equal, e.g. 1
+         * and 1.0, are not a difference.
+         */
+        static json diff(const json &source, const json &target);
+
+    private:
+
+        /// The operations of RFC 6902.
+        typedef enum { add_e, remove_e, replace_e, move_e, copy_e, test_e } operation_type;
+
+        /// A path split into the pointer to its container and the last token.
+        struct location
+        {
+            location(const json &op, const char *member);
+
+            /// The path is the whole document.
+            bool                m_root;
+
+            /// The path without its last token.
+            pointer             m_parent;
+
+            /// The last token as a member name.
+            std::string         m_name;
+
+            /// The last token as an array index, SIZE_MAX for - or one that isn't an index.
+            size_t              m_index;
+
+            /// The complete path, for finding and checking prefixes.
+            pointer             m_path;
+        };
+
+        struct operation
+        {
+            operation(const json &op);
+
+            static operation_type get_type(const json &op);
+
+            operation_type      m_type;
+            location            m_path;
+
+            /// from for move and copy, otherwise the same as m_path.
+            location            m_from;
+
+            /// value for add, replace and test.
+            json                m_value;
+        };
+
+        /// What undoes one change to the target.
+        struct change
+        {
+            /// The location changed and its array index if in an array.
+            const location      *m_location;
+            size_t              m_index;
+
+            /// The value was put there rather than taken.
+            bool                m_put;
+
+            /// A put replaced a value rather than adding one.
+            bool                m_replaced;
+
+            /// A take whose value a move has since put somewhere else.
+            bool                m_moved;
+
+            /// What was replaced or taken.
+            json                m_value;
+        };
+
+        /// Put value at l, replacing what's there or, if must_exist is false, adding it.
+        static void put(json &target, const location &l, json &&value, bool must_exist, std::vector<change> &log);
+
+        /// Take the value at l out of its container and keep it in the log.
+        static void take(json &target, const location &l, std::vector<change> &log);
+
+        /**
+         * Undo a change. The value a put is undone for is left in moved so
+         * that undoing the take of a move can put it back.
+         */
+        static void undo(json &target, change &c, json &moved);
+
+        /// diff() for the values at path.
+        static void diff(const json &source, const json &target, std::string &path, json &patch);
+
+        /// diff() for two objects.
+        static void diff_objects(const json &source, const json &target, std::string &path, json &patch);
+
+        /// diff() for two arrays.
+        static void diff_arrays(const json &source, const json &target, std::string &path, json &patch);
+
+        std::vector<operation> m_operations;
+    };
+}
+
+#endif
@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file json_path.cpp The json_path class implementation.
+
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include "common.hpp"
+#include "json_path.hpp"
+#include "json_pointer_exception.hpp"
+
+using namespace NAMESPACE;
+
+namespace
+{
+    // Calls f with each element of an array or each member value of an
+    // object, in order, and does nothing for anything else.
+    template <typename F>
+    void for_each_child(const json &j, F f)
+    {
+        if (j.get_instance_type() == json::array_e)
+        {
+            for (size_t i = 0; i < j.size(); i++)
+            {
+                f(j[i]);
+            }
+        }
+        else if (j.get_instance_type() == json::object_e && j.is_shaped())
+        {
+            for (const auto &v : j.get_shape_values())
+            {
+                f(v);
+            }
+        }
+        else if (j.get_instance_type() == json::object_e)
+        {
+            for (const auto &m : j.get_object())
+            {
+                f(m.second);
+            }
+        }
+    }
+
+    bool is_name_char(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               c == '_' || c == '-' || (c & 0x80) != 0;
+    }
+}
+
+json_path::json_path(const std::string &expression) : m_expression(expression), m_position(0)
+{
+    expect("$");
+    parse_steps();
+    merge_plain_steps();
+}
+
+void json_path::find_all(const json &root, const std::function<void(const json &)> &visit) const
+{
+    apply(0, root, visit);
+}
+
+std::vector<const json *> json_path::find_all(const json &root) const
+{
+    std::vector<const json *> res;
+    apply(0, root, [&res](const json &j) { res.push_back(&j); });
+    return res;
+}
+
+const std::string &json_path::get_expression() const noexcept
+{
+    return m_expression;
+}
+
+// compiling
+
+void json_path::parse_steps()
+{
+    while (m_position < m_expression.size())
+    {
+        step s;
+        s.m_descendants = accept("..");
+
+        if (!s.m_descendants && !accept("."))
+        {
+            parse_bracket(s);
+        }
+        else if (m_expression[m_position] == '[' && s.m_descendants)
+        {
+            parse_bracket(s);
+        }
+        else if (accept("*"))
+        {
+            s.m_selectors.push_back(selector(selector::wildcard_e));
+        }
+        else
+        {
+            selector n(selector::path_e);
+            n.m_path = pointer(std::vector<pointer::token>(1, pointer::token(parse_name())));
+            s.m_selectors.push_back(std::move(n));
+        }
+
+        m_steps.push_back(std::move(s));
+    }
+}
+
+void json_path::parse_bracket(step &s)
+{
+    expect("[");
+    skip_space();
+
+    if (accept("?"))
+    {
+        selector f(selector::filter_e);
+        f.m_filter = parse_or();
+        s.m_selectors.push_back(std::move(f));
+    }
+    else
+    {
+        do
+        {
+            s.m_selectors.push_back(parse_selector());
+            skip_space();
+        }
+        while (accept(","));
+    }
+
+    skip_space();
+    expect("]");
+}
+
+json_path::selector json_path::parse_selector()
+{
+    skip_space();
+
+    if (m_position < m_expression.size() && (m_expression[m_position] == '\'' || m_expression[m_position] == '"'))
+    {
+        selector n(selector::path_e);
+        n.m_path = pointer(std::vector<pointer::token>(1, pointer::token(parse_quoted())));
+        return n;
+    }
+    else if (accept("*"))
+    {
+        return selector(selector::wildcard_e);
+    }
+
+    selector s(selector::index_e);
+    s.m_has_start = parse_int(s.m_start);
+    skip_space();
+
+    if (accept(":"))
+    {
+        s.m_kind = selector::slice_e;
+        skip_space();
+        s.m_has_end = parse_int(s.m_end);
+        skip_space();
+        if (accept(":"))
+        {
+            skip_space();
+            if (parse_int(s.m_step) && s.m_step == 0)
+            {
+                syntax_error();
+            }
+        }
+    }
+    else if (!s.m_has_start)
+    {
+        syntax_error();
+    }
+    else if (s.m_start >= 0)
+    {
+        s.m_kind = selector::path_e;
+        s.m_path = pointer(std::vector<pointer::token>(1, pointer::token(static_cast<size_t>(s.m_start))));
+    }
+
+    return s;
+}
+
+size_t json_path::parse_or()
+{
+    size_t left = parse_and();
+    skip_space();
+
+    while (accept("||"))
+    {
+        filter_node n(filter_node::or_e);
+        n.m_left = left;
+        n.m_right = parse_and();
+        left = m_filter.size();
+        m_filter.push_back(std::move(n));
+        skip_space();
+    }
+
+    return left;
+}
+
+size_t json_path::parse_and()
+{
+    size_t left = parse_unary();
+    skip_space();
+
+    while (accept("&&"))
+    {
+        filter_node n(filter_node::and_e);
+        n.m_left = left;
+        n.m_right = parse_unary();
+        left = m_filter.size();
+        m_filter.push_back(std::move(n));
+        skip_space();
+    }
+
+    return left;
+}
+
+size_t json_path::parse_unary()
+{
+    skip_space();
+
+    if (accept("!"))
+    {
+        filter_node n(filter_node::not_e);
+        n.m_left = parse_unary();
+        m_filter.push_back(std::move(n));
+        return m_filter.size() - 1;
+    }
+    else if (accept("("))
+    {
+        size_t res = parse_or();
+        skip_space();
+        expect(")");
+        return res;
+    }
+
+    // a path, on its own or compared with a literal on either side
+    bool path_first = m_position < m_expression.size() && m_expression[m_position] == '@';
+    filter_node n(filter_node::exists_e);
+    if (path_first)
+    {
+        n.m_path = parse_relative_path();
+    }
+    else
+    {
+        n.m_literal = parse_literal();
+    }
+
+    skip_space();
+    static const struct { const char *m_text; compare_t m_compare; compare_t m_flipped; } operators[] = {
+        {"==", eq_e, eq_e}, {"!=", ne_e, ne_e}, {"<=", le_e, ge_e}, {">=", ge_e, le_e}, {"<", lt_e, gt_e}, {">", gt_e, lt_e}
+    };
+
+    for (const auto &o : operators)
+    {
+        if (accept(o.m_text))
+        {
+            n.m_kind = filter_node::compare_e;
+            skip_space();
+            if (path_first)
+            {
+                n.m_compare = o.m_compare;
+                n.m_literal = parse_literal();
+            }
+            else
+            {
+                n.m_compare = o.m_flipped;
+                n.m_path = parse_relative_path();
+            }
+            break;
+        }
+    }
+
+    if (n.m_kind == filter_node::exists_e && !path_first)
+    {
+        syntax_error();
+    }
+
+    m_filter.push_back(std::move(n));
+    return m_filter.size() - 1;
+}
+
+pointer json_path::parse_relative_path()
+{
+    std::vector<pointer::token> path;
+    expect("@");
+
+    while (m_position < m_expression.size())
+    {
+        if (accept("."))
+        {
+            path.push_back(pointer::token(parse_name()));
+        }
+        else if (accept("["))
+        {
+            skip_space();
+            char c = m_position < m_expression.size() ? m_expression[m_position] : '\0';
+            int64_t i;
+
+            if (c == '\'' || c == '"')
+            {
+                path.push_back(pointer::token(parse_quoted()));
+            }
+            else if (parse_int(i) && i >= 0)
+            {
+                path.push_back(pointer::token(static_cast<size_t>(i)));
+            }
+            else
+            {
+                syntax_error();
+            }
+
+            skip_space();
+            expect("]");
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return pointer(std::move(path));
+}
+
+json_path::literal json_path::parse_literal()
+{
+    skip_space();
+
+    literal l;
+    l.m_type = json::null_e;
+    l.m_bool = false;
+    l.m_int = 0;
+    l.m_double = 0;
+
+    char c = m_position < m_expression.size() ? m_expression[m_position] : '\0';
+
+    if (c == '\'' || c == '"')
+    {
+        l.m_type = json::string_e;
+        l.m_string = parse_quoted();
+    }
+    else if (accept("true"))
+    {
+        l.m_type = json::boolean_e;
+        l.m_bool = true;
+    }
+    else if (accept("false"))
+    {
+        l.m_type = json::boolean_e;
+    }
+    else if (accept("null"))
+    {
+        l.m_type = json::null_e;
+    }
+    else
+    {
+        size_t start = m_position;
+
+        if (!parse_int(l.m_int))
+        {
+            syntax_error();
+        }
+
+        l.m_type = json::number_int_e;
+
+        if (m_position < m_expression.size() && strchr(".eE", m_expression[m_position]) != nullptr)
+        {
+            while (m_position < m_expression.size() && strchr("0123456789.eE+-", m_expression[m_position]) != nullptr)
+            {
+                m_position++;
+            }
+
+            std::istringstream is(m_expression.substr(start, m_position - start));
+            if (!(is >> l.m_double) || !is.eof())
+            {
+                syntax_error();
+            }
+            l.m_type = json::number_double_e;
+        }
+    }
+
+    return l;
+}
+
+std::string json_path::parse_name()
+{
+    size_t start = m_position;
+
+    while (m_position < m_expression.size() && is_name_char(m_expression[m_position]))
+    {
+        m_position++;
+    }
+
+    if (m_position == start)
+    {
+        syntax_error();
+    }
+
+    return m_expression.substr(start, m_position - start);
+}
+
+std::string json_path::parse_quoted()
+{
+    char quote = m_expression[m_position++];
+    std::string res;
+
+    while (m_position < m_expression.size() && m_expression[m_position] != quote)
+    {
+        // a backslash quotes the next character, whatever it is
+        if (m_expression[m_position] == '\\')
+        {
+            m_position++;
+            if (m_position == m_expression.size())
+            {
+                break;
+            }
+        }
+        res += m_expression[m_position++];
+    }
+
+    expect(quote == '"' ? "\"" : "'");
+    return res;
+}
+
+bool json_path::parse_int(int64_t &i)
+{
+    size_t start = m_position;
+    bool negative = accept("-");
+    uint64_t u = 0;
+
+    while (m_position < m_expression.size() && m_expression[m_position] >= '0' && m_expression[m_position] <= '9')
+    {
+        u = u * 10 + (m_expression[m_position++] - '0');
+        if (u > static_cast<uint64_t>(INT64_MAX))
+        {
+            syntax_error();
+        }
+    }
+
+    if (m_position == start + (negative ? 1 : 0))
+    {
+        m_position = start;
+        return false;
+    }
+
+    i = negative ? -static_cast<int64_t>(u) : static_cast<int64_t>(u);
+    return true;
+}
+
+void json_path::skip_space()
+{
+    while (m_position < m_expression.size() && (m_expression[m_position] == ' ' || m_expression[m_position] == '\t'))
+    {
+        m_position++;
+    }
+}
+
+bool json_path::accept(const char *s)
+{
+    size_t l = strlen(s);
+
+    if (m_expression.compare(m_position, l, s) == 0)
+    {
+        m_position += l;
+        return true;
+    }
+
+    return false;
+}
+
+void json_path::expect(const char *s)
+{
+    if (!accept(s))
+    {
+        syntax_error();
+    }
+}
+
+void json_path::syntax_error() const
+{
+    throw json_pointer_exception(json_exception::syntax_error_in_json_path_e, static_cast<int>(m_position));
+}
+
+void json_path::merge_plain_steps()
+{
+    // Neighbouring steps that are each a single name or index become one
+    // pointer so that a query like $.store.book[0] is a single find.
+    std::vector<step> merged;
+
+    for (auto &s : m_steps)
+    {
+        bool plain = !s.m_descendants && s.m_selectors.size() == 1 && s.m_selectors[0].m_kind == selector::path_e;
+
+        if (plain && !merged.empty())
+        {
+            step &last = merged.back();
+
+            if (!last.m_descendants && last.m_selectors.size() == 1 && last.m_selectors[0].m_kind == selector::path_e)
+            {
+                std::vector<pointer::token> path(last.m_selectors[0].m_path.get_tokens());
+                path.push_back(s.m_selectors[0].m_path.get_tokens()[0]);
+                last.m_selectors[0].m_path = pointer(std::move(path));
+                continue;
+            }
+        }
+
+        merged.push_back(std::move(s));
+    }
+
+    m_steps.swap(merged);
+}
+
+json_path::selector::selector(kind_t k) :
+                            m_kind(k),
+                            m_path(std::vector<pointer::token>()),
+                            m_start(0),
+                            m_end(0),
+                            m_step(1),
+                            m_has_start(false),
+                            m_has_end(false),
+                            m_filter(0)
+{
+}
+
+json_path::filter_node::filter_node(kind_t k) :
+                            m_kind(k),
+                            m_left(0),
+                            m_right(0),
+                            m_path(std::vector<pointer::token>()),
+                            m_compare(eq_e)
+{
+    m_literal.m_type = json::null_e;
+    m_literal.m_bool = false;
+    m_literal.m_int = 0;
+    m_literal.m_double = 0;
+}
+
+// running
+
+void json_path::apply(size_t i, const json &j, const std::function<void(const json &)> &visit) const
+{
+    if (i == m_steps.size())
+    {
+        visit(j);
+        return;
+    }
+
+    const step &s = m_steps[i];
+
+    for (const auto &sel : s.m_selectors)
+    {
+        select(sel, i, j, visit);
+    }
+
+    // .. applies the same step to every descendant, in document order
+    if (s.m_descendants)
+    {
+        for_each_child(j, [this, i, &visit](const json &c) { apply(i, c, visit); });
+    }
+}
+
+void json_path::select(const selector &s, size_t i, const json &j, const std::function<void(const json &)> &visit) const
+{
+    switch (s.m_kind)
+    {
+    case selector::path_e:
+        {
+            const json *r = j.try_find(s.m_path);
+            if (r != nullptr)
+            {
+                apply(i + 1, *r, visit);
+            }
+        }
+        break;
+
+    case selector::index_e:
+        if (j.get_instance_type() == json::array_e)
+        {
+            int64_t index = static_cast<int64_t>(j.size()) + s.m_start;
+            if (index >= 0)
+            {
+                apply(i + 1, j[static_cast<size_t>(index)], visit);
+            }
+        }
+        break;
+
+    case selector::slice_e:
+        if (j.get_instance_type() == json::array_e)
+        {
+            int64_t n = static_cast<int64_t>(j.size());
+
+            // as Python: negative bounds count from the end and are then
+            // clamped to the array
+            auto bound = [n](int64_t b, int64_t low, int64_t high) {
+                b = b < 0 ? b + n : b;
+                return b < low ? low : (b > high ? high : b);
+            };
+
+            if (s.m_step > 0)
+            {
+                int64_t start = s.m_has_start ? bound(s.m_start, 0, n) : 0;
+                int64_t end = s.m_has_end ? bound(s.m_end, 0, n) : n;
+                for (int64_t k = start; k < end; k += s.m_step)
+                {
+                    apply(i + 1, j[static_cast<size_t>(k)], visit);
+                }
+            }
+            else
+            {
+                int64_t start = s.m_has_start ? bound(s.m_start, -1, n - 1) : n - 1;
+                int64_t end = s.m_has_end ? bound(s.m_end, -1, n - 1) : -1;
+                for (int64_t k = start; k > end; k += s.m_step)
+                {
+                    apply(i + 1, j[static_cast<size_t>(k)], visit);
+                }
+            }
+        }
+        break;
+
+    case selector::wildcard_e:
+        for_each_child(j, [this, i, &visit](const json &c) { apply(i + 1, c, visit); });
+        break;
+
+    case selector::filter_e:
+        for_each_child(j, [this, &s, i, &visit](const json &c) {
+            if (matches(s.m_filter, c))
+            {
+                apply(i + 1, c, visit);
+            }
+        });
+        break;
+    }
+}
+
+bool json_path::matches(size_t f, const json &j) const
+{
+    const filter_node &n = m_filter[f];
+
+    switch (n.m_kind)
+    {
+    case filter_node::or_e:
+        return matches(n.m_left, j) || matches(n.m_right, j);
+
+    case filter_node::and_e:
+        return matches(n.m_left, j) && matches(n.m_right, j);
+
+    case filter_node::not_e:
+        return !matches(n.m_left, j);
+
+    case filter_node::exists_e:
+        return j.try_find(n.m_path) != nullptr;
+
+    case filter_node::compare_e:
+        {
+            // a missing value is only ever not equal
+            const json *v = j.try_find(n.m_path);
+            return v == nullptr ? n.m_compare == ne_e : compare(*v, n.m_compare, n.m_literal);
+        }
+    }
+
+    return false;
+}
+
+bool json_path::compare(const json &j, compare_t c, const literal &l) const
+{
+    auto result = [c](bool less, bool equal) {
+        switch (c)
+        {
+        case eq_e:
+            return equal;
+        case ne_e:
+            return !equal;
+        case lt_e:
+            return less;
+        case le_e:
+            return less || equal;
+        case gt_e:
+            return !less && !equal;
+        case ge_e:
+            return !less;
+        }
+        return false;
+    };
+
+    json::type t = j.get_instance_type();
+    bool number = t == json::number_int_e || t == json::number_double_e;
+
+    // Raw values can't be compared, treat them as a different type.
+    if (!j.get_raw_value().empty())
+    {
+        return c == ne_e;
+    }
+    else if (number && l.m_type == json::number_int_e && t == json::number_int_e)
+    {
+        return result(j < l.m_int, j == l.m_int);
+    }
+    else if (number && (l.m_type == json::number_int_e || l.m_type == json::number_double_e))
+    {
+        double d = l.m_type == json::number_int_e ? static_cast<double>(l.m_int) : l.m_double;
+        return result(j < d, j == d);
+    }
+    else if (t == json::string_e && l.m_type == json::string_e)
+    {
+        return result(j < l.m_string, j == l.m_string);
+    }
+    else if (t == json::boolean_e && l.m_type == json::boolean_e)
+    {
+        return c == eq_e ? static_cast<bool>(j) == l.m_bool : (c == ne_e ? static_cast<bool>(j) != l.m_bool : false);
+    }
+    else if (t == json::null_e && l.m_type == json::null_e)
+    {
+        return c == eq_e || c == le_e || c == ge_e;
+    }
+
+    return c == ne_e;
+}
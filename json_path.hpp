@@ -0,0 +1,179 @@
+#ifndef _json_path_hpp_
+#define _json_path_hpp_
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file json_path.hpp The json_path class.
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "json.hpp"
+#include "pointer.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * \brief A compiled JSONPath query.
+     *
+     * The expression is parsed once by the constructor into a plan that can
+     * then be run against any number of documents, by any number of threads
+     * at once. The supported syntax is:
+     *
+     *     $                       the document
+     *     .name  ['name']  ["name"]   a member
+     *     [2]  [-1]               an element, negative from the end
+     *     [1:5]  [::2]  [-3:]     a slice, as in Python
+     *     [0,2]  ['a','b']        a union
+     *     .*  [*]                 every member or element
+     *     ..name  ..*  ..[0]      the same at any depth
+     *     [?(@.price > 10)]       members or elements matching a filter
+     *
+     * A filter compares a path relative to the candidate, \@ followed by
+     * names and indices, with a number, a string, true, false or null using
+     * ==, !=, <, <=, > or >=, tests that such a path exists, and combines
+     * these with &&, || and ! and parentheses. Values of different types are
+     * never equal and never ordered. A run of plain names and indices is
+     * compiled into a pointer so it is followed in the same way as with
+     * json::find().
+     */
+    class json_path
+    {
+    public:
+
+        /**
+         * Compile a JSONPath expression.
+         * \throw   json_pointer_exception with syntax_error_in_json_path_e if the
+         *          expression isn't valid.
+         */
+        explicit json_path(const std::string &expression);
+
+        /**
+         * Run the query against a document.
+         * \param root    The document, $ in the expression.
+         * \param visit   Called with each match in document order.
+         */
+        void find_all(const json &root, const std::function<void(const json &)> &visit) const;
+
+        /// As find_all(const json &, visit) returning the matches.
+        std::vector<const json *> find_all(const json &root) const;
+
+        /// The expression the query was compiled from.
+        const std::string &get_expression() const noexcept;
+
+    private:
+
+        /// A literal in a filter.
+        struct literal
+        {
+            json::type m_type;
+            bool m_bool;
+            int64_t m_int;
+            double m_double;
+            std::string m_string;
+        };
+
+        /// Comparison operators in filters.
+        typedef enum { eq_e, ne_e, lt_e, le_e, gt_e, ge_e } compare_t;
+
+        /// A node of a filter expression, children are indexes into m_filter.
+        struct filter_node
+        {
+            typedef enum { or_e, and_e, not_e, exists_e, compare_e } kind_t;
+
+            explicit filter_node(kind_t k);
+
+            kind_t m_kind;
+            size_t m_left;
+            size_t m_right;
+            pointer m_path;
+            compare_t m_compare;
+            literal m_literal;
+        };
+
+        /// One way of choosing from the children of a node.
+        struct selector
+        {
+            typedef enum { path_e, index_e, slice_e, wildcard_e, filter_e } kind_t;
+
+            explicit selector(kind_t k);
+
+            kind_t m_kind;
+
+            /// For path_e, names and non-negative indexes.
+            pointer m_path;
+
+            /// For index_e (negative) and slice_e.
+            int64_t m_start;
+            int64_t m_end;
+            int64_t m_step;
+            bool m_has_start;
+            bool m_has_end;
+
+            /// For filter_e, the root of the expression in m_filter.
+            size_t m_filter;
+        };
+
+        /// A step of the query, the union of its selectors.
+        struct step
+        {
+            /// True after .., the selectors apply at every depth.
+            bool m_descendants;
+            std::vector<selector> m_selectors;
+        };
+
+        // compiling
+        void parse_steps();
+        void parse_bracket(step &s);
+        selector parse_selector();
+        size_t parse_or();
+        size_t parse_and();
+        size_t parse_unary();
+        pointer parse_relative_path();
+        literal parse_literal();
+        std::string parse_name();
+        std::string parse_quoted();
+        bool parse_int(int64_t &i);
+        void skip_space();
+        bool accept(const char *s);
+        void expect(const char *s);
+        [[noreturn]] void syntax_error() const;
+        void merge_plain_steps();
+
+        // running
+        void apply(size_t i, const json &j, const std::function<void(const json &)> &visit) const;
+        void select(const selector &s, size_t i, const json &j, const std::function<void(const json &)> &visit) const;
+        bool matches(size_t f, const json &j) const;
+        bool compare(const json &j, compare_t c, const literal &l) const;
+
+        std::string m_expression;
+        size_t m_position;
+        std::vector<step> m_steps;
+        std::vector<filter_node> m_filter;
+    };
+}
+
+#endif
@@ -36,6 +36,10 @@ json_pointer_exception::json_pointer_exception(exception_type et, int byte_index
     {
         snprintf(m_message, max_message_length, "syntax error in pointer string at byte %d", byte_index);
     }
+    else if (et == syntax_error_in_json_path_e)
+    {
+        snprintf(m_message, max_message_length, "syntax error in JSONPath expression at byte %d", byte_index);
+    }
     else
     {
         strncpy(m_message, "generic", max_message_length);
@@ -23,8 +23,12 @@
 /// \file json_test.cpp Argo test code.
 
 #include <iostream>
+#include <cstring>
 #include <fstream>
 #include <sstream>
+#include <iterator>
+#include <list>
+#include <unordered_map>
 #include "argo.hpp"
 
 #ifndef _ARGO_WINDOWS_
@@ -1707,6 +1711,33 @@ void test_pointer()
             }
         }
     }
+
+    // only 0 and digits without a leading zero are array indices
+    for (auto s : {"/0", "/10", "/01", "/1a", "/-1", "/99999999999999999999999"})
+    {
+        pointer p(s);
+        jlog << s << " " << (p.get_tokens()[0].get_type() == pointer::token::array_e) << " ";
+    }
+    jlog << endl;
+
+    // the list of tokens is still there for existing callers, copies build their own
+    pointer listed("/a/1/b");
+    pointer listed_copy(listed);
+    const std::list<pointer::token> &tokens = listed.get_path();
+    jlog << tokens.size() << " " << tokens.front().get_name() << " " << std::next(tokens.begin())->get_index() << " "
+         << (&listed.get_path() == &tokens) << " " << (&listed_copy.get_path() != &tokens) << " "
+         << listed_copy.get_path().back().get_name() << endl;
+
+    // one pointer applied to objects of different shapes, and a copy of it
+    auto records = parser::parse("[{\"a\": 1, \"id\": 2}, {\"id\": 3, \"z\": 4}, {\"b\": 5, \"c\": 6, \"id\": 7}]");
+    const json &cr = *records;
+    pointer id("/id");
+    pointer id_copy(id);
+    for (size_t i = 0; i < 3; i++)
+    {
+        jlog << cr[i].find(id) << " " << cr[i].find(id_copy) << " ";
+    }
+    jlog << endl;
 }
 
 void test_invalid_data_access()
@@ -1770,6 +1801,1319 @@ void test_factory_methods()
     }
 }
 
+class counting_resource : public memory_resource
+{
+public:
+
+    counting_resource() : m_allocations(0), m_outstanding(0) { }
+
+    size_t m_allocations;
+    size_t m_outstanding;
+
+protected:
+
+    virtual void *do_allocate(size_t bytes, size_t alignment)
+    {
+        m_allocations++;
+        m_outstanding += bytes;
+        return new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    virtual void do_deallocate(void *p, size_t bytes, size_t alignment)
+    {
+        m_outstanding -= bytes;
+        new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    virtual bool do_is_equal(const memory_resource &other) const noexcept
+    {
+        return this == &other;
+    }
+};
+
+void test_memory_resource()
+{
+    counting_resource r;
+
+    {
+        ifstream is("test_files/test2.json");
+        stream_reader sr(&is, parser::max_message_length, true);
+        parser p(sr, true, parser::max_token_length, parser::max_nesting_depth, true, true, true, &r);
+        auto j = p.parse();
+
+        if (r.m_allocations > 0 && *j == *parser::load("test_files/test2.json"))
+        {
+            jlog << "PASS: parse into memory resource\n";
+        }
+        else
+        {
+            jlog << "FAIL: parse into memory resource\n";
+        }
+
+        json copy(*j);
+        if (copy.get_memory_resource() == new_delete_resource() && copy[0].get_memory_resource() == new_delete_resource())
+        {
+            jlog << "PASS: copy uses default resource\n";
+        }
+        else
+        {
+            jlog << "FAIL: copy uses default resource\n";
+        }
+
+        json moved(std::move(*j));
+        if (moved.get_memory_resource() == &r && moved[0].get_memory_resource() == &r)
+        {
+            jlog << "PASS: move keeps resource\n";
+        }
+        else
+        {
+            jlog << "FAIL: move keeps resource\n";
+        }
+
+        size_t before = r.m_allocations;
+        json into(copy, &r);
+        if (r.m_allocations > before && into == copy && into[0].get_memory_resource() == &r)
+        {
+            jlog << "PASS: copy into resource\n";
+        }
+        else
+        {
+            jlog << "FAIL: copy into resource\n";
+        }
+
+        // the vector and map built for the const accessors come from the resource too
+        istringstream is2("{\"a\": [1, 2, 3], \"b\": true}");
+        stream_reader sr2(&is2, parser::max_message_length, true);
+        parser p2(sr2, true, parser::max_token_length, parser::max_nesting_depth, true, true, true, &r, true, true);
+        auto j2 = p2.parse();
+        const json &shaped = *j2;
+        before = r.m_allocations;
+        shaped["a"].get_array();
+        size_t array_view = r.m_allocations - before;
+        before = r.m_allocations;
+        shaped.get_object();
+        jlog << "view allocations from resource " << array_view << " " << r.m_allocations - before << endl;
+    }
+
+    if (r.m_outstanding == 0)
+    {
+        jlog << "PASS: all memory returned to resource\n";
+    }
+    else
+    {
+        jlog << "FAIL: memory leaked from resource\n";
+    }
+
+    monotonic_buffer_resource m(64);
+    {
+        json a(json::array_e, &m);
+        for (int i = 0; i < 100; i++)
+        {
+            a.append(i);
+        }
+        jlog << "monotonic resource array length " << a.get_array().size() << " last " << a[99] << endl;
+    }
+
+    bool aligned = true;
+    for (size_t alignment = 1; alignment <= 4096; alignment *= 2)
+    {
+        void *p = new_delete_resource()->allocate(24, alignment);
+        aligned = aligned && reinterpret_cast<size_t>(p) % alignment == 0;
+        memset(p, 0, 24);
+        new_delete_resource()->deallocate(p, 24, alignment);
+    }
+    jlog << (aligned ? "PASS" : "FAIL") << ": default resource alignment\n";
+}
+
+void test_tape()
+{
+    auto j = parser::load("test_files/test2.json");
+    tape t(*j);
+
+    ostringstream s1;
+    ostringstream s2;
+    unparser::unparse(s1, *j, " ", "\n", " ", 1);
+    unparser::unparse(s2, t, " ", "\n", " ", 1);
+
+    if (s1.str() == s2.str())
+    {
+        jlog << "PASS: tape unparses the same as json\n";
+    }
+    else
+    {
+        jlog << "FAIL: tape unparses differently to json\n";
+    }
+
+    if (*t.to_json() == *j)
+    {
+        jlog << "PASS: tape converts back to equal json\n";
+    }
+    else
+    {
+        jlog << "FAIL: tape converts back to different json\n";
+    }
+
+    jlog << t[0]["name"] << " " << t[0]["age"] << " " << static_cast<double>(t[1]["latitude"]) << endl;
+    jlog << t.find(pointer("/0/address")) << endl;
+    jlog << t[0].get_instance_type_name() << " " << t.root().size() << " " << t[0].has("tags") << endl;
+
+    size_t n = 0;
+    for (auto i = t[0].begin(); i != t[0].end(); ++i)
+    {
+        if ((*i).get_index() == t[0][i.key()].get_index())
+        {
+            n++;
+        }
+    }
+    jlog << "tape object members " << n << " " << t[0].size() << endl;
+
+    try
+    {
+        (void)t[0]["not there"];
+        jlog << "FAIL: tape missing key didn't throw\n";
+    }
+    catch (json_invalid_key_exception &e)
+    {
+        jlog << "PASS: tape missing key threw correct exception type\n";
+    }
+
+    try
+    {
+        (void)t.find(pointer("/0/not there"));
+        jlog << "FAIL: tape pointer didn't throw\n";
+    }
+    catch (json_exception &e)
+    {
+        jlog << "PASS: tape pointer threw " << e.what() << endl;
+    }
+
+    json raw(json::array_e);
+    raw.append(json(json::number_int_e, "99999999999999999999999"));
+    raw.append(json(json::string_e, "\\uZZZZ"));
+    tape rt(raw);
+    jlog << rt << endl;
+}
+
+void test_packed_arrays()
+{
+    auto j = parser::parse("[1, 2, 3, -4, 5] ");
+    auto d = parser::parse("[1.5, 2.5, -3.5] ");
+    auto m = parser::parse("[1, 2.5, 3] ");
+
+    jlog << "packed " << j->is_packed() << " " << d->is_packed() << " " << m->is_packed() << endl;
+    jlog << j->sum() << " " << j->minimum() << " " << j->maximum() << endl;
+    jlog << d->sum() << " " << d->minimum() << " " << d->maximum() << endl;
+    jlog << m->sum() << " " << m->minimum() << " " << m->maximum() << endl;
+
+    // a total too big for an int64_t is the same packed or not
+    auto big = parser::parse("[9223372036854775807, 9223372036854775807, 9223372036854775807, 9223372036854775807, 9223372036854775807]");
+    json unpacked(json::array_e);
+    for (int i = 0; i < 5; i++)
+    {
+        unpacked.append(INT64_MAX);
+    }
+    jlog << big->is_packed() << " " << unpacked.is_packed() << " " << big->sum() << " " << unpacked.sum() << " "
+         << (big->sum() == unpacked.sum()) << endl;
+
+    // const access to one element makes json instances for its block only
+    counting_resource cr;
+    {
+        ostringstream series;
+        series << "[";
+        for (int i = 0; i < 1000; i++)
+        {
+            series << (i ? ", " : "") << i * 3;
+        }
+        series << "]";
+        istringstream is(series.str());
+        stream_reader sr(&is, parser::max_message_length, true);
+        parser p(sr, true, parser::max_token_length, parser::max_nesting_depth, true, true, true, &cr);
+        auto s = p.parse();
+        const json &cs = *s;
+
+        size_t before = cr.m_allocations;
+        jlog << cs.is_packed() << " " << cs.size() << " " << cs[500] << " " << cs[501] << " " << cr.m_allocations - before;
+        jlog << " " << *cs.try_get(999) << " " << (cs.try_get(1000) == nullptr) << " " << cr.m_allocations - before;
+        jlog << " " << (cs == *parser::parse(series.str())) << " " << cr.m_allocations - before;
+
+        json copy(json::array_e);
+        for (int i = 0; i < 1000; i++)
+        {
+            copy.append(i * 3);
+        }
+        jlog << " " << (cs == copy) << " " << (copy == cs) << " " << cr.m_allocations - before;
+        copy[7] = 0;
+        jlog << " " << (cs == copy) << " " << cs.get_array()[500] << " " << cs[999] << endl;
+    }
+    jlog << (cr.m_outstanding == 0 ? "PASS" : "FAIL") << ": packed array blocks returned to resource\n";
+    const json &cj = *j;
+    jlog << cj << " " << *d << " " << cj[3] << " " << cj.as_span<int64_t>()[4] << " " << cj.is_packed() << endl;
+
+    double values[] = { 1.5, 2.5, -3.5 };
+    json f = json::from_numbers(values, 3);
+
+    if (f == *d && *d == f && !(f == *m))
+    {
+        jlog << "PASS: packed arrays compare correctly\n";
+    }
+    else
+    {
+        jlog << "FAIL: packed arrays compare incorrectly\n";
+    }
+
+    try
+    {
+        (void)d->as_span<int64_t>();
+        jlog << "FAIL: as_span() with wrong type didn't throw\n";
+    }
+    catch (json_exception &e)
+    {
+        jlog << "PASS: as_span() threw " << e.what() << endl;
+    }
+
+    json c(*j);
+    c.append("x");
+
+    jlog << c << " " << c.is_packed() << " " << j->is_packed() << endl;
+
+    json e = json::from_numbers(values, 0);
+    try
+    {
+        (void)e.minimum();
+        jlog << "FAIL: minimum() of empty array didn't throw\n";
+    }
+    catch (json_array_index_range_exception &e)
+    {
+        jlog << "PASS: minimum() of empty array threw correct exception type\n";
+    }
+
+    std::istringstream is("[1, 2, 3]");
+    stream_reader r(&is, parser::max_message_length, true);
+    parser p(r, true, parser::max_token_length, parser::max_nesting_depth,
+             true, true, true, nullptr, false);
+    jlog << "unpacked parse " << p.parse()->is_packed() << endl;
+
+    tape t(*d);
+    jlog << t << " " << static_cast<double>(t[2]) << endl;
+}
+
+void test_int64()
+{
+    auto j = parser::parse("[9223372036854775807, -9223372036854775808, 18446744073709551615, 18446744073709551616, 1700000000000]");
+    const json &a = *j;
+
+    jlog << a << endl;
+    jlog << a[0].get_instance_type_name() << " " << a[2].get_instance_type_name() << " "
+         << a[3].get_instance_type_name() << " " << a[2].is_uint64() << " " << a[0].is_uint64() << endl;
+    jlog << static_cast<int64_t>(a[0]) << " " << static_cast<int64_t>(a[1]) << " "
+         << static_cast<uint64_t>(a[2]) << " " << static_cast<int64_t>(a[4]) << endl;
+
+    if (a[4] == static_cast<int64_t>(1700000000000) && a[4] > 2147483647 && a[2] > a[0] &&
+        a[1] < a[0] && a[2] == UINT64_MAX && a[0] < UINT64_MAX && !(a[0] == a[2]) &&
+        json(static_cast<uint64_t>(5)) == json(5) && json(INT64_MIN) < json(UINT64_MAX))
+    {
+        jlog << "PASS: 64 bit int comparisons\n";
+    }
+    else
+    {
+        jlog << "FAIL: 64 bit int comparisons\n";
+    }
+
+    try
+    {
+        (void)static_cast<int>(a[4]);
+        jlog << "FAIL: int cast of large value didn't throw\n";
+    }
+    catch (json_exception &e)
+    {
+        jlog << "PASS: int cast of large value threw " << e.what() << endl;
+    }
+
+    try
+    {
+        (void)static_cast<uint64_t>(a[1]);
+        jlog << "FAIL: uint64_t cast of negative value didn't throw\n";
+    }
+    catch (json_exception &e)
+    {
+        jlog << "PASS: uint64_t cast of negative value threw " << e.what() << endl;
+    }
+
+    tape t(a);
+    jlog << t << " " << static_cast<uint64_t>(t[2]) << " " << (*t.to_json() == a) << endl;
+
+    json k;
+    k = static_cast<uint64_t>(UINT64_MAX);
+    json l(k);
+    l = static_cast<int64_t>(-1);
+    jlog << k << " " << l << " " << k.is_uint64() << " " << l.is_uint64() << endl;
+}
+
+void test_copy_on_write()
+{
+    auto j = parser::load("test_files/test2.json");
+    const json &original = *j;
+
+    json c(original);
+    const json &copy = c;
+
+    if (&copy[0].get_object() == &original[0].get_object() &&
+        &copy.get_array() == &original.get_array())
+    {
+        jlog << "PASS: copy shares storage\n";
+    }
+    else
+    {
+        jlog << "FAIL: copy doesn't share storage\n";
+    }
+
+    c[0]["name"] = "Someone Else";
+
+    if (original[0]["name"] == "Alma Spears" && copy[0]["name"] == "Someone Else" &&
+        &copy[1].get_object() == &original[1].get_object() &&
+        &copy[0]["tags"].get_array() == &original[0]["tags"].get_array() &&
+        &copy[0].get_object() != &original[0].get_object())
+    {
+        jlog << "PASS: only the changed path was cloned\n";
+    }
+    else
+    {
+        jlog << "FAIL: changed path not cloned correctly\n";
+    }
+
+    json a(json::array_e);
+    a.append(1);
+    a.append("two");
+    json b(a);
+    b.append(3);
+    jlog << a << " " << b << endl;
+
+    json &r = a[0];
+    json d(a);
+    r = 100;
+    jlog << a << " " << d << endl;
+
+    c = original;
+    jlog << "copies equal " << (c == original) << " " << (&copy.get_array() == &original.get_array()) << endl;
+}
+
+void test_hash()
+{
+    auto j1 = parser::load("test_files/test2.json");
+    auto j2 = parser::load("test_files/test2.json");
+    auto ints = parser::parse("[1, 2, 3]");
+    auto doubles = parser::parse("[1.0, 2.0, 3.0]");
+    auto mixed = parser::parse("[1.0, 2, 3.0]");
+
+    if (j1->hash() == j2->hash() && ints->hash() == doubles->hash() &&
+        ints->hash() == mixed->hash() && json(1).hash() == json(1.0).hash() &&
+        json(0.0).hash() == json(-0.0).hash())
+    {
+        jlog << "PASS: equal instances hash the same\n";
+    }
+    else
+    {
+        jlog << "FAIL: equal instances hash differently\n";
+    }
+
+    if (json("1").hash() != json(1).hash() && json(json::object_e).hash() != json(json::array_e).hash() &&
+        json(true).hash() != json(false).hash())
+    {
+        jlog << "PASS: different instances hash differently\n";
+    }
+    else
+    {
+        jlog << "FAIL: different instances hash the same\n";
+    }
+
+    jlog << "stable hash " << json("argo").hash() << " " << ints->hash() << endl;
+
+    size_t before = j1->hash();
+    json c(*j1);
+    c.append(json(json::null_e));
+    (*j2)[1]["name"] = "Someone Else";
+
+    if (c.hash() != before && j1->hash() == before && j2->hash() != before && !(*j2 == *j1))
+    {
+        jlog << "PASS: hash changes with the instance\n";
+    }
+    else
+    {
+        jlog << "FAIL: hash doesn't change with the instance\n";
+    }
+
+    std::unordered_map<json, int> m;
+    m[*ints] = 1;
+    m[*j1] = 2;
+    jlog << "unordered_map " << m.size() << " " << m[*doubles] << " " << m[json(*j1)] << endl;
+}
+
+void test_deduplicate()
+{
+    auto j = parser::parse(
+        "[{\"id\": 1, \"address\": {\"city\": \"Leeds\", \"tags\": [1, \"a\"]}, \"v\": [1]},"
+        " {\"id\": 2, \"address\": {\"city\": \"Leeds\", \"tags\": [1, \"a\"]}, \"v\": [1.0]},"
+        " {\"id\": 3, \"address\": {\"city\": \"York\", \"tags\": [1, \"a\"]}, \"v\": [1]}]");
+
+    ostringstream before;
+    before << *j;
+
+    size_t n = j->deduplicate();
+
+    ostringstream after;
+    after << *j;
+
+    const json &cj = *j;
+    jlog << "deduplicated " << n << " "
+         << (&cj[0]["address"].get_object() == &cj[1]["address"].get_object()) << " "
+         << (&cj[0]["address"]["tags"].get_array() == &cj[2]["address"]["tags"].get_array()) << " "
+         << (&cj[0]["v"].get_array() == &cj[1]["v"].get_array()) << " "
+         << (before.str() == after.str()) << endl;
+
+    (*j)[1]["address"]["city"] = "Hull";
+    jlog << cj[0]["address"] << " " << cj[1]["address"] << endl;
+    jlog << "deduplicated again " << j->deduplicate() << endl;
+}
+
+void test_shapes()
+{
+    const char *message = "[{\"name\": \"a\", \"price\": 12, \"id\": 1},"
+                          " {\"id\": 2, \"price\": 7.5, \"name\": \"b\"},"
+                          " {\"id\": 3, \"name\": \"c\", \"id\": 4},"
+                          " {}]";
+    std::istringstream shaped_is(message);
+    stream_reader shaped_r(&shaped_is, parser::max_message_length, true);
+    parser shaped_p(shaped_r, true, parser::max_token_length, parser::max_nesting_depth,
+                    true, true, true, nullptr, true, true);
+    auto j = shaped_p.parse();
+    const json &cj = *j;
+
+    jlog << cj << endl;
+    jlog << "shaped " << cj[0].is_shaped() << " " << cj[1].is_shaped() << " "
+         << cj[2].is_shaped() << " " << cj[3].is_shaped() << " "
+         << (cj[0].get_shape() == cj[1].get_shape()) << " "
+         << (cj[0].get_shape() == cj[2].get_shape()) << " "
+         << cj[0].get_shape()->size() << endl;
+    jlog << cj[0]["price"] << " " << cj[1]["price"] << " " << cj[2]["id"] << " "
+         << cj[1].get_shape_values()[0] << " " << cj[1].has("name") << " " << cj[1].has("x") << " "
+         << cj.find(pointer("/1/name")) << endl;
+
+    std::istringstream is(message);
+    stream_reader r(&is, parser::max_message_length, true);
+    parser p(r, true, parser::max_token_length, parser::max_nesting_depth,
+             true, true, true, nullptr, true, false);
+    auto u = p.parse();
+
+    if (*u == *j && *j == *u && u->hash() == j->hash() && !(*u)[0].is_shaped())
+    {
+        jlog << "PASS: shaped objects compare and hash like ordinary ones\n";
+    }
+    else
+    {
+        jlog << "FAIL: shaped objects compare or hash differently to ordinary ones\n";
+    }
+
+    try
+    {
+        (void)cj[0]["x"];
+        jlog << "FAIL: missing member of shaped object didn't throw\n";
+    }
+    catch (json_invalid_key_exception &e)
+    {
+        jlog << "PASS: missing member of shaped object threw " << e.what() << endl;
+    }
+
+    json c(cj[0]);
+    c["price"] = 13;
+    c.insert("stock", json(5));
+    jlog << c << " " << c.is_shaped() << " " << cj[0] << " " << cj[0].is_shaped() << endl;
+
+    json::json_array values;
+    values.push_back(json(1));
+    try
+    {
+        (void)json::from_shape(cj[0].get_shape(), values);
+        jlog << "FAIL: from_shape() with too few values didn't throw\n";
+    }
+    catch (json_exception &e)
+    {
+        jlog << "PASS: from_shape() threw " << e.what() << endl;
+    }
+
+    values.push_back(json("d"));
+    values.push_back(json(9));
+    json f = json::from_shape(cj[0].get_shape(), values);
+    jlog << f << " " << f.get_object().size() << " " << f.is_shaped() << endl;
+
+    tape t(cj);
+    jlog << t << " " << static_cast<double>(t[1]["price"]) << endl;
+
+    // comparing and diffing against ordinary objects goes through the shape
+    // without building a map of the members
+    counting_resource cr;
+    {
+        std::istringstream is2(message);
+        stream_reader r2(&is2, parser::max_message_length, true);
+        parser p2(r2, true, parser::max_token_length, parser::max_nesting_depth,
+                  true, true, true, &cr, true, true);
+        auto s = p2.parse();
+        const json &cs = *s;
+        json changed(*u);
+        changed[1]["price"] = 8;
+        changed[1].insert("stock", json(5));
+        changed[0].get_object().erase("id");
+        size_t before = cr.m_allocations;
+        jlog << (cs == *u) << " " << (cs == changed) << " " << (cs[1] == changed[1]) << " "
+             << json_patch::diff(cs, changed) << " " << cr.m_allocations - before << endl;
+    }
+}
+
+void test_speculative_parse()
+{
+    // one message per line, the third has a different name, the fourth a
+    // duplicate and the fifth one less member
+    std::istringstream is("{\"b\": 1, \"a\": {\"x\": 1}}\n"
+                          "{\"b\": 2, \"a\": {\"x\": 2}}\n"
+                          "{\"b\": 3, \"\\u0061\": {\"y\": 3}}\n"
+                          "{\"b\": 4, \"a\": {\"x\": 4}, \"b\": 5}\n"
+                          "{\"b\": 6}\n");
+    stream_reader r(&is, 1000, false);
+    parser p(r, false, parser::max_token_length, parser::max_nesting_depth,
+             true, true, true, nullptr, true, true);
+    std::vector<std::unique_ptr<json>> messages;
+
+    for (int i = 0; i < 5; i++)
+    {
+        messages.push_back(p.parse());
+        jlog << *messages.back() << " ";
+    }
+    jlog << endl;
+
+    const parser::statistics &s = p.get_statistics();
+    jlog << "objects " << s.m_objects << " names " << s.m_names << " name hits " << s.m_name_hits
+         << " shape hits " << s.m_shape_hits << " rate " << s.name_hit_rate() << endl;
+
+    const json &m0 = *messages[0];
+    const json &m1 = *messages[1];
+    jlog << "shared shape " << (m0.get_shape() == m1.get_shape()) << " "
+         << (m0["a"].get_shape() == m1["a"].get_shape()) << endl;
+
+    p.reset_statistics();
+    jlog << "reset " << p.get_statistics().m_objects << " " << p.get_statistics().name_hit_rate() << endl;
+}
+
+void test_move_and_emplace()
+{
+    json a(json::array_e);
+    json item(json::object_e);
+    string name("name");
+
+    item.emplace("id", 1);
+    item.emplace(name, "widget");
+    item.emplace("id", 2);
+    item.emplace("tags", json::array_e);
+    item.insert(string("price"), json(9.5));
+    item.insert(name, json("gadget"));
+
+    a.append(std::move(item));
+    a.emplace_back(3);
+    a.emplace_back("x");
+    a.emplace_back(a[0]);
+
+    jlog << a << " " << item.get_instance_type_name() << " " << name << endl;
+
+    json::json_object o;
+    o["k"] = json(1);
+    json::json_array v;
+    v.push_back(json(true));
+
+    json j;
+    j = std::move(o);
+    jlog << j << " ";
+    j = std::move(v);
+    jlog << j << endl;
+
+    json::json_array big;
+    big.push_back(json(string(100, 'z')));
+    json moved = json::from_array(std::move(big));
+    const json &cm = moved;
+    jlog << "from_array took over the vector " << cm[0].get_instance_type_name() << " " << big.size() << endl;
+}
+
+void test_parse_into()
+{
+    // same structure twice, then a new structure, a bad message and one more
+    std::istringstream is("{\"id\": 1, \"tags\": [\"a\", \"b\"], \"pos\": [1, 2], \"score\": 0.1}\n"
+                          "{\"id\": 2, \"tags\": [\"c\"], \"pos\": [3, 4], \"score\": 1.5e-3}\n"
+                          "[\"x\", {\"id\": 3}, 12345678901234567.5, 2.5e+40]\n"
+                          "{\"id\": }\n"
+                          "{\"id\": 5, \"tags\": [], \"pos\": [5], \"score\": -0.0}\n");
+    stream_reader r(&is, 1000, false);
+    parser p(r, false);
+    json target;
+    json kept;
+
+    for (int i = 0; i < 5; i++)
+    {
+        try
+        {
+            p.parse_into(target);
+            jlog << target << " ";
+        }
+        catch (json_exception &e)
+        {
+            jlog << e.what() << " " << target.get_instance_type_name() << " ";
+        }
+
+        if (i == 0)
+        {
+            kept = target;
+        }
+    }
+    jlog << endl;
+
+    jlog << "kept " << kept << endl;
+
+    // views built by the const accessors come from the parser's resource and
+    // go back to it when the target is reused
+    monotonic_buffer_resource pool;
+    std::istringstream pooled_is("{\"a\": [1, 2, 3], \"b\": true}\n"
+                                 "{\"a\": [4, 5, 6], \"b\": false}\n");
+    stream_reader pooled_r(&pooled_is, 1000, false);
+    parser pooled_p(pooled_r, false, parser::max_token_length, parser::max_nesting_depth,
+                    true, true, true, &pool, true, true);
+    json pooled;
+    for (int i = 0; i < 2; i++)
+    {
+        pooled_p.parse_into(pooled);
+        const json &c = pooled;
+        jlog << c.get_object().size() << " " << c["a"].get_array().size() << " " << c << " ";
+    }
+    jlog << endl;
+
+    // element blocks of a reused packed array are rebuilt for the new values
+    std::ostringstream series;
+    series << "[1, 2, 3]\n[7, 8, 9]\n[";
+    for (int i = 0; i < 200; i++)
+    {
+        series << (i ? ", " : "") << i * 10;
+    }
+    series << "]\n";
+    std::istringstream series_is(series.str());
+    stream_reader series_r(&series_is, 10000, false);
+    parser series_p(series_r, false);
+    json packed;
+    for (int i = 0; i < 3; i++)
+    {
+        series_p.parse_into(packed);
+        const json &c = packed;
+        jlog << c.is_packed() << " " << c[0] << " " << c[c.size() - 1] << " ";
+    }
+    jlog << endl;
+}
+
+// checked by the compiler
+static_assert(pointer::is_valid("") && pointer::is_valid("/a~0b/~1/0") && pointer::is_valid("#/c%25d"), "valid pointers");
+static_assert(!pointer::is_valid("a") && !pointer::is_valid("/a~2") && !pointer::is_valid("#/%2"), "invalid pointers");
+static_assert(pointer::is_valid("/k\\\"l") && pointer::is_valid("/\\u007e0") && !pointer::is_valid("/\\u007e2"), "escapes");
+
+static const json *find_zip(const json &j)
+{
+    return &j.find(ARGO_POINTER("/0/address/zip"));
+}
+
+void test_literal_pointers()
+{
+    auto j = parser::load("test_files/test7.json");
+
+    jlog << j->find(ARGO_POINTER("")) << " " << j->find(ARGO_POINTER("/foo/1")) << " "
+         << j->find(ARGO_POINTER("/a~1b")) << " " << j->find(ARGO_POINTER("/i\\\\j")) << " "
+         << j->find(ARGO_POINTER("/k\"l")) << " " << j->find(ARGO_POINTER("#/c%25d")) << " "
+         << j->find(ARGO_POINTER("#/m~0n")) << endl;
+
+    // the same pointer each time round
+    auto a = parser::parse("[{\"address\": {\"zip\": \"01234\"}}]");
+    auto b = parser::parse("[{\"address\": {\"zip\": \"98765\"}}]");
+    jlog << *find_zip(*a) << " " << *find_zip(*b) << endl;
+
+    // the compile time check agrees with the constructor
+    for (auto s : {"", "/", "//", "x", "/~", "/~0", "/~1/~2", "#", "#x", "#/%2", "#/%2H", "#/%20", "#/%2f", "/%2", "/\\q"})
+    {
+        bool constructed = true;
+        try
+        {
+            pointer p(s);
+        }
+        catch (json_exception &e)
+        {
+            constructed = false;
+        }
+        jlog << "'" << s << "' " << (pointer::is_valid(s) == constructed ? "agrees " : "DIFFERS ");
+    }
+    jlog << endl;
+}
+
+void test_pointer_updates()
+{
+    auto j = parser::parse("{\"user\": {\"name\": \"ann\", \"roles\": [\"a\", \"b\"]}, \"n\": [1, 2, 3]}");
+    json original = *j;
+    const json &c = *j;
+    size_t h = c.hash();
+
+    jlog << (c.try_find(pointer("/user/age")) == nullptr) << " " << (c.try_find(pointer("/n/3")) == nullptr) << " "
+         << *c.try_find(pointer("/user/roles/1")) << endl;
+
+    // changes go to j only, and the cached hash follows them
+    j->find_mutable(pointer("/user/name")) = "bob";
+    j->set(pointer("/user/roles/2"), json("c"));
+    j->set(pointer("/n/0"), json(10));
+    j->set(pointer("/meta/tags/0/id"), json(1), true);
+    jlog << *j << " " << original << " " << (c.hash() != h) << endl;
+
+    // nothing is created if the pointer can't be followed
+    std::vector<std::pair<const char *, bool>> bad = {
+        {"/meta/tags/5/id", true}, {"/n/7", true}, {"/user/name/x", true}, {"/new/x/1", true}, {"/missing/x", false}
+    };
+    for (auto &b : bad)
+    {
+        try
+        {
+            j->set(pointer(b.first), json(true), b.second);
+            jlog << "FAIL: set " << b.first << " ";
+        }
+        catch (json_exception &e)
+        {
+            jlog << b.first << " " << e.what() << " ";
+        }
+    }
+    jlog << endl << *j << endl;
+
+    jlog << j->erase(pointer("/user/roles/0")) << " " << j->erase(pointer("/meta")) << " "
+         << j->erase(pointer("/meta")) << " " << j->erase(pointer("/n/9")) << " " << *j << endl;
+
+    auto expected = parser::parse("{\"user\": {\"name\": \"bob\", \"roles\": [\"b\", \"c\"]}, \"n\": [10, 2, 3]}");
+    jlog << (*j == *expected) << " " << (c.hash() == static_cast<const json &>(*expected).hash()) << endl;
+
+    j->set(pointer(""), json(json::array_e));
+    jlog << *j << " " << j->erase(pointer("")) << " " << *j << endl;
+}
+
+void test_wildcard_pointers()
+{
+    auto j = parser::parse("{\"items\": [{\"price\": 1, \"sku\": \"a\"}, {\"price\": 2.5, \"sku\": \"b\"}, {\"sku\": \"c\"}],"
+                           " \"stock\": {\"x\": [1, 2], \"y\": [3], \"z\": []}, \"*\": \"star\"}");
+    const json &c = *j;
+
+    for (auto s : {"/items/*/price", "/items/*/*", "/stock/*/0", "/stock/*/*", "/*/1/sku", "/items/*/sku/x", "/none/*", "/*"})
+    {
+        jlog << s << ":";
+        for (auto m : c.find_all(pointer(s)))
+        {
+            jlog << " " << *m;
+        }
+        jlog << endl;
+    }
+
+    // find() is unchanged and a visitor sees the same as the vector
+    double total = 0;
+    c.find_all(pointer("/items/*/price"), [&total](const json &p) { total += static_cast<double>(p); });
+    jlog << c.find(pointer("/*")) << " " << total << " " << c.find_all(pointer("/items/1")).size() << endl;
+}
+
+void test_pointer_sets()
+{
+    auto j = parser::parse("{\"payload\": {\"meta\": {\"id\": 7, \"source\": \"web\"}, \"lines\": [{\"qty\": 1}, {\"qty\": 2}]},"
+                           " \"version\": 2}");
+    const json &c = *j;
+
+    vector<string> paths = {
+        "/payload/meta/id", "/payload/meta/source", "/payload/meta/missing", "/version", "/payload/lines/1/qty",
+        "/payload/lines/5/qty", "", "/payload/meta/id", "/version/x", "/payload/lines/0", "#/payload/meta"
+    };
+    vector<pointer> pointers;
+    for (const auto &p : paths)
+    {
+        pointers.push_back(pointer(p));
+    }
+    pointer_set s(pointers);
+    vector<const json *> results;
+
+    c.find(s, results);
+    jlog << s.size() << " pointers " << s.get_nodes().size() << " nodes" << endl;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        jlog << "'" << paths[i] << "' ";
+        if (results[i] == nullptr)
+        {
+            jlog << "missing";
+        }
+        else if (results[i] == c.try_find(pointers[i]))
+        {
+            jlog << *results[i];
+        }
+        else
+        {
+            jlog << "FAIL: differs from try_find";
+        }
+        jlog << endl;
+    }
+
+    // the same results vector for a second document
+    auto k = parser::parse("{\"version\": 3}");
+    k->find(s, results);
+    jlog << (results[0] == nullptr) << " " << *results[3] << " " << results.size() << endl;
+}
+
+void test_json_path()
+{
+    auto j = parser::parse(
+        "{\"store\": {\"book\": ["
+        "{\"category\": \"reference\", \"author\": \"Nigel Rees\", \"title\": \"Sayings of the Century\", \"price\": 8.95},"
+        "{\"category\": \"fiction\", \"author\": \"Evelyn Waugh\", \"title\": \"Sword of Honour\", \"price\": 12.99},"
+        "{\"category\": \"fiction\", \"author\": \"Herman Melville\", \"title\": \"Moby Dick\", \"isbn\": \"0-553-21311-3\", \"price\": 8},"
+        "{\"category\": \"fiction\", \"author\": \"J. R. R. Tolkien\", \"title\": \"The Lord of the Rings\", \"isbn\": \"0-395-19395-8\", \"price\": 22.99}],"
+        "\"bicycle\": {\"color\": \"red\", \"price\": 19.95, \"0\": \"zero\"}}, \"tags\": [1, 2, 3, 4, 5], \"flags\": [true, null, false]}");
+    const json &c = *j;
+
+    for (auto e : {
+            "$", "$.store.book[*].author", "$..author", "$.store.*", "$.store..price", "$..book[2].title",
+            "$..book[-1].title", "$..book[0,1].title", "$..book[:2].title", "$.tags[1:4]", "$.tags[::-2]", "$.tags[-2:]",
+            "$.tags[10:]", "$..book[?(@.isbn)].title", "$..book[?(@.price < 10)].title", "$..book[?(@.price >= 12.99)].price",
+            "$..book[?(@.category == 'fiction' && !(@.price > 20))].title", "$..book[?(9 > @.price || @.author == \"Evelyn Waugh\")].title",
+            "$.store.bicycle['0']", "$.store['bicycle'].color", "$.flags[?(@ == true)]", "$.flags[?(@ == null)]",
+            "$.flags[?(@ != false)]", "$.tags[?(@ > 2.5)]", "$..book[?(@.price != 8)].price", "$.missing..x", "$..[0]"})
+    {
+        jlog << e << ":";
+        for (auto m : json_path(e).find_all(c))
+        {
+            jlog << " " << *m;
+        }
+        jlog << endl;
+    }
+
+    for (auto e : {"", "store", "$.", "$..", "$[", "$[1:2:0]", "$[?(@.a ==)]", "$['a", "$.a b", "$[?(1 == 2)]"})
+    {
+        try
+        {
+            json_path p(e);
+            jlog << "FAIL: " << e << " compiled ";
+        }
+        catch (json_exception &ex)
+        {
+            jlog << "'" << e << "' " << ex.what() << endl;
+        }
+    }
+
+    // a plan is reusable, and visits in the same order as it collects
+    json_path prices("$..price");
+    double total = 0;
+    prices.find_all(c, [&total](const json &p) { total += static_cast<double>(p); });
+    jlog << prices.get_expression() << " " << total << " " << prices.find_all(c).size() << endl;
+}
+
+void test_json_index()
+{
+    auto accounts = parser::parse("[{\"id\": 1, \"name\": \"a\"}, {\"id\": \"x7\", \"name\": \"b\"}, {\"name\": \"no id\"},"
+                                  " {\"id\": 3.0, \"name\": \"c\"}, {\"id\": 1, \"name\": \"d\"}, 42]");
+    json copy = *accounts;
+    json_index by_id(*accounts, pointer("/id"));
+
+    jlog << by_id.size() << " " << *by_id.find(1) << " " << *by_id.find("x7") << " " << *by_id.find(3) << " "
+         << (by_id.find(2) == nullptr) << " " << (by_id.find("1") == nullptr) << " " << by_id.find_all(1).size() << endl;
+
+    // enough appends to grow the table a few times, duplicates stay in order
+    for (int i = 100; i < 200; i++)
+    {
+        json a(json::object_e);
+        a.insert("id", json(i % 50 + 100));
+        a.insert("n", json(i));
+        by_id.append(std::move(a));
+    }
+    jlog << by_id.size() << " " << *by_id.find(120) << " ";
+    for (auto a : by_id.find_all(1))
+    {
+        jlog << *a << " ";
+    }
+    for (auto a : by_id.find_all(149))
+    {
+        jlog << (*a)["n"] << " ";
+    }
+    jlog << endl;
+
+    // other changes need a rebuild, the copy taken earlier is untouched
+    accounts->set(pointer("/0/id"), json(2));
+    by_id.rebuild();
+    jlog << by_id.size() << " " << *by_id.find(2) << " " << by_id.find_all(1).size() << " " << copy.get_array().size() << endl;
+
+    // a packed array is indexed by value without being unpacked
+    auto series = parser::parse("[5, 7, 9, 7]");
+    json_index by_value(*series, pointer(""));
+    jlog << by_value.size() << " " << *by_value.find(9) << " " << by_value.find_all(7).size() << " "
+         << (by_value.find(8) == nullptr) << " " << series->is_packed() << endl;
+}
+
+void test_path_index()
+{
+    // parsed objects are shaped, the inserted one isn't and the numbers are packed
+    std::istringstream is("{\"a\": {\"b\": [10, 20, {\"c\": \"deep\"}]}, \"0\": \"zero\", \"n\": [1, 2, 3],"
+                          " \"m~n\": {\"*\": true}}");
+    stream_reader r(&is, parser::max_message_length, true);
+    parser p(r, true, parser::max_token_length, parser::max_nesting_depth,
+             true, true, true, nullptr, true, true);
+    auto doc = p.parse();
+    json extra(json::object_e);
+    extra.insert("x", json("y"));
+    doc->insert("e", std::move(extra));
+
+    const char *paths[] = {"", "/a", "/a/b/1", "/a/b/2/c", "/a/b/3", "/a/c", "/0", "/n/2", "/n/x", "/m~0n/*",
+                           "/e/x", "/e/x/y", "#/a/b/0"};
+
+    // every depth gives what json::try_find() does
+    size_t depths[] = {path_index::all_depths, 2, 0};
+    for (auto d : depths)
+    {
+        path_index index(*doc, d);
+        jlog << index.size();
+        for (auto s : paths)
+        {
+            pointer p(s);
+            const json *j = index.try_find(p);
+            jlog << " " << (j == doc->try_find(p) ? "" : "MISMATCH ");
+            if (j == nullptr)
+            {
+                jlog << "-";
+            }
+            else
+            {
+                jlog << *j;
+            }
+        }
+        jlog << endl;
+    }
+
+    // after a change the index has to be rebuilt
+    path_index index(*doc);
+    doc->set(pointer("/a/b/0"), json("changed"));
+    index.rebuild();
+    jlog << index.find(pointer("/a/b/0")) << " " << index.size() << " ";
+    try
+    {
+        index.find(pointer("/a/b/7"));
+    }
+    catch (json_exception &e)
+    {
+        jlog << e.what();
+    }
+    jlog << endl;
+}
+
+void test_json_patch()
+{
+    // document, patch, from the examples in RFC 6902 appendix A and some more
+    const char *cases[][2] = {
+        {"{\"foo\": \"bar\"}", "[{\"op\": \"add\", \"path\": \"/baz\", \"value\": \"qux\"}]"},
+        {"{\"foo\": [\"bar\", \"baz\"]}", "[{\"op\": \"add\", \"path\": \"/foo/1\", \"value\": \"qux\"}]"},
+        {"{\"baz\": \"qux\", \"foo\": \"bar\"}", "[{\"op\": \"remove\", \"path\": \"/baz\"}]"},
+        {"{\"foo\": [\"bar\", \"qux\", \"baz\"]}", "[{\"op\": \"remove\", \"path\": \"/foo/1\"}]"},
+        {"{\"baz\": \"qux\", \"foo\": \"bar\"}", "[{\"op\": \"replace\", \"path\": \"/baz\", \"value\": \"boo\"}]"},
+        {"{\"foo\": {\"bar\": \"baz\", \"waldo\": \"fred\"}, \"qux\": {\"corge\": \"grault\"}}",
+         "[{\"op\": \"move\", \"from\": \"/foo/waldo\", \"path\": \"/qux/thud\"}]"},
+        {"{\"foo\": [\"all\", \"grass\", \"cows\", \"eat\"]}", "[{\"op\": \"move\", \"from\": \"/foo/1\", \"path\": \"/foo/3\"}]"},
+        {"{\"baz\": \"qux\", \"foo\": [\"a\", 2, \"c\"]}",
+         "[{\"op\": \"test\", \"path\": \"/baz\", \"value\": \"qux\"}, {\"op\": \"test\", \"path\": \"/foo/1\", \"value\": 2.0}]"},
+        {"{\"foo\": \"bar\"}", "[{\"op\": \"add\", \"path\": \"/child\", \"value\": {\"grandchild\": {}}}]"},
+        {"{\"foo\": [\"bar\"]}", "[{\"op\": \"add\", \"path\": \"/foo/-\", \"value\": [\"abc\", \"def\"]}]"},
+        {"{\"0\": 1, \"a\": [1]}", "[{\"op\": \"copy\", \"from\": \"/a\", \"path\": \"/0\"}, {\"op\": \"add\", \"path\": \"/a/0\", \"value\": 0}]"},
+        {"{\"a\": 1}", "[{\"op\": \"replace\", \"path\": \"\", \"value\": [true]}, {\"op\": \"add\", \"path\": \"/1\", \"value\": false}]"},
+        // failures leave the document as it was
+        {"{\"baz\": \"qux\"}", "[{\"op\": \"test\", \"path\": \"/baz\", \"value\": \"bar\"}]"},
+        {"{\"foo\": \"bar\"}", "[{\"op\": \"add\", \"path\": \"/baz/bat\", \"value\": \"qux\"}]"},
+        {"{\"a\": [1, 2, 3], \"b\": {\"c\": 4}, \"d\": 5}",
+         "[{\"op\": \"remove\", \"path\": \"/a/0\"}, {\"op\": \"move\", \"from\": \"/b/c\", \"path\": \"/a/-\"},"
+         " {\"op\": \"replace\", \"path\": \"/d\", \"value\": 6}, {\"op\": \"add\", \"path\": \"/b/x\", \"value\": 7},"
+         " {\"op\": \"move\", \"from\": \"/a/0\", \"path\": \"/a/9\"}]"},
+        {"{\"a\": 1}", "[{\"op\": \"replace\", \"path\": \"\", \"value\": 2}, {\"op\": \"remove\", \"path\": \"/a\"}]"},
+        // invalid patches
+        {"{}", "[{\"op\": \"jump\", \"path\": \"/a\"}]"},
+        {"{}", "[{\"op\": \"add\", \"path\": \"/a\"}]"},
+        {"{}", "[{\"op\": \"move\", \"from\": \"/a\", \"path\": \"/a/b\"}]"},
+        {"{}", "{\"op\": \"remove\", \"path\": \"/a\"}"},
+    };
+
+    for (const auto &c : cases)
+    {
+        auto doc = parser::parse(c[0]);
+        json before = *doc;
+        try
+        {
+            json_patch patch(*parser::parse(c[1]));
+            patch.apply(*doc);
+            jlog << patch.size() << " " << *doc << endl;
+        }
+        catch (json_exception &e)
+        {
+            jlog << e.what() << " " << *doc << " " << (*doc == before) << endl;
+        }
+    }
+
+    // the containers along a patched path can still be shared by copies
+    auto doc = parser::parse("{\"a\": {\"b\": [1, \"x\"], \"c\": 2}, \"d\": [3]}");
+    json_patch(*parser::parse("[{\"op\": \"add\", \"path\": \"/a/b/-\", \"value\": 4},"
+                              " {\"op\": \"remove\", \"path\": \"/a/c\"}]")).apply(*doc);
+    json copy = *doc;
+    const json &cd = *doc;
+    const json &cc = copy;
+    jlog << cc << " " << (&cd.get_object() == &cc.get_object()) << " "
+         << (&cd["a"].get_object() == &cc["a"].get_object()) << " "
+         << (&cd["a"]["b"].get_array() == &cc["a"]["b"].get_array()) << endl;
+}
+
+void test_json_diff()
+{
+    // source, target
+    const char *cases[][2] = {
+        {"{\"a\": 1, \"b\": [1, 2], \"c\": {\"d\": true}}", "{\"a\": 1.0, \"b\": [1, 2], \"c\": {\"d\": true}}"},
+        {"{\"a\": 1, \"b\": 2, \"d\": 4}", "{\"b\": 3, \"c\": \"x\", \"d\": 4}"},
+        {"{\"a\": {\"b\": {\"c\": [1, {\"d\": null}]}}}", "{\"a\": {\"b\": {\"c\": [1, {\"d\": false}]}}}"},
+        {"[1, 2, 3]", "[1, 2, 3, 4, 5]"},
+        {"[1, 2, 3]", "[0, 1, 2, 3]"},
+        {"[1, 2, 3, 4, 5]", "[1, 5]"},
+        {"[1.5, 2.5, 3.5]", "[1.5, 4.5, 3.5, 5.5]"},
+        {"[1, 2, 3]", "[1, 2.5, 3]"},
+        {"[{\"id\": 1}, {\"id\": 2}, 3]", "[{\"id\": 1}, {\"id\": 7}, {\"id\": 8}, 3]"},
+        {"{\"a/b\": 1, \"m~n\": [true], \"q\\\"s\": 0}", "{\"a/b\": 2, \"m~n\": [], \"q\\\"s\": 1}"},
+        {"{\"a\": [1]}", "[\"a\"]"},
+        {"{\"a\": {\"x\": 1}}", "{\"a\": [1]}"},
+    };
+
+    for (const auto &c : cases)
+    {
+        auto source = parser::parse(c[0]);
+        auto target = parser::parse(c[1]);
+        json patch = json_patch::diff(*source, *target);
+        json_patch(patch).apply(*source);
+        jlog << patch << " " << (*source == *target) << endl;
+    }
+
+    // a copy changed in one place, the rest is shared and not looked at
+    auto doc = parser::parse("{\"list\": [{\"a\": 1}, {\"a\": 2}], \"other\": {\"x\": [1, 2, 3]}}");
+    json changed = *doc;
+    changed.set(pointer("/list/1/a"), json(3));
+    changed.set(pointer("/list/2"), json("new"));
+    jlog << json_patch::diff(*doc, changed) << endl;
+
+    // long packed series are compared from their values, only the elements
+    // that differ are built
+    counting_resource cr;
+    {
+        std::ostringstream a, b;
+        a << "[";
+        b << "[";
+        for (int i = 0; i < 1000; i++)
+        {
+            a << (i ? ", " : "") << i;
+            b << (i ? ", " : "") << (i == 500 ? -1 : i);
+        }
+        a << "]";
+        b << "]";
+        std::istringstream ais(a.str()), bis(b.str());
+        stream_reader ar(&ais, parser::max_message_length, true), br(&bis, parser::max_message_length, true);
+        parser ap(ar, true, parser::max_token_length, parser::max_nesting_depth, true, true, true, &cr);
+        parser bp(br, true, parser::max_token_length, parser::max_nesting_depth, true, true, true, &cr);
+        auto sa = ap.parse();
+        auto sb = bp.parse();
+        size_t before = cr.m_allocations;
+        jlog << json_patch::diff(*sa, *sb) << " " << cr.m_allocations - before << " "
+             << sa->is_packed() << sb->is_packed() << endl;
+    }
+}
+
+void test_merge_patch()
+{
+    // target, patch, from RFC 7396 appendix A
+    const char *cases[][2] = {
+        {"{\"a\":\"b\"}", "{\"a\":\"c\"}"},
+        {"{\"a\":\"b\"}", "{\"b\":\"c\"}"},
+        {"{\"a\":\"b\"}", "{\"a\":null}"},
+        {"{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":null}"},
+        {"{\"a\":[\"b\"]}", "{\"a\":\"c\"}"},
+        {"{\"a\":\"c\"}", "{\"a\":[\"b\"]}"},
+        {"{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}"},
+        {"{\"a\":[{\"b\":\"c\"}]}", "{\"a\":[1]}"},
+        {"[\"a\",\"b\"]", "[\"c\",\"d\"]"},
+        {"{\"a\":\"b\"}", "[\"c\"]"},
+        {"{\"a\":\"foo\"}", "null"},
+        {"{\"a\":\"foo\"}", "\"bar\""},
+        {"{\"e\":null}", "{\"a\":1}"},
+        {"[1,2]", "{\"a\":\"b\",\"c\":null}"},
+        {"{}", "{\"a\":{\"bb\":{\"ccc\":null}}}"},
+    };
+
+    for (const auto &c : cases)
+    {
+        auto target = parser::parse(c[0]);
+        target->merge_patch(std::move(*parser::parse(c[1])));
+        jlog << *target << endl;
+    }
+
+    // a patch that shares its storage with a copy is left as it was
+    json base(json::object_e);
+    base.insert("a", json(1));
+    auto overlay = parser::parse("{\"a\": null, \"b\": {\"c\": [1, 2], \"d\": {\"e\": true}}}");
+    json kept = *overlay;
+    base.merge_patch(std::move(*overlay));
+    jlog << base << " " << kept << endl;
+
+    // objects that replace scalars and arrays stay in the target's resource
+    counting_resource cr;
+    {
+        std::istringstream is("{\"a\": 1, \"b\": [\"x\"], \"c\": {\"d\": 2}}");
+        stream_reader r(&is, parser::max_message_length, true);
+        parser p(r, true, parser::max_token_length, parser::max_nesting_depth, true, true, true, &cr);
+        auto pooled = p.parse();
+        pooled->merge_patch(std::move(*parser::parse("{\"a\": {\"x\": 1}, \"b\": {\"y\": null},"
+                                                     " \"c\": {\"d\": {\"z\": 3}}}")));
+        const json &cp = *pooled;
+        jlog << cp << " " << (cp["a"].get_memory_resource() == &cr) << " "
+             << (cp["b"].get_memory_resource() == &cr) << " "
+             << (cp["c"]["d"].get_memory_resource() == &cr) << endl;
+    }
+}
+
+void test_exception_free()
+{
+    auto doc = parser::parse("{\"i\": 7, \"d\": 2.5, \"s\": \"text\", \"b\": true, \"n\": null,"
+                             " \"big\": 18446744073709551615, \"neg\": -3, \"wide\": 5000000000, \"a\": [1, \"x\"]}");
+    const json &d = *doc;
+
+    jlog << (d["i"].get_if<int64_t>() ? *d["i"].get_if<int64_t>() : -1) << " "
+         << (d["i"].get_if<double>() == nullptr) << " "
+         << *d["d"].get_if<double>() << " "
+         << *d["s"].get_if<std::string>() << " "
+         << (d["s"].get_if<bool>() == nullptr) << " "
+         << *d["b"].get_if<bool>() << " "
+         << (d["big"].get_if<int64_t>() == nullptr) << " "
+         << *d["big"].get_if<uint64_t>() << " "
+         << (d["neg"].get_if<uint64_t>() == nullptr) << " "
+         << (d["n"].get_if<std::string>() == nullptr) << endl;
+
+    // the same conversions as the casts, the fallback where they'd throw
+    jlog << d["i"].value_or(0) << " " << d["d"].value_or(0) << " " << d["s"].value_or(-1) << " "
+         << d["wide"].value_or(-1) << " " << d["wide"].value_or(int64_t(-1)) << " "
+         << d["big"].value_or(int64_t(-1)) << " " << d["neg"].value_or(uint64_t(9)) << " "
+         << d["i"].value_or(0.5) << " " << d["s"].value_or(1.5) << " "
+         << d["i"].value_or(false) << " " << d["n"].value_or(true) << " "
+         << d["s"].value_or("none") << " " << d["i"].value_or("none") << " "
+         << d["s"].value_or(std::string("none")) << " " << d["b"].value_or(std::string("none")) << endl;
+
+    json raw(json::number_int_e, "123");
+    jlog << raw.value_or(-1) << " " << (raw.get_if<int64_t>() == nullptr) << endl;
+
+    // lookups that miss
+    jlog << *d.try_get("i") << " " << (d.try_get("missing") == nullptr) << " "
+         << (d["i"].try_get("i") == nullptr) << " " << *d["a"].try_get(1) << " "
+         << (d["a"].try_get(2) == nullptr) << " " << (d.try_get(0) == nullptr) << endl;
+
+    // the throwing versions still say what went wrong
+    const char *messages[] = {"[1, 2]", "[1, 2", "{\"a\": tru}", "[1] x", "\"\\q\""};
+    for (auto m : messages)
+    {
+        parser::error e;
+        auto j = parser::try_parse(m, e);
+        if (j)
+        {
+            jlog << *j << " ";
+        }
+        else
+        {
+            jlog << e.m_type << "@" << e.m_byte_index << " ";
+        }
+    }
+    jlog << endl;
+}
+
+static string parse_outcome(const string &s, unsigned threads, size_t min_slice)
+{
+    // the text and packing of the result or the exception, with its byte index
+    try
+    {
+        unique_ptr<json> j;
+        if (threads == 0)
+        {
+            memory_reader r(s.data(), s.size(), SIZE_MAX);
+            parser p(r);
+            j = p.parse();
+        }
+        else
+        {
+            j = parser::parse_parallel(s.data(), s.size(), threads, min_slice);
+        }
+        ostringstream os;
+        os << *j << " " << j->is_packed();
+        return os.str();
+    }
+    catch (json_exception &e)
+    {
+        return e.what();
+    }
+}
+
+void test_parse_parallel()
+{
+    ostringstream records;
+    records << "[";
+    for (int i = 0; i < 60; i++)
+    {
+        records << (i ? ", " : "") << "{\"id\": " << i << ", \"tags\": [\"a,]\", \"b\\\"[\"], \"x\": {\"y\": [" << i << "]}}";
+    }
+    records << "]\n";
+
+    const string messages[] = {
+        records.str(),
+        "  [1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12]  ",
+        "[1.5, 2.5, 3.5, 4.5, 5.5, 6.5]",
+        "[1.5, 2, 3, 4, 5, 6]",
+        "[{\"a\": 1, \"b\": \"x,]\"}, {\"b\": \"q\\\"],[\", \"a\": 2}, [], {}, \"s\\\\\", null, true, [[1], [2, [3]]]]",
+        "[\"a\\\\\", \"b\", \"c\\\\\\\\\", \"d\\\\\\\"\", \"e\"]",
+        "{\"a\": [1, 2, 3, 4, 5, 6]}",
+        "[] [1, 2, 3, 4, 5]",
+        "[1, 2, 3, 4, 5] x",
+        "[1, 2, {\"a\": 1]}, 4, 5, 6, 7]",
+        "[1, 2, 3, 4, 5, 6",
+        "[1, 2, 3, 4, 5, 6,]",
+        "[1, 2, \"abc\\u12\", 4, 5, 6]",
+        "[1, 2, \\ 3, 4, 5, 6]",
+        "[1, 2, 3, 4, 5, 6] ]",
+    };
+
+    size_t runs = 0;
+    size_t differences = 0;
+    for (const auto &m : messages)
+    {
+        string expected = parse_outcome(m, 0, 0);
+        for (unsigned threads : {2u, 5u})
+        {
+            for (size_t min_slice = 1; min_slice <= m.size(); min_slice++)
+            {
+                runs++;
+                if (parse_outcome(m, threads, min_slice) != expected)
+                {
+                    jlog << "different: " << m << " " << threads << " " << min_slice << endl;
+                    differences++;
+                }
+            }
+        }
+    }
+    jlog << runs << " parallel parses, " << differences << " different" << endl;
+
+    jlog << parse_outcome(messages[4], 2, 1) << endl;
+    jlog << parse_outcome(messages[5], 2, 1) << endl;
+    for (size_t i = 7; i < sizeof(messages) / sizeof(messages[0]); i++)
+    {
+        jlog << parse_outcome(messages[i], 2, 1) << endl;
+    }
+}
+
 int main(int argc, char *argv[])
 {
     jlog.open("test_files/jlog.txt");
@@ -1798,6 +3142,29 @@ int main(int argc, char *argv[])
         test_pointer();
         test_invalid_data_access();
         test_factory_methods();
+        test_memory_resource();
+        test_tape();
+        test_packed_arrays();
+        test_int64();
+        test_copy_on_write();
+        test_hash();
+        test_deduplicate();
+        test_shapes();
+        test_speculative_parse();
+        test_move_and_emplace();
+        test_parse_into();
+        test_literal_pointers();
+        test_pointer_updates();
+        test_wildcard_pointers();
+        test_pointer_sets();
+        test_json_path();
+        test_json_index();
+        test_path_index();
+        test_json_patch();
+        test_json_diff();
+        test_merge_patch();
+        test_exception_free();
+        test_parse_parallel();
     }
     catch (json_exception &e)
     {
@@ -74,22 +74,22 @@ void lexer::read_token()
         switch (c)
         {
         case '[':
-            m_token = token(token::begin_array_e);
+            m_token.set(token::begin_array_e);
             break;
         case ']':
-            m_token = token(token::end_array_e);
+            m_token.set(token::end_array_e);
             break;
         case '{':
-            m_token = token(token::begin_object_e);
+            m_token.set(token::begin_object_e);
             break;
         case '}':
-            m_token = token(token::end_object_e);
+            m_token.set(token::end_object_e);
             break;
         case ':':
-            m_token = token(token::name_separator_e);
+            m_token.set(token::name_separator_e);
             break;
         case ',':
-            m_token = token(token::value_separator_e);
+            m_token.set(token::value_separator_e);
             break;
         case '-':
             m_reader.put_back(c);
@@ -261,7 +261,7 @@ void lexer::read_number()
         m_reader.put_back(c);
     }
 
-    m_token = token(is_double ? token::number_double_e : token::number_int_e, m_buffer, n);
+    m_token.set(is_double ? token::number_double_e : token::number_int_e, m_buffer, n);
 }
 
 void lexer::read_string()
@@ -283,7 +283,7 @@ void lexer::read_string()
         }
         else if (c == '"' && !in_escape)
         {
-            m_token = token(token::string_e, m_buffer, n);
+            m_token.set(token::string_e, m_buffer, n);
             return;
         }
         else
@@ -300,26 +300,26 @@ void lexer::read_string()
                 m_buffer[n++] = c;
             }
         }
-        in_escape = (c == '\\');
+        in_escape = !in_escape && c == '\\';
     }
 }
 
 void lexer::read_false()
 {
     read_matching("alse");
-    m_token = token(token::false_e);
+    m_token.set(token::false_e);
 }
 
 void lexer::read_true()
 {
     read_matching("rue");
-    m_token = token(token::true_e);
+    m_token.set(token::true_e);
 }
 
 void lexer::read_null()
 {
     read_matching("ull");
-    m_token = token(token::null_e);
+    m_token.set(token::null_e);
 }
 
 void lexer::read_matching(const char *s)
@@ -354,3 +354,8 @@ void lexer::put_back_last()
 {
     m_last_put_back = true;
 }
+
+void lexer::reset() noexcept
+{
+    m_last_put_back = false;
+}
@@ -69,6 +69,12 @@ namespace NAMESPACE
          */
         void put_back_last();
 
+        /**
+         * Forget any token that was put back, ready to start reading a new
+         * message.
+         */
+        void reset() noexcept;
+
     private:
 
         /**
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file memory_reader.cpp The memory_reader class implementation.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "common.hpp"
+#include "memory_reader.hpp"
+
+using namespace NAMESPACE;
+
+memory_reader::memory_reader(
+                const char *data,
+                size_t     size,
+                size_t     max_message_length,
+                bool       block_read,
+                size_t     byte_index) :
+                            reader(max_message_length, block_read),
+                            m_data(data),
+                            m_size(size),
+                            m_index(0)
+{
+    m_byte_index = byte_index;
+}
+
+int memory_reader::read_next_char()
+{
+    if (m_index < m_size)
+    {
+        return static_cast<unsigned char>(m_data[m_index++]);
+    }
+    else
+    {
+        return EOF;
+    }
+}
+
+bool memory_reader::read_next_block()
+{
+    size_t n = std::min(m_size - m_index, static_cast<size_t>(block_size));
+
+    if (n == 0)
+    {
+        return false;
+    }
+    else
+    {
+        memcpy(m_block, m_data + m_index, n);
+        m_index += n;
+        m_block_num_bytes = static_cast<int>(n);
+        m_block_index = 0;
+        return true;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef _json_memory_reader_hpp_
+#define _json_memory_reader_hpp_
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file memory_reader.hpp The memory_reader class.
+
+#include "reader.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * A derived class of reader that reads from a buffer already in memory,
+     * e.g. a message loaded in one go or a memory mapped file. Nothing is
+     * copied up front so it is cheaper than an istringstream for big messages.
+     */
+    class memory_reader : public reader
+    {
+    public:
+
+        virtual ~memory_reader() {}
+
+        /**
+         * Constructor.
+         * \param   data                The message. The instance does not take a copy and
+         *                              the data must stay in place while it is being read.
+         * \param   size                Number of bytes in the message.
+         * \param   max_message_length  Longest message that can be read.
+         * \param   block_read          Whether to read in blocks or one byte at a time.
+         * \param   byte_index          Byte index of data[0] in the message. Non-zero when
+         *                              reading one piece of a bigger message so that errors
+         *                              are reported relative to the whole message.
+         */
+        memory_reader(
+                const char *data,
+                size_t     size,
+                size_t     max_message_length,
+                bool       block_read = true,
+                size_t     byte_index = 0);
+
+    protected:
+
+        /// Read the next character from the buffer.
+        virtual int read_next_char();
+
+        /**
+         * Copy the next block of data up to block_size bytes.
+         * \return  true if some data was read, false at the end of the buffer.
+         */
+        virtual bool read_next_block();
+
+        /// The message.
+        const char *m_data;
+
+        /// Number of bytes in the message.
+        size_t m_size;
+
+        /// Index into m_data of the next byte to read.
+        size_t m_index;
+    };
+}
+
+#endif
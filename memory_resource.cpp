@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/// \file memory_resource.cpp The memory_resource classes implementation.
+
+#include <new>
+
+#include "common.hpp"
+#include "memory_resource.hpp"
+
+using namespace NAMESPACE;
+
+namespace
+{
+    size_t align_up(size_t n, size_t alignment)
+    {
+        return (n + alignment - 1) & ~(alignment - 1);
+    }
+
+    /// The resource behind new_delete_resource().
+    class new_delete_memory_resource : public memory_resource
+    {
+    protected:
+
+        virtual void *do_allocate(size_t bytes, size_t alignment)
+        {
+            if (alignment <= max_alignment)
+            {
+                return ::operator new(bytes);
+            }
+
+            // C++11 has no aligned operator new, so allocate enough to align
+            // the block and keep the pointer to free just in front of it.
+            char *p = static_cast<char *>(::operator new(bytes + alignment + sizeof(void *)));
+            void **res = reinterpret_cast<void **>(align_up(reinterpret_cast<size_t>(p) + sizeof(void *), alignment));
+            res[-1] = p;
+            return res;
+        }
+
+        virtual void do_deallocate(void *p, size_t bytes, size_t alignment)
+        {
+            if (alignment <= max_alignment)
+            {
+                ::operator delete(p);
+            }
+            else
+            {
+                ::operator delete(static_cast<void **>(p)[-1]);
+            }
+        }
+
+        virtual bool do_is_equal(const memory_resource &other) const noexcept
+        {
+            return this == &other;
+        }
+    };
+}
+
+void *memory_resource::allocate(size_t bytes, size_t alignment)
+{
+    return do_allocate(bytes, alignment);
+}
+
+void memory_resource::deallocate(void *p, size_t bytes, size_t alignment)
+{
+    do_deallocate(p, bytes, alignment);
+}
+
+bool memory_resource::is_equal(const memory_resource &other) const noexcept
+{
+    return do_is_equal(other);
+}
+
+bool NAMESPACE::operator==(const memory_resource &a, const memory_resource &b) noexcept
+{
+    return &a == &b || a.is_equal(b);
+}
+
+bool NAMESPACE::operator!=(const memory_resource &a, const memory_resource &b) noexcept
+{
+    return !(a == b);
+}
+
+memory_resource *NAMESPACE::new_delete_resource() noexcept
+{
+    static new_delete_memory_resource r;
+    return &r;
+}
+
+monotonic_buffer_resource::monotonic_buffer_resource(
+                size_t          initial_size,
+                memory_resource *upstream) :
+                        m_upstream(upstream ? upstream : new_delete_resource()),
+                        m_blocks(nullptr),
+                        m_current(nullptr),
+                        m_remaining(0),
+                        m_next_block_size(initial_size > 0 ? initial_size : default_block_size),
+                        m_bytes_allocated(0)
+{
+}
+
+monotonic_buffer_resource::~monotonic_buffer_resource()
+{
+    release();
+}
+
+void monotonic_buffer_resource::release() noexcept
+{
+    while (m_blocks)
+    {
+        block *next = m_blocks->m_next;
+        m_upstream->deallocate(m_blocks, m_blocks->m_size);
+        m_blocks = next;
+    }
+
+    m_current = nullptr;
+    m_remaining = 0;
+    m_bytes_allocated = 0;
+}
+
+size_t monotonic_buffer_resource::get_bytes_allocated() const noexcept
+{
+    return m_bytes_allocated;
+}
+
+void *monotonic_buffer_resource::do_allocate(size_t bytes, size_t alignment)
+{
+    size_t padding = m_current ? align_up(reinterpret_cast<size_t>(m_current), alignment) - reinterpret_cast<size_t>(m_current) : 0;
+
+    if (m_current == nullptr || padding + bytes > m_remaining)
+    {
+        size_t header = align_up(sizeof(block), max_alignment);
+        size_t needed = header + bytes + alignment;
+
+        while (m_next_block_size < needed)
+        {
+            m_next_block_size *= 2;
+        }
+
+        block *b = static_cast<block *>(m_upstream->allocate(m_next_block_size));
+        b->m_next = m_blocks;
+        b->m_size = m_next_block_size;
+        m_blocks = b;
+
+        m_current = reinterpret_cast<char *>(b) + header;
+        m_remaining = m_next_block_size - header;
+        m_next_block_size *= 2;
+
+        padding = align_up(reinterpret_cast<size_t>(m_current), alignment) - reinterpret_cast<size_t>(m_current);
+    }
+
+    void *res = m_current + padding;
+    m_current += padding + bytes;
+    m_remaining -= padding + bytes;
+    m_bytes_allocated += bytes;
+
+    return res;
+}
+
+void monotonic_buffer_resource::do_deallocate(void *p, size_t bytes, size_t alignment)
+{
+    // memory is only given back by release()
+}
+
+bool monotonic_buffer_resource::do_is_equal(const memory_resource &other) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,242 @@
+#ifndef _json_memory_resource_hpp_
+#define _json_memory_resource_hpp_
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file memory_resource.hpp The memory_resource and polymorphic_allocator classes.
+
+#include <cstddef>
+#include <type_traits>
+
+#include "common.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * \brief Abstract source of memory for json containers.
+     *
+     * This mirrors the C++17 std::pmr::memory_resource interface so that code
+     * built with C++11 can still keep the storage of a json DOM inside a
+     * caller supplied pool. Derive from this class and implement the three
+     * do_ methods to provide a custom resource.
+     */
+    class memory_resource
+    {
+    public:
+
+        /// The strictest alignment any fundamental type needs.
+        static const size_t max_alignment = alignof(std::max_align_t);
+
+        virtual ~memory_resource() {}
+
+        /// Allocate at least bytes bytes aligned to alignment.
+        void *allocate(size_t bytes, size_t alignment = max_alignment);
+
+        /// Give back memory previously obtained from allocate().
+        void deallocate(void *p, size_t bytes, size_t alignment = max_alignment);
+
+        /// True if memory allocated by this resource can be freed by other and vice-versa.
+        bool is_equal(const memory_resource &other) const noexcept;
+
+    protected:
+
+        /// Implemented by derived classes to do the actual allocation.
+        virtual void *do_allocate(size_t bytes, size_t alignment) = 0;
+
+        /// Implemented by derived classes to do the actual deallocation.
+        virtual void do_deallocate(void *p, size_t bytes, size_t alignment) = 0;
+
+        /// Implemented by derived classes to compare resources.
+        virtual bool do_is_equal(const memory_resource &other) const noexcept = 0;
+    };
+
+    /// Resources are equal if they are the same object or if is_equal() says so.
+    bool operator==(const memory_resource &a, const memory_resource &b) noexcept;
+
+    /// Resources are equal if they are the same object or if is_equal() says so.
+    bool operator!=(const memory_resource &a, const memory_resource &b) noexcept;
+
+    /**
+     * The resource used when nothing else has been specified. It simply calls
+     * the global operator new and operator delete. There is deliberately no
+     * way to change the default so as to keep to the thread safety model
+     * described in the main documentation.
+     */
+    memory_resource *new_delete_resource() noexcept;
+
+    /**
+     * \brief A resource that never frees anything until it is destroyed.
+     *
+     * Memory is carved sequentially out of blocks obtained from an upstream
+     * resource. deallocate() is a no-op; everything is given back in one go
+     * by release() or the destructor. This is the typical per-request pool:
+     * parse into it, use the DOM, throw the lot away. Not thread safe.
+     */
+    class monotonic_buffer_resource : public memory_resource
+    {
+    public:
+
+        /// The size of the first block requested from upstream.
+        static const size_t default_block_size = 4096;
+
+        /**
+         * Constructor.
+         * \param initial_size  Size of the first block. Later blocks double in size.
+         * \param upstream      Where to get blocks from. nullptr means new_delete_resource().
+         */
+        monotonic_buffer_resource(
+                size_t          initial_size = default_block_size,
+                memory_resource *upstream = nullptr);
+
+        /// Destructor - frees all blocks.
+        virtual ~monotonic_buffer_resource();
+
+        /// Free all blocks back to the upstream resource.
+        void release() noexcept;
+
+        /// Total number of bytes handed out since construction or the last release().
+        size_t get_bytes_allocated() const noexcept;
+
+    protected:
+
+        virtual void *do_allocate(size_t bytes, size_t alignment);
+        virtual void do_deallocate(void *p, size_t bytes, size_t alignment);
+        virtual bool do_is_equal(const memory_resource &other) const noexcept;
+
+    private:
+
+        monotonic_buffer_resource(const monotonic_buffer_resource &other) = delete;
+        monotonic_buffer_resource &operator=(const monotonic_buffer_resource &other) = delete;
+
+        /// Header at the start of every block obtained from upstream.
+        struct block
+        {
+            block  *m_next;
+            size_t m_size;
+        };
+
+        /// Where blocks come from.
+        memory_resource *m_upstream;
+
+        /// Most recently allocated block (the one currently being carved up).
+        block *m_blocks;
+
+        /// Next free byte in the current block.
+        char *m_current;
+
+        /// Bytes remaining in the current block.
+        size_t m_remaining;
+
+        /// Size to use for the next block requested.
+        size_t m_next_block_size;
+
+        /// Running total of bytes handed out.
+        size_t m_bytes_allocated;
+    };
+
+    /**
+     * \brief A C++11 allocator that forwards to a memory_resource.
+     *
+     * The equivalent of std::pmr::polymorphic_allocator. As with the standard
+     * version, the resource is not propagated on container copy, copy assignment,
+     * move assignment or swap and a copy constructed container gets the default
+     * resource.
+     */
+    template <typename T>
+    class polymorphic_allocator
+    {
+    public:
+
+        /// What this allocates.
+        typedef T value_type;
+
+        /// See the class description.
+        typedef std::false_type propagate_on_container_copy_assignment;
+
+        /// See the class description.
+        typedef std::false_type propagate_on_container_move_assignment;
+
+        /// See the class description.
+        typedef std::false_type propagate_on_container_swap;
+
+        /// Allocator using new_delete_resource().
+        polymorphic_allocator() noexcept : m_resource(new_delete_resource())
+        {
+        }
+
+        /// Allocator using the given resource. nullptr means new_delete_resource().
+        polymorphic_allocator(memory_resource *r) noexcept : m_resource(r ? r : new_delete_resource())
+        {
+        }
+
+        /// Rebinding constructor.
+        template <typename U>
+        polymorphic_allocator(const polymorphic_allocator<U> &other) noexcept : m_resource(other.resource())
+        {
+        }
+
+        /// Allocate space for n instances of T.
+        T *allocate(size_t n)
+        {
+            return static_cast<T *>(m_resource->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        /// Free space for n instances of T.
+        void deallocate(T *p, size_t n)
+        {
+            m_resource->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        /// Containers that are copy constructed get the default resource.
+        polymorphic_allocator select_on_container_copy_construction() const
+        {
+            return polymorphic_allocator();
+        }
+
+        /// Get the underlying resource.
+        memory_resource *resource() const noexcept
+        {
+            return m_resource;
+        }
+
+    private:
+
+        memory_resource *m_resource;
+    };
+
+    /// Allocators are equal if their resources are.
+    template <typename T, typename U>
+    bool operator==(const polymorphic_allocator<T> &a, const polymorphic_allocator<U> &b) noexcept
+    {
+        return *a.resource() == *b.resource();
+    }
+
+    /// Allocators are equal if their resources are.
+    template <typename T, typename U>
+    bool operator!=(const polymorphic_allocator<T> &a, const polymorphic_allocator<U> &b) noexcept
+    {
+        return !(a == b);
+    }
+}
+
+#endif
@@ -23,6 +23,13 @@
 /// \file parser.cpp The parser class implementation.
 
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <thread>
 
 #include <sstream>
 #include <fstream>
@@ -36,6 +43,7 @@
 #include "file_reader.hpp"
 #include "json_utf8_exception.hpp"
 #include "json_io_exception.hpp"
+#include "memory_reader.hpp"
 
 #ifndef _ARGO_WINDOWS_
 #include "fd_reader.hpp"
@@ -50,26 +58,56 @@ parser::parser(
             size_t p_max_nesting_depth,
             bool   p_convert_numbers, 
             bool   p_fallback_to_double, 
-            bool   p_convert_strings) :
+            bool   p_convert_strings,
+            memory_resource *p_resource,
+            bool   p_pack_numeric_arrays,
+            bool   p_shape_objects) :
                         m_reader(r),
                         m_read_all(read_all),
                         m_max_token_length(p_max_token_length),
                         m_max_nesting_depth(p_max_nesting_depth),
                         m_convert_numbers(p_convert_numbers),
                         m_fallback_to_double(p_fallback_to_double), 
-                        m_convert_strings(p_convert_strings)
+                        m_convert_strings(p_convert_strings),
+                        m_resource(p_resource),
+                        m_pack_numeric_arrays(p_pack_numeric_arrays),
+                        m_shape_objects(p_shape_objects),
+                        m_recycler(p_resource),
+                        m_lexer(r, p_max_token_length)
 {
 }
 
 json parser::parse_number_int(const token &t)
 {
-    std::istringstream is(t.get_raw_value());
+    // The lexer has already checked the syntax so this is just an optional
+    // minus sign followed by digits.
+    const std::string &s = t.get_raw_value();
+    bool negative = s[0] == '-';
+    uint64_t u = 0;
+    bool in_range = true;
 
-    int i;
+    for (size_t i = negative ? 1 : 0; i < s.size(); i++)
+    {
+        unsigned int d = s[i] - '0';
+        if (u > (UINT64_MAX - d) / 10)
+        {
+            in_range = false;
+            break;
+        }
+        u = u * 10 + d;
+    }
 
-    if (is >> i)
+    if (in_range && !negative)
+    {
+        return json(u);
+    }
+    else if (in_range && u <= static_cast<uint64_t>(INT64_MAX))
     {
-        return json(i);
+        return json(-static_cast<int64_t>(u));
+    }
+    else if (in_range && u == static_cast<uint64_t>(INT64_MAX) + 1)
+    {
+        return json(static_cast<int64_t>(INT64_MIN));
     }
     else
     {
@@ -88,12 +126,98 @@ json parser::parse_number_int(const token &t)
     }
 }
 
+// Clinger's fast path: a decimal with at most 53 bits of mantissa and a power
+// of ten that is itself exactly representable converts with one correctly
+// rounded multiply or divide. Anything else goes to the stream.
+static bool parser_fast_double(const std::string &s, double &d)
+{
+    static const double powers[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const uint64_t max_mantissa = uint64_t(1) << 53;
+
+    size_t i = 0;
+    bool negative = s[0] == '-';
+    uint64_t m = 0;
+    int exponent = 0;
+
+    if (negative)
+    {
+        i++;
+    }
+
+    for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++)
+    {
+        m = m * 10 + (s[i] - '0');
+        if (m > max_mantissa)
+        {
+            return false;
+        }
+    }
+
+    if (i < s.size() && s[i] == '.')
+    {
+        for (i++; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++)
+        {
+            m = m * 10 + (s[i] - '0');
+            exponent--;
+            if (m > max_mantissa)
+            {
+                return false;
+            }
+        }
+    }
+
+    if (i < s.size() && (s[i] == 'e' || s[i] == 'E'))
+    {
+        bool negative_exponent = false;
+        int e = 0;
+
+        i++;
+        if (s[i] == '+' || s[i] == '-')
+        {
+            negative_exponent = s[i++] == '-';
+        }
+
+        for (; i < s.size(); i++)
+        {
+            e = e * 10 + (s[i] - '0');
+            if (e > 100)
+            {
+                return false;
+            }
+        }
+
+        exponent += negative_exponent ? -e : e;
+    }
+
+    if (exponent < -22 || exponent > 22)
+    {
+        return false;
+    }
+
+    d = static_cast<double>(m);
+    d = exponent < 0 ? d / powers[-exponent] : d * powers[exponent];
+    d = negative ? -d : d;
+
+    return true;
+}
+
 json parser::parse_number_double(const token &t)
 {
-    std::istringstream is(t.get_raw_value());
     double d;
 
-    if (is >> d && isfinite(d))
+    if (parser_fast_double(t.get_raw_value(), d))
+    {
+        return json(d);
+    }
+
+    m_double_stream.clear();
+    m_double_stream.str(t.get_raw_value());
+
+    if (m_double_stream >> d && isfinite(d))
     {
         return json(d);
     }
@@ -138,15 +262,17 @@ json parser::parse_value(lexer &l, size_t nesting_depth)
     case token::string_e:
         if (m_convert_strings)
         {
+            std::string s = m_recycler.take_string();
             try
             {
-                return json(utf8::json_string_to_utf8(t.get_raw_value()));
+                decode_string(t.get_raw_value(), s);
             }
             catch (json_utf8_exception &e)
             {
                 e.add_byte_index(m_reader.get_byte_index());
                 throw e;
             }
+            return json(std::move(s));
         }
         else
         {
@@ -176,60 +302,155 @@ json parser::parse_array(lexer &l, size_t nesting_depth)
                             m_reader.get_byte_index());
     }
 
-    json array(json::array_e);
-    json::json_array& a = array.get_array();
+    // Elements are collected on the scratch stack (shared by all nesting levels)
+    // and then moved into an array allocated at exactly the right size. That
+    // makes it one allocation per non-empty array rather than one per doubling
+    // of the vector capacity, which matters for the very common short arrays.
+    size_t base = m_scratch.size();
 
     const token &t1 = l.next();
 
-    if (t1.get_type() == token::end_array_e)
+    if (t1.get_type() != token::end_array_e)
+    {
+        l.put_back_last();
+        m_scratch.push_back(parse_value(l, nesting_depth));
+
+        while (true)
+        {
+            const token &t2 = l.next();
+
+            if (t2.get_type() == token::value_separator_e)
+            {
+                m_scratch.push_back(parse_value(l, nesting_depth));
+            }
+            else if (t2.get_type() == token::end_array_e)
+            {
+                break;
+            }
+            else
+            {
+                throw json_parser_exception(
+                                json_parser_exception::unexpected_token_e,
+                                t2.get_raw_value(),
+                                m_reader.get_byte_index());
+            }
+        }
+    }
+
+    return make_array(base);
+}
+
+json parser::make_array(size_t base)
+{
+    json array;
+
+    if (m_pack_numeric_arrays && pack_array(base, array))
     {
+        m_scratch.erase(m_scratch.begin() + base, m_scratch.end());
         return array;
     }
-    else
+
+    json::json_array a = m_recycler.take_array();
+
+    a.reserve(m_scratch.size() - base);
+    for (size_t i = base; i < m_scratch.size(); i++)
     {
-        l.put_back_last();
-        a.push_back(parse_value(l, nesting_depth));
+        a.push_back(std::move(m_scratch[i]));
     }
+    m_scratch.erase(m_scratch.begin() + base, m_scratch.end());
 
-    while (true)
+    return m_recycler.make_array(std::move(a));
+}
+
+bool parser::pack_array(size_t base, json &array)
+{
+    if (base == m_scratch.size())
     {
-        const token &t2 = l.next();
+        return false;
+    }
 
-        if (t2.get_type() == token::value_separator_e)
+    // Raw numbers are left alone so that their text isn't lost and ints too
+    // big for an int64_t don't fit in the packed form.
+    json::type t = m_scratch[base].get_instance_type();
+
+    if (t != json::number_int_e && t != json::number_double_e)
+    {
+        return false;
+    }
+
+    for (size_t i = base; i < m_scratch.size(); i++)
+    {
+        if (m_scratch[i].get_instance_type() != t ||
+            m_scratch[i].get_raw_value().size() > 0 ||
+            m_scratch[i].is_uint64())
         {
-            a.push_back(parse_value(l, nesting_depth));
+            return false;
         }
-        else if (t2.get_type() == token::end_array_e)
+    }
+
+    if (t == json::number_int_e)
+    {
+        m_int_scratch.clear();
+        for (size_t i = base; i < m_scratch.size(); i++)
         {
-            return array;
+            m_int_scratch.push_back(static_cast<int64_t>(m_scratch[i]));
         }
-        else
+        array = m_recycler.make_numbers(m_int_scratch.data(), m_int_scratch.size());
+    }
+    else
+    {
+        m_double_scratch.clear();
+        for (size_t i = base; i < m_scratch.size(); i++)
         {
-            throw json_parser_exception(
-                            json_parser_exception::unexpected_token_e,
-                            t2.get_raw_value(),
-                            m_reader.get_byte_index());
+            m_double_scratch.push_back(static_cast<double>(m_scratch[i]));
         }
+        array = m_recycler.make_numbers(m_double_scratch.data(), m_double_scratch.size());
     }
-    
-    return array;
+
+    return true;
 }
 
-void parser::parse_name_value_pair(lexer &l, json::json_object &object, size_t nesting_depth)
+bool parser::parse_name_value_pair(lexer &l, size_t nesting_depth, size_t position)
 {
     const token &t1 = l.next();
 
-    std::string name;
+    bool matched = false;
 
     if (t1.get_type() == token::string_e)
     {
-        if (m_convert_strings)
+        const std::string &raw = t1.get_raw_value();
+        prediction &p = m_predictions[nesting_depth];
+
+        m_statistics.m_names++;
+
+        if (position < p.m_raw_names.size() &&
+            p.m_raw_names[position].size() == raw.size() &&
+            memcmp(p.m_raw_names[position].data(), raw.data(), raw.size()) == 0)
         {
-            name = *utf8::json_string_to_utf8(t1.get_raw_value());
+            matched = true;
+            m_statistics.m_name_hits++;
         }
         else
         {
-            name = t1.get_raw_value();
+            // The names of the object being parsed are kept in the prediction
+            // as it goes along. Any shape no longer goes with them.
+            if (position == p.m_raw_names.size())
+            {
+                p.m_raw_names.emplace_back();
+                p.m_names.emplace_back();
+            }
+
+            p.m_raw_names[position] = raw;
+            p.m_shape = nullptr;
+
+            if (m_convert_strings)
+            {
+                decode_string(raw, p.m_names[position]);
+            }
+            else
+            {
+                p.m_names[position] = raw;
+            }
         }
     }
     else
@@ -250,7 +471,9 @@ void parser::parse_name_value_pair(lexer &l, json::json_object &object, size_t n
                             m_reader.get_byte_index());
     }
 
-    object[name] = parse_value(l, nesting_depth);
+    m_scratch.push_back(parse_value(l, nesting_depth));
+
+    return matched;
 }
 
 json parser::parse_object(lexer &l, size_t nesting_depth)
@@ -263,15 +486,24 @@ json parser::parse_object(lexer &l, size_t nesting_depth)
                             m_reader.get_byte_index());
     }
 
-    json object(json::object_e);
-    json::json_object& o = object.get_object();
+    // Members are collected on the scratch stacks, as for arrays, and then
+    // moved into the result so that the parser never takes a non-const
+    // reference into a json instance's storage (which would stop it being
+    // shared by copies).
+    size_t base = m_scratch.size();
+    bool all_names_matched = true;
+
+    if (m_predictions.size() <= nesting_depth)
+    {
+        m_predictions.resize(nesting_depth + 1);
+    }
 
     const token &t1 = l.next();
 
     // check for empty object
     if (t1.get_type() == token::end_object_e)
     {
-        return object;
+        return make_object(base, nesting_depth, all_names_matched);
     }
     else
     {
@@ -280,13 +512,16 @@ json parser::parse_object(lexer &l, size_t nesting_depth)
 
     while (true)
     {
-        parse_name_value_pair(l, o, nesting_depth);
+        if (!parse_name_value_pair(l, nesting_depth, m_scratch.size() - base))
+        {
+            all_names_matched = false;
+        }
 
         const token &t2 = l.next();
 
         if (t2.get_type() == token::end_object_e)
         {
-            return object;
+            return make_object(base, nesting_depth, all_names_matched);
         }
         else if (t2.get_type() == token::value_separator_e)
         {
@@ -300,32 +535,266 @@ json parser::parse_object(lexer &l, size_t nesting_depth)
                         m_reader.get_byte_index());
         }
     }
+}
+
+json parser::make_object(size_t base, size_t nesting_depth, bool all_names_matched)
+{
+    size_t n = m_scratch.size() - base;
+    prediction &p = m_predictions[nesting_depth];
+
+    m_statistics.m_objects++;
+
+    // Every name matched the last object at this depth and there were no
+    // more of them than it had, so it has the same shape.
+    if (all_names_matched && n == p.m_raw_names.size() && p.m_shape)
+    {
+        json::json_array values = m_recycler.take_array();
+        values.reserve(p.m_order.size());
+        for (auto i : p.m_order)
+        {
+            values.push_back(std::move(m_scratch[base + i]));
+        }
+
+        m_scratch.erase(m_scratch.begin() + base, m_scratch.end());
+        m_statistics.m_shape_hits++;
+
+        return m_recycler.make_shaped(p.m_shape, std::move(values));
+    }
+
+    // The prediction holds the names of this object and only they are
+    // expected next time.
+    p.m_raw_names.resize(n);
+    p.m_names.resize(n);
+    p.m_shape = nullptr;
+
+    if (!m_shape_objects || n == 0)
+    {
+        json::json_object o{json::json_object::allocator_type(m_resource)};
+
+        // as in any map, the last of any duplicate names wins
+        for (size_t i = 0; i < n; i++)
+        {
+            o[p.m_names[i]] = std::move(m_scratch[base + i]);
+        }
+        m_scratch.erase(m_scratch.begin() + base, m_scratch.end());
+
+        return json::from_object(std::move(o));
+    }
 
-    return object;
+    // Shapes hold their names sorted, as a map would, with ties broken by
+    // position so that the last of any duplicate names can win.
+    const std::string *names = p.m_names.data();
+    std::vector<size_t> &order = p.m_order;
+
+    order.clear();
+    for (size_t i = 0; i < n; i++)
+    {
+        order.push_back(i);
+    }
+
+    std::sort(order.begin(), order.end(), [names](size_t a, size_t b)
+    {
+        int c = names[a].compare(names[b]);
+        return c < 0 || (c == 0 && a < b);
+    });
+
+    // drop all but the last of any duplicates
+    size_t kept = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        if (k + 1 == n || names[order[k + 1]] != names[order[k]])
+        {
+            order[kept++] = order[k];
+        }
+    }
+    order.resize(kept);
+
+    json::json_array values = m_recycler.take_array();
+    values.reserve(kept);
+    m_shape_names.resize(kept);
+
+    for (size_t k = 0; k < kept; k++)
+    {
+        m_shape_names[k] = names[order[k]];
+        values.push_back(std::move(m_scratch[base + order[k]]));
+    }
+
+    m_scratch.erase(m_scratch.begin() + base, m_scratch.end());
+
+    p.m_shape = m_shapes.get(m_shape_names);
+
+    return m_recycler.make_shaped(p.m_shape, std::move(values));
+}
+
+double parser::statistics::name_hit_rate() const noexcept
+{
+    return m_names == 0 ? 0 : static_cast<double>(m_name_hits) / m_names;
+}
+
+const parser::statistics &parser::get_statistics() const noexcept
+{
+    return m_statistics;
+}
+
+void parser::reset_statistics() noexcept
+{
+    m_statistics = statistics();
+}
+
+void parser::decode_string(const std::string &raw, std::string &s)
+{
+    // without any escapes the UTF-8 string is the raw string
+    if (raw.find('\\') == std::string::npos)
+    {
+        s.assign(raw);
+    }
+    else
+    {
+        s = std::move(*utf8::json_string_to_utf8(raw));
+    }
 }
 
 std::unique_ptr<json> parser::parse()
 {
-    m_reader.reset_byte_index();
+    return std::unique_ptr<json>(new json(parse_message()));
+}
+
+std::unique_ptr<json> parser::try_parse(error &e)
+{
+    // The exceptions stop here. Messages that fail to parse are rare next
+    // to the lookups that the non-throwing json methods are for, so the
+    // parser itself keeps to exceptions.
+    try
+    {
+        return parse();
+    }
+    catch (json_parser_exception &x)
+    {
+        e.m_type = x.get_type();
+        e.m_byte_index = x.get_byte_index();
+    }
+    catch (json_exception &x)
+    {
+        e.m_type = x.get_type();
+        e.m_byte_index = m_reader.get_byte_index();
+    }
+    return nullptr;
+}
+
+void parser::parse_into(json &target)
+{
+    m_recycler.recycle(std::move(target));
+    target = parse_message();
+}
 
-    lexer l(m_reader, m_max_token_length);
+json parser::parse_message()
+{
+    m_reader.reset_byte_index();
+    m_scratch.clear();
+    m_lexer.reset();
 
-    auto res = parse_value(l, 0);
+    auto res = parse_value(m_lexer, 0);
 
     if (m_read_all)
     {
-        // check that there isn't anything other than whitespace left
-        int c;
+        read_to_end();
+    }
+    return res;
+}
 
-        while ((c = m_reader.next()) != EOF)
+void parser::read_to_end()
+{
+    // check that there isn't anything other than whitespace left
+    int c;
+
+    while ((c = m_reader.next()) != EOF)
+    {
+        if ((c != 0x20) && (c != 0x09) && (c != 0x0A) && (c != 0x0D))
         {
-            if ((c != 0x20) && (c != 0x09) && (c != 0x0A) && (c != 0x0D))
+            throw json_parser_exception(json_parser_exception::invalid_character_e, m_reader.get_byte_index());
+        }
+    }
+}
+
+void parser::parse_slice(bool first, bool last, size_t end)
+{
+    // The same steps as parse_message() and parse_array() would take over
+    // these bytes, so the same errors are found at the same byte indexes.
+    m_scratch.clear();
+    m_lexer.reset();
+
+    if (first)
+    {
+        const token &t = m_lexer.next();
+
+        if (t.get_type() != token::begin_array_e)
+        {
+            throw json_parser_exception(
+                            json_parser_exception::unexpected_token_e,
+                            t.get_raw_value(),
+                            m_reader.get_byte_index());
+        }
+    }
+
+    while (true)
+    {
+        m_scratch.push_back(parse_value(m_lexer, 1));
+
+        const token &t = m_lexer.next();
+
+        if (t.get_type() == token::value_separator_e)
+        {
+            if (!last && m_reader.get_byte_index() == end)
             {
-                throw json_parser_exception(json_parser_exception::invalid_character_e, m_reader.get_byte_index());
+                return;
             }
         }
+        else if (t.get_type() == token::end_array_e && last)
+        {
+            read_to_end();
+            return;
+        }
+        else
+        {
+            throw json_parser_exception(
+                            json_parser_exception::unexpected_token_e,
+                            t.get_raw_value(),
+                            m_reader.get_byte_index());
+        }
+    }
+}
+
+json parser::splice(std::vector<std::vector<json>> &slices)
+{
+    // Only numbers can be packed, so arrays of anything else are moved
+    // straight into place rather than through the scratch stack.
+    json::type t = slices[0][0].get_instance_type();
+
+    if (m_pack_numeric_arrays && (t == json::number_int_e || t == json::number_double_e))
+    {
+        m_scratch.clear();
+        for (auto &s : slices)
+        {
+            std::move(s.begin(), s.end(), std::back_inserter(m_scratch));
+        }
+        return make_array(0);
+    }
+
+    size_t n = 0;
+    for (const auto &s : slices)
+    {
+        n += s.size();
+    }
+
+    json::json_array a = m_recycler.take_array();
+
+    a.reserve(n);
+    for (auto &s : slices)
+    {
+        std::move(s.begin(), s.end(), std::back_inserter(a));
     }
-    return std::unique_ptr<json>(new json(std::move(res)));
+
+    return m_recycler.make_array(std::move(a));
 }
 
 std::unique_ptr<json> parser::parse(std::istream &i)
@@ -363,6 +832,14 @@ std::unique_ptr<json> parser::parse(const std::string &s)
     return parse(i);
 }
 
+std::unique_ptr<json> parser::try_parse(const std::string &s, error &e)
+{
+    std::istringstream i(s);
+    stream_reader r(&i, max_message_length, true);
+    parser p(r);
+    return p.try_parse(e);
+}
+
 std::unique_ptr<json> parser::load(const std::string &file_name)
 {
     std::ifstream is(file_name);
@@ -377,6 +854,273 @@ std::unique_ptr<json> parser::load(const std::string &file_name)
     }
 }
 
+namespace
+{
+    /**
+     * What the structural scan found in one region of a message being parsed
+     * by parse_parallel(). Whether a byte is in a string depends on every
+     * quote before it, so the first pass works the region out both ways,
+     * [0] as if it starts outside a string and [1] as if it starts inside one.
+     */
+    struct parallel_region
+    {
+        size_t m_begin = 0;
+        size_t m_end = 0;
+
+        /// Whether the region has an odd number of unescaped quotes.
+        bool m_odd_quotes = false;
+
+        /// Net change in the nesting depth over the region.
+        long m_change[2] = {0, 0};
+
+        /// Lowest the nesting depth gets relative to the start of the region.
+        long m_lowest[2] = {0, 0};
+
+        /// Filled in from the regions before: whether the region starts in a string.
+        bool m_in_string = false;
+
+        /// Filled in from the regions before: nesting depth at the start.
+        long m_depth = 0;
+
+        /// Filled in from the regions before: whether the top level array is still open.
+        bool m_open = false;
+
+        /// The first comma between top level elements, SIZE_MAX if there isn't one.
+        size_t m_split = SIZE_MAX;
+    };
+}
+
+static bool parallel_escaped(const char *data, size_t i)
+{
+    // In a valid message backslashes only appear in strings, where a quote
+    // is escaped if there is an odd number of them before it.
+    size_t n = 0;
+
+    while (i > 0 && data[i - 1] == '\\')
+    {
+        i--;
+        n++;
+    }
+    return n % 2 == 1;
+}
+
+static void parallel_scan(const char *data, parallel_region &r)
+{
+    bool escaped = parallel_escaped(data, r.m_begin);
+    bool in = false;
+
+    for (size_t i = r.m_begin; i < r.m_end; i++)
+    {
+        char c = data[i];
+
+        if (escaped)
+        {
+            escaped = false;
+        }
+        else if (c == '\\')
+        {
+            escaped = true;
+        }
+        else if (c == '"')
+        {
+            in = !in;
+        }
+        else if (c == '[' || c == '{')
+        {
+            // in a string if the region started outside one, outside if
+            // it started in one
+            r.m_change[in]++;
+        }
+        else if (c == ']' || c == '}')
+        {
+            r.m_lowest[in] = std::min(r.m_lowest[in], --r.m_change[in]);
+        }
+    }
+
+    r.m_odd_quotes = in;
+}
+
+static void parallel_find_split(const char *data, parallel_region &r)
+{
+    bool escaped = parallel_escaped(data, r.m_begin);
+    bool in = r.m_in_string;
+    long depth = r.m_depth;
+
+    for (size_t i = r.m_begin; i < r.m_end; i++)
+    {
+        char c = data[i];
+
+        if (escaped)
+        {
+            escaped = false;
+        }
+        else if (c == '\\')
+        {
+            escaped = true;
+        }
+        else if (c == '"')
+        {
+            in = !in;
+        }
+        else if (!in)
+        {
+            if (c == ',' && depth == 1)
+            {
+                r.m_split = i;
+                return;
+            }
+            else if (c == '[' || c == '{')
+            {
+                depth++;
+            }
+            else if ((c == ']' || c == '}') && --depth == 0)
+            {
+                // the top level array has ended
+                return;
+            }
+        }
+    }
+}
+
+static void parallel_run(unsigned threads, size_t tasks, const std::function<void(size_t)> &task)
+{
+    // The threads take the tasks in order so a slow one doesn't hold the
+    // rest up.
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+
+    for (unsigned i = 0; i < threads && i < tasks; i++)
+    {
+        workers.emplace_back([&]()
+        {
+            size_t t;
+            while ((t = next++) < tasks)
+            {
+                task(t);
+            }
+        });
+    }
+
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+}
+
+std::unique_ptr<json> parser::parse_parallel(const char *data, size_t size, unsigned threads, size_t min_slice)
+{
+    memory_reader r(data, size, SIZE_MAX);
+    parser p(r);
+
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    size_t first = 0;
+    while (first < size && (data[first] == 0x20 || data[first] == 0x09 || data[first] == 0x0A || data[first] == 0x0D))
+    {
+        first++;
+    }
+
+    // A few regions per thread keeps them all busy to the end when some
+    // regions take longer than others.
+    size_t n = std::min(static_cast<size_t>(threads) * 4, size / std::max(min_slice, static_cast<size_t>(1)));
+
+    if (threads == 1 || n < 2 || first == size || data[first] != '[')
+    {
+        return p.parse();
+    }
+
+    std::vector<parallel_region> regions(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        regions[i].m_begin = first + 1 + (size - first - 1) * i / n;
+        regions[i].m_end = first + 1 + (size - first - 1) * (i + 1) / n;
+    }
+
+    parallel_run(threads, n, [&](size_t i) { parallel_scan(data, regions[i]); });
+
+    bool in = false;
+    long depth = 1;
+    bool open = true;
+    for (auto &g : regions)
+    {
+        g.m_in_string = in;
+        g.m_depth = depth;
+        g.m_open = open;
+        open = open && depth + g.m_lowest[in] > 0;
+        depth += g.m_change[in];
+        in = in != g.m_odd_quotes;
+    }
+
+    // The split in the first region would only make a slice of the first
+    // few bytes.
+    parallel_run(threads, n - 1, [&](size_t i)
+    {
+        if (regions[i + 1].m_open)
+        {
+            parallel_find_split(data, regions[i + 1]);
+        }
+    });
+
+    std::vector<size_t> starts(1, 0);
+    for (const auto &g : regions)
+    {
+        if (g.m_split != SIZE_MAX)
+        {
+            starts.push_back(g.m_split + 1);
+        }
+    }
+
+    if (starts.size() < 2)
+    {
+        return p.parse();
+    }
+    starts.push_back(size);
+
+    // Each slice is parsed exactly as the parser would parse those bytes
+    // having parsed all the slices before it, so the first slice that fails
+    // fails with the exception a single parser would throw. Slices after one
+    // that has failed are skipped.
+    size_t slices = starts.size() - 1;
+    std::vector<std::vector<json>> elements(slices);
+    std::vector<std::exception_ptr> errors(slices);
+    std::atomic<size_t> failed(slices);
+
+    parallel_run(threads, slices, [&](size_t i)
+    {
+        if (i > failed)
+        {
+            return;
+        }
+
+        try
+        {
+            memory_reader sr(data + starts[i], starts[i + 1] - starts[i], SIZE_MAX, true, starts[i]);
+            parser sp(sr);
+            sp.parse_slice(i == 0, i == slices - 1, starts[i + 1]);
+            elements[i].swap(sp.m_scratch);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+
+            size_t f = failed;
+            while (i < f && !failed.compare_exchange_weak(f, i))
+            {
+            }
+        }
+    });
+
+    if (failed < slices)
+    {
+        std::rethrow_exception(errors[failed]);
+    }
+
+    return std::unique_ptr<json>(new json(p.splice(elements)));
+}
+
 std::istream &NAMESPACE::operator>>(std::istream &stream, json &j)
 {
     j = std::move(*parser::parse(stream));
@@ -26,9 +26,11 @@
 /// \file parser.hpp The parser class.
 
 #include <istream>
+#include <sstream>
 
 #include "common.hpp"
 #include "json.hpp"
+#include "json_exception.hpp"
 #include "reader.hpp"
 #include "lexer.hpp"
 
@@ -71,6 +73,9 @@ namespace NAMESPACE
          */
         static const size_t max_nesting_depth = 1000;
 
+        /// The default smallest piece of a message that parse_parallel() gives a thread.
+        static const size_t min_parallel_slice = 1024*1024;
+
         /**
          * Convenience method. Parse a JSON message read from an istream. If you
          * need more detailed control of the options, create a reader and parser object
@@ -139,6 +144,49 @@ namespace NAMESPACE
          */
         static std::unique_ptr<json> load(const std::string &file_name);
 
+        /// Why try_parse() failed.
+        struct error
+        {
+            /// The type of the exception that parse() would have thrown.
+            json_exception::exception_type m_type = json_exception::invalid_json_type_e;
+
+            /// The (approximate) byte index in the message where it went wrong.
+            size_t m_byte_index = 0;
+        };
+
+        /**
+         * As parse(const std::string &) but reporting a failure in e rather
+         * than by throwing, for callers that expect to see bad messages and
+         * only need to know why and where.
+         * \return The message or nullptr if it couldn't be parsed.
+         */
+        static std::unique_ptr<json> try_parse(const std::string &s, error &e);
+
+        /**
+         * Parse a big message already in memory (e.g. a memory mapped file) whose
+         * top level is an array using several threads. A quick scan of the bytes
+         * finds the commas between the elements of the top level array, the
+         * threads parse the elements between them a slice at a time and the
+         * slices are joined in order. The result is the same as that of a parser
+         * with the default options, as is any exception thrown, its byte index
+         * being from the start of the message. Messages that aren't arrays or are
+         * too small to split are parsed by the calling thread.
+         *
+         * \param data                  The message. There is no maximum length.
+         * \param size                  Number of bytes in the message.
+         * \param threads               Number of threads to use, 0 for one per core.
+         * \param min_slice             Smallest slice of the message worth a thread.
+         * \throw json_parser_exception Thrown when there is something syntactically
+         *                              wrong with the message.
+         * \throw json_utf_exception    Thrown when an invalid string is found in the
+         *                              message.
+         */
+        static std::unique_ptr<json> parse_parallel(
+                                        const char *data,
+                                        size_t     size,
+                                        unsigned   threads = 0,
+                                        size_t     min_slice = min_parallel_slice);
+
         /**
          * Constructor. Create a parser that will read from the given reader.
          * If you need to read from some other type of source, then create an
@@ -164,13 +212,35 @@ namespace NAMESPACE
          *                              the caller to write custom code to handle numbers
          *                              outside of the normal int & double ranges.
          * \param p_fallback_to_double  If true, convert integers that are too large to be
-         *                              stored as an int into doubles instead.
+         *                              stored as an int64_t or uint64_t into doubles instead.
          * \param p_convert_strings     If true, convert strings into UTF-8 encoded
          *                              STL strings. If false, create the json instance
          *                              using the json(type, raw_string) method but
          *                              leave the caller to do any conversion. This is
          *                              useful when dealing with messages with broken
          *                              Unicode characters and the like in them.
+         * \param p_resource            Memory resource to allocate the objects and
+         *                              arrays of the parsed message from. nullptr
+         *                              means new_delete_resource(). The resource must
+         *                              outlive the parsed message.
+         * \param p_pack_numeric_arrays If true, arrays whose elements are all ints
+         *                              or all doubles are stored packed (see
+         *                              json::is_packed()). They behave exactly like
+         *                              any other array but take a fraction of the
+         *                              memory and support fast bulk operations.
+         *                              On by default, unlike p_shape_objects, since
+         *                              an array can be walked with size() and const
+         *                              operator[] without building anything whereas
+         *                              an object's members can only be iterated with
+         *                              get_object(). get_array() on a const packed
+         *                              array still builds a full view.
+         * \param p_shape_objects       If true, non-empty objects are stored shaped
+         *                              (see json::is_shaped()) with objects that
+         *                              have the same names sharing one shape. They
+         *                              behave exactly like any other object but
+         *                              arrays of records take much less memory.
+         *                              Off by default since get_object() on a
+         *                              const shaped object has to build a map.
          * \throw json_parser_exception Thrown when there is something syntactically
          *                              wrong with the message.
          * \throw json_io_exception     Thrown when something goes wrong with reading.
@@ -184,7 +254,10 @@ namespace NAMESPACE
             size_t p_max_nesting_depth = max_nesting_depth,
             bool   p_convert_numbers = true,
             bool   p_fallback_to_double = true,
-            bool   p_convert_strings = true);
+            bool   p_convert_strings = true,
+            memory_resource *p_resource = nullptr,
+            bool   p_pack_numeric_arrays = true,
+            bool   p_shape_objects = false);
 
         /**
          * Parse a single json object from the stream. The object
@@ -193,15 +266,92 @@ namespace NAMESPACE
          */
         std::unique_ptr<json> parse();
 
+        /**
+         * Parse a single json object from the stream into target, reusing the
+         * storage of whatever target held before (see json::recycler). When
+         * the messages parsed into the same target have the same structure,
+         * e.g. a stream of messages with the same fields, this allocates next
+         * to nothing once it has warmed up. target is left null if the parse
+         * fails.
+         */
+        void parse_into(json &target);
+
+        /**
+         * As parse() but reporting a failure in e rather than by throwing.
+         * \return The message or nullptr if it couldn't be parsed.
+         */
+        std::unique_ptr<json> try_parse(error &e);
+
+        /**
+         * \brief Counts of what the parser has done since it was created or
+         * reset_statistics() was called.
+         *
+         * The parser expects each object to have the same member names in the
+         * same order as the last object it parsed at the same nesting depth,
+         * as the records in an array of records or the lines of NDJSON do.
+         * Each name is compared byte for byte against the expected one before
+         * it is decoded and a name that matches isn't decoded again. When
+         * every name of an object matches, the object reuses the shape of the
+         * last one without its names being sorted or looked up.
+         */
+        struct statistics
+        {
+            /// Objects parsed.
+            size_t m_objects = 0;
+
+            /// Member names parsed.
+            size_t m_names = 0;
+
+            /// Member names that matched the expected name.
+            size_t m_name_hits = 0;
+
+            /// Objects whose names all matched so they reused the last shape.
+            size_t m_shape_hits = 0;
+
+            /// Fraction of the names that matched, 0 if there haven't been any.
+            double name_hit_rate() const noexcept;
+        };
+
+        /// What the parser has done so far.
+        const statistics &get_statistics() const noexcept;
+
+        /// Zero the statistics.
+        void reset_statistics() noexcept;
+
     private:
 
+        /// The names of the last object parsed at some nesting depth.
+        struct prediction
+        {
+            /// The names as they appeared in the message.
+            std::vector<std::string> m_raw_names;
+
+            /// The names as they were decoded. While an object is being parsed
+            /// these are its names up to the member being parsed.
+            std::vector<std::string> m_names;
+
+            /// The object's shape, nullptr if it wasn't shaped.
+            std::shared_ptr<const object_shape> m_shape;
+
+            /// The positions of the members in shape order, less any duplicates.
+            std::vector<size_t> m_order;
+        };
+
         json parse_number_int(const token &t);
         json parse_number_double(const token &t);
         json parse_string(const token &t);
         json parse_value(lexer &l, size_t nesting_depth);
         json parse_array(lexer &l, size_t nesting_depth);
-        void parse_name_value_pair(lexer &l, json::json_object &object, size_t nesting_depth);
+        json make_array(size_t base);
+        bool pack_array(size_t base, json &array);
+        bool parse_name_value_pair(lexer &l, size_t nesting_depth, size_t position);
         json parse_object(lexer &l, size_t nesting_depth);
+        json make_object(size_t base, size_t nesting_depth, bool all_names_matched);
+        void decode_string(const std::string &raw, std::string &s);
+        json parse_message();
+        void read_to_end();
+        void parse_slice(bool first, bool last, size_t end);
+        json splice(std::vector<std::vector<json>> &slices);
 
         /// Reader to get characters from.
         reader &m_reader;
@@ -227,6 +377,45 @@ namespace NAMESPACE
         /// Whether to convert string to UTF-8 strings or leave them in their raw form.
         bool m_convert_strings;
 
+        /// Where to allocate objects and arrays from.
+        memory_resource *m_resource;
+
+        /// Stack of array elements parsed but not yet moved into their array.
+        std::vector<json> m_scratch;
+
+        /// Whether to store all int or all double arrays packed.
+        bool m_pack_numeric_arrays;
+
+        /// Reused when building packed int arrays.
+        std::vector<int64_t> m_int_scratch;
+
+        /// Reused when building packed double arrays.
+        std::vector<double> m_double_scratch;
+
+        /// Whether to store objects shaped.
+        bool m_shape_objects;
+
+        /// Reused for the sorted names of an object.
+        std::vector<std::string> m_shape_names;
+
+        /// Shapes of the objects parsed so far.
+        shape_table m_shapes;
+
+        /// The expected names of the next object, indexed by nesting depth.
+        std::vector<prediction> m_predictions;
+
+        /// See get_statistics().
+        statistics m_statistics;
+
+        /// Storage from the last parse_into() target to build the next message from.
+        json::recycler m_recycler;
+
+        /// Kept from message to message so that its buffers are reused.
+        lexer m_lexer;
+
+        /// Reused to convert doubles.
+        std::istringstream m_double_stream;
+
     };
 }
 
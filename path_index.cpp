@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file path_index.cpp The path_index class implementation.
+
+#include "common.hpp"
+#include "json_exception.hpp"
+#include "path_index.hpp"
+
+using namespace NAMESPACE;
+
+// The hash of a path is built a token at a time from the hash of its
+// parent and the hash of the token.
+
+static const uint64_t path_root_hash = 14695981039346656037ULL;
+
+static uint64_t path_hash_combine(uint64_t h, uint64_t token_hash)
+{
+    h ^= token_hash + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+path_index::path_index(const json &root, size_t max_depth) : m_root(root), m_max_depth(max_depth), m_mask(0)
+{
+    rebuild();
+}
+
+const json &path_index::find(const pointer &p) const
+{
+    const json *res = try_find(p);
+
+    if (res == nullptr)
+    {
+        throw json_exception(json_exception::pointer_not_matched_e);
+    }
+
+    return *res;
+}
+
+const json *path_index::try_find(const pointer &p) const
+{
+    const auto &path = p.get_tokens();
+    uint64_t h = path_root_hash;
+    size_t depth = 0;
+    size_t i = 0;
+
+    // Hash as much of the path as the index covers, the rest is followed
+    // from the node found.
+    for (; i < path.size() && depth < m_max_depth; i++)
+    {
+        const pointer::token &t = path[i];
+
+        if (t.get_type() != pointer::token::all_e)
+        {
+            h = path_hash_combine(h, t.get_hash());
+            depth++;
+        }
+    }
+
+    for (size_t s = h & m_mask; m_slots[s].m_entry != 0; s = (s + 1) & m_mask)
+    {
+        size_t e = m_slots[s].m_entry - 1;
+
+        if (m_slots[s].m_hash == h && m_entries[e].m_depth == depth && matches(e, path, i))
+        {
+            const json *node = m_entries[e].m_node;
+            return i < path.size() ? node->try_find(p, i) : node;
+        }
+    }
+
+    // Everything down to the depth of the index is in it.
+    return nullptr;
+}
+
+void path_index::rebuild()
+{
+    m_entries.clear();
+    m_entries.push_back(entry{&m_root, 0, 0, path_root_hash, nullptr, 0});
+
+    // Breadth first, the entries added so far being the queue.
+    for (size_t e = 0; e < m_entries.size(); e++)
+    {
+        if (m_entries[e].m_depth >= m_max_depth)
+        {
+            continue;
+        }
+
+        const json &node = *m_entries[e].m_node;
+
+        if (node.get_instance_type() == json::array_e)
+        {
+            // by index so that a packed array needs no view of every element
+            size_t n = node.size();
+            for (size_t i = 0; i < n; i++)
+            {
+                add(e, node[i], nullptr, i);
+            }
+        }
+        else if (node.get_instance_type() == json::object_e && node.is_shaped())
+        {
+            // the object holds on to its shape and so the names
+            const std::vector<std::string> &names = node.get_shape()->get_names();
+            span<const json> values = node.get_shape_values();
+            for (size_t i = 0; i < names.size(); i++)
+            {
+                add(e, values[i], &names[i], 0);
+            }
+        }
+        else if (node.get_instance_type() == json::object_e)
+        {
+            for (const auto &m : node.get_object())
+            {
+                add(e, m.second, &m.first, 0);
+            }
+        }
+    }
+
+    size_t n = 16;
+    while (n < m_entries.size() * 2)
+    {
+        n *= 2;
+    }
+
+    m_slots.assign(n, slot{0, 0});
+    m_mask = n - 1;
+
+    for (size_t e = 0; e < m_entries.size(); e++)
+    {
+        size_t s = m_entries[e].m_hash & m_mask;
+        while (m_slots[s].m_entry != 0)
+        {
+            s = (s + 1) & m_mask;
+        }
+        m_slots[s] = slot{m_entries[e].m_hash, e + 1};
+    }
+}
+
+size_t path_index::size() const noexcept
+{
+    return m_entries.size();
+}
+
+void path_index::add(size_t parent, const json &node, const std::string *name, size_t index)
+{
+    uint64_t parent_hash = m_entries[parent].m_hash;
+    size_t depth = m_entries[parent].m_depth + 1;
+    uint64_t h = path_hash_combine(parent_hash, name ? pointer::token::hash(*name) : pointer::token::hash(index));
+
+    m_entries.push_back(entry{&node, parent, depth, h, name, index});
+}
+
+bool path_index::matches(size_t e, const std::vector<pointer::token> &path, size_t end) const
+{
+    // The depths are the same so this ends at the root.
+    for (size_t i = end; i-- > 0;)
+    {
+        const pointer::token &t = path[i];
+        const entry &x = m_entries[e];
+
+        if (t.get_type() == pointer::token::object_e)
+        {
+            if (x.m_name == nullptr || *x.m_name != t.get_name())
+            {
+                return false;
+            }
+        }
+        else if (t.get_type() == pointer::token::array_e)
+        {
+            if (x.m_name != nullptr || x.m_index != t.get_index())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            continue;
+        }
+
+        e = x.m_parent;
+    }
+
+    return true;
+}
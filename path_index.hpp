@@ -0,0 +1,131 @@
+#ifndef _json_path_index_hpp_
+#define _json_path_index_hpp_
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file path_index.hpp The path_index class.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "json.hpp"
+#include "pointer.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * \brief A hash table from paths to the nodes of a document.
+     *
+     * Built once by walking the whole document, or the part of it down to
+     * a given depth, after which finding the node at the end of a pointer
+     * costs a hash of its tokens and a check of the one node found rather
+     * than a member lookup at each level. Pointers that go deeper than the
+     * index continue from the deepest node it holds. The answers are the
+     * same as json::find() and json::try_find() give.
+     *
+     * This pays off for documents made of ordinary objects, where each level
+     * of a walk is a std::map lookup. The shaped objects a parsed document is
+     * made of are already found in about the time the hash takes, see
+     * pointer.
+     *
+     * The index holds pointers into the document and knows nothing of
+     * changes to it. After any non-const access to the document call
+     * rebuild() before using the index again. Any number of threads may call
+     * the const methods at once.
+     */
+    class path_index
+    {
+    public:
+
+        /// Used as max_depth to index every node.
+        static const size_t all_depths = static_cast<size_t>(-1);
+
+        /**
+         * Index the nodes of root.
+         * \param root        The document, which must outlive the index.
+         * \param max_depth   The depth of the deepest nodes indexed, root being 0.
+         */
+        path_index(const json &root, size_t max_depth = all_depths);
+
+        /**
+         * Find the node pointed at.
+         * \throw json_exception if the pointer didn't match.
+         */
+        const json &find(const pointer &p) const;
+
+        /// As find() but returning nullptr rather than throwing if the pointer doesn't match.
+        const json *try_find(const pointer &p) const;
+
+        /// Index the document again from scratch.
+        void rebuild();
+
+        /// The number of nodes indexed.
+        size_t size() const noexcept;
+
+    private:
+
+        /// A node of the document and the token that leads to it from its parent.
+        struct entry
+        {
+            const json          *m_node;
+            size_t              m_parent;
+            size_t              m_depth;
+            uint64_t            m_hash;
+
+            /// The member name, nullptr for an array element.
+            const std::string   *m_name;
+
+            /// The element index of an array element.
+            size_t              m_index;
+        };
+
+        /// A slot of the open addressing table, m_entry is 0 if it's free.
+        struct slot
+        {
+            uint64_t    m_hash;
+            size_t      m_entry;
+        };
+
+        /// Add a child of entry parent.
+        void add(size_t parent, const json &node, const std::string *name, size_t index);
+
+        /// True if the path of entry e is the tokens of path before end.
+        bool matches(size_t e, const std::vector<pointer::token> &path, size_t end) const;
+
+        const json &m_root;
+        size_t m_max_depth;
+
+        /// Parents come before their children.
+        std::vector<entry> m_entries;
+
+        /// Entries are stored plus one so that 0 marks a free slot.
+        std::vector<slot> m_slots;
+
+        /// m_slots.size() - 1, the table size is a power of two.
+        size_t m_mask;
+    };
+}
+
+#endif
@@ -22,7 +22,9 @@
 
 /// \file pointer.cpp The pointer class.
 
-#include <sstream>
+#include <cstdint>
+#include <ostream>
+#include <utility>
 
 #include "pointer.hpp"
 #include "utf8.hpp"
@@ -30,7 +32,7 @@
 
 using namespace NAMESPACE;
 
-pointer::pointer(const std::string &pointer)
+pointer::pointer(const std::string &pointer) : m_list(nullptr)
 {
     // is this a URI fragment type pointer?
     if (pointer[0] == '#')
@@ -43,6 +45,47 @@ pointer::pointer(const std::string &pointer)
     }
 }
 
+pointer::pointer(std::vector<token> path) : m_path(std::move(path)), m_list(nullptr)
+{
+    if (m_path.empty())
+    {
+        m_path.push_back(token());
+    }
+}
+
+pointer::pointer(const pointer &other) : m_path(other.m_path), m_list(nullptr)
+{
+}
+
+pointer::pointer(pointer &&other) noexcept : m_path(std::move(other.m_path)), m_list(other.m_list.exchange(nullptr))
+{
+}
+
+pointer &pointer::operator=(const pointer &other)
+{
+    if (this != &other)
+    {
+        m_path = other.m_path;
+        delete m_list.exchange(nullptr);
+    }
+    return *this;
+}
+
+pointer &pointer::operator=(pointer &&other) noexcept
+{
+    if (this != &other)
+    {
+        m_path = std::move(other.m_path);
+        delete m_list.exchange(other.m_list.exchange(nullptr));
+    }
+    return *this;
+}
+
+pointer::~pointer()
+{
+    delete m_list.load();
+}
+
 void pointer::build_from_uri_fragment(const std::string &pointer)
 {
     size_t start = 1;
@@ -210,18 +253,25 @@ pointer::token pointer::translate_jsonp_token(const std::string &pointer, size_t
 
 pointer::token pointer::make_token(const std::string &s)
 {
-    std::istringstream is(s);
-
-    size_t i;
-
-    if (is >> i)
+    // An array index is 0 or digits without a leading zero, anything else
+    // (including an index too big for a size_t) is a name.
+    if (s.empty() || (s[0] == '0' && s.size() > 1))
     {
-        return token(i);
+        return token(s);
     }
-    else
+
+    size_t i = 0;
+
+    for (char c : s)
     {
-        return token(s);
+        if (c < '0' || c > '9' || i > (SIZE_MAX - (c - '0')) / 10)
+        {
+            return token(s);
+        }
+        i = i * 10 + (c - '0');
     }
+
+    return token(i);
 }
 
 int pointer::from_hex(const std::string &s, size_t index)
@@ -242,23 +292,66 @@ int pointer::from_hex(const std::string &s, size_t index)
     }
 }
 
-pointer::token::token() : m_type(all_e), m_index(0)
+pointer::token::token() : m_type(all_e), m_index(0), m_hash(0), m_slot_hint(0)
 {
 }
 
-pointer::token::token(const std::string &name) : m_type(object_e), m_name(name), m_index(0)
+pointer::token::token(const std::string &name) :
+                            m_type(object_e),
+                            m_name(name),
+                            m_index(0),
+                            m_hash(hash(name)),
+                            m_slot_hint(0)
 {
 }
 
-pointer::token::token(size_t index) : m_type(array_e), m_index(index)
+pointer::token::token(size_t index) : m_type(array_e), m_index(index), m_hash(hash(index)), m_slot_hint(0)
 {
 }
 
-const std::list<pointer::token> &pointer::get_path() const
+pointer::token::token(const token &other) :
+                            m_type(other.m_type),
+                            m_name(other.m_name),
+                            m_index(other.m_index),
+                            m_hash(other.m_hash),
+                            m_slot_hint(other.get_slot_hint())
+{
+}
+
+pointer::token &pointer::token::operator=(const token &other)
+{
+    m_type = other.m_type;
+    m_name = other.m_name;
+    m_index = other.m_index;
+    m_hash = other.m_hash;
+    set_slot_hint(other.get_slot_hint());
+    return *this;
+}
+
+const std::vector<pointer::token> &pointer::get_tokens() const
 {
     return m_path;
 }
 
+const std::list<pointer::token> &pointer::get_path() const
+{
+    std::list<token> *list = m_list.load(std::memory_order_acquire);
+    if (list == nullptr)
+    {
+        std::list<token> *built = new std::list<token>(m_path.begin(), m_path.end());
+        if (m_list.compare_exchange_strong(list, built, std::memory_order_acq_rel))
+        {
+            list = built;
+        }
+        else
+        {
+            // another thread got there first, list is now its one
+            delete built;
+        }
+    }
+    return *list;
+}
+
 pointer::token::type_t pointer::token::get_type() const
 {
     return m_type;
@@ -274,9 +367,54 @@ size_t pointer::token::get_index() const
     return m_index;
 }
 
+bool pointer::token::is_wildcard() const noexcept
+{
+    return m_type == object_e && m_name.size() == 1 && m_name[0] == '*';
+}
+
+size_t pointer::token::get_slot_hint() const noexcept
+{
+    return m_slot_hint.load(std::memory_order_relaxed);
+}
+
+void pointer::token::set_slot_hint(size_t slot) const noexcept
+{
+    m_slot_hint.store(slot, std::memory_order_relaxed);
+}
+
+uint64_t pointer::token::get_hash() const noexcept
+{
+    return m_hash;
+}
+
+// FNV-1a and the splitmix64 finaliser, names and indices starting from
+// different seeds so that "1" and 1 differ.
+
+static uint64_t pointer_hash_mix(uint64_t h)
+{
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+uint64_t pointer::token::hash(const std::string &name) noexcept
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (auto c : name)
+    {
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+    return pointer_hash_mix(h);
+}
+
+uint64_t pointer::token::hash(size_t index) noexcept
+{
+    return pointer_hash_mix(index + 0x9e3779b97f4a7c15ULL);
+}
+
 std::ostream &NAMESPACE::operator<<(std::ostream &stream, const pointer &p)
 {
-    for (auto &t : p.get_path())
+    for (auto &t : p.get_tokens())
     {
         stream << "/";
         if (t.get_type() == pointer::token::object_e)
@@ -25,8 +25,11 @@
 
 /// \file pointer.hpp The pointer class.
 
+#include <atomic>
+#include <cstdint>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "common.hpp"
 
@@ -37,6 +40,13 @@ namespace NAMESPACE
      *
      * Instances of this class hold a representation of a JSON pointer, the logic to
      * apply it is held within the json class.
+     *
+     * All of the work of decoding the pointer string is done once by the
+     * constructor: the path is held in a vector, array indices are already
+     * numbers and each name remembers where it was last found in a shaped
+     * object. Applying a pointer with json::find() therefore allocates
+     * nothing, so build a pointer once and keep it rather than building one
+     * per lookup. A pointer may be used by any number of threads at once.
      */
     class pointer
     {
@@ -66,6 +76,12 @@ namespace NAMESPACE
             /// Construct a token of type array_e with an array index.
             token(size_t index);
 
+            /// Copy constructor.
+            token(const token &other);
+
+            /// Copy assignment.
+            token &operator=(const token &other);
+
             /// Get the type of the token.
             type_t get_type() const;
 
@@ -75,6 +91,31 @@ namespace NAMESPACE
             /// Get the index in the array referenced.
             size_t get_index() const;
 
+            /**
+             * True for a name of *. This is an ordinary name as far as the
+             * RFC and json::find() are concerned but json::find_all() treats
+             * it as matching everything in an array or object.
+             */
+            bool is_wildcard() const noexcept;
+
+            /// The slot of the shape the name was found in last time, a hint for the next lookup.
+            size_t get_slot_hint() const noexcept;
+
+            /// Remember the slot the name was found in.
+            void set_slot_hint(size_t slot) const noexcept;
+
+            /**
+             * Hash of the token, worked out by the constructor. The same as
+             * hash(get_name()) or hash(get_index()), 0 for all_e.
+             */
+            uint64_t get_hash() const noexcept;
+
+            /// Hash of an object_e token for the name, see path_index.
+            static uint64_t hash(const std::string &name) noexcept;
+
+            /// Hash of an array_e token for the index, see path_index.
+            static uint64_t hash(size_t index) noexcept;
+
         private:
 
             /// Type of the token.
@@ -85,6 +126,12 @@ namespace NAMESPACE
 
             /// Index into the array for an array_e token.
             size_t m_index;
+
+            /// See get_hash().
+            uint64_t m_hash;
+
+            /// See get_slot_hint(). A hint only, so relaxed loads and stores suffice.
+            mutable std::atomic<size_t> m_slot_hint;
         };
 
         /**
@@ -94,13 +141,133 @@ namespace NAMESPACE
         pointer(const std::string &pointer);
 
         /**
-         * Get the list of tokens representing the pointer.
+         * New pointer from tokens that have already been decoded, e.g. by a
+         * parser for another path syntax. An empty path is the whole document.
+         */
+        explicit pointer(std::vector<token> path);
+
+        /// Copy constructor.
+        pointer(const pointer &other);
+
+        /// Move constructor.
+        pointer(pointer &&other) noexcept;
+
+        /// Copy assignment.
+        pointer &operator=(const pointer &other);
+
+        /// Move assignment.
+        pointer &operator=(pointer &&other) noexcept;
+
+        /// Destructor.
+        ~pointer();
+
+        /**
+         * Get the tokens representing the pointer.
+         */
+        const std::vector<token> &get_tokens() const;
+
+        /**
+         * Get the list of tokens representing the pointer. Kept for existing
+         * callers, the list is built from get_tokens() (in a thread safe way)
+         * the first time it is asked for, so use get_tokens() in new code.
          */
         const std::list<token> &get_path() const;
 
+        /**
+         * True if pointer would be accepted by the constructor. As this is
+         * constexpr it can check a string literal at compile time, see
+         * ARGO_POINTER(). The escapes in the string are checked for being
+         * well formed but not that \\u escapes make valid code points.
+         */
+        static constexpr bool is_valid(const char *pointer)
+        {
+            return pointer[0] == '#' ? valid_path(pointer, 1, true) : valid_path(pointer, 0, false);
+        }
+
     private:
 
-        std::list<token> m_path;
+        // The compile time checks. C++11 constexpr functions are a single
+        // return statement so these recurse along the string rather than
+        // loop. A character in the string may be a JSON escape, char_length()
+        // is its length in the string (0 for a bad escape) and char_at() the
+        // character it stands for, 'x' for anything that isn't ASCII.
+
+        static constexpr bool is_hex(char c)
+        {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        }
+
+        static constexpr bool is_upper_hex(char c)
+        {
+            return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F');
+        }
+
+        static constexpr int hex_value(char c)
+        {
+            return c <= '9' ? c - '0' : c <= 'F' ? c - 'A' + 10 : c - 'a' + 10;
+        }
+
+        static constexpr bool is_escape(char c)
+        {
+            return c == '"' || c == '\\' || c == '/' || c == 'b' || c == 'f' || c == 'n' || c == 'r' || c == 't';
+        }
+
+        static constexpr size_t char_length(const char *s, size_t i)
+        {
+            return s[i] != '\\' ? 1 :
+                   is_escape(s[i + 1]) ? 2 :
+                   s[i + 1] == 'u' && is_hex(s[i + 2]) && is_hex(s[i + 3]) && is_hex(s[i + 4]) && is_hex(s[i + 5]) ? 6 :
+                   0;
+        }
+
+        static constexpr char char_at(const char *s, size_t i)
+        {
+            return s[i] != '\\' ? s[i] :
+                   s[i + 1] == '"' || s[i + 1] == '\\' || s[i + 1] == '/' ? s[i + 1] :
+                   s[i + 1] == 'u' && s[i + 2] == '0' && s[i + 3] == '0' && s[i + 4] <= '7' ?
+                            static_cast<char>(hex_value(s[i + 4]) * 16 + hex_value(s[i + 5])) :
+                   'x';
+        }
+
+        /// The start of the pointer, nothing or a token.
+        static constexpr bool valid_path(const char *s, size_t i, bool uri)
+        {
+            return s[i] == '\0' ||
+                   (char_length(s, i) != 0 && char_at(s, i) == '/' && valid_token(s, i + char_length(s, i), uri));
+        }
+
+        /// The rest of a token, after which another token may start.
+        static constexpr bool valid_token(const char *s, size_t i, bool uri)
+        {
+            return s[i] == '\0' ? true :
+                   char_length(s, i) == 0 ? false :
+                   char_at(s, i) == '~' ? valid_tilde(s, i + char_length(s, i), uri) :
+                   char_at(s, i) == '%' && uri ? valid_percent(s, i + char_length(s, i), uri) :
+                   valid_token(s, i + char_length(s, i), uri);
+        }
+
+        /// After a ~.
+        static constexpr bool valid_tilde(const char *s, size_t i, bool uri)
+        {
+            return char_length(s, i) != 0 &&
+                   (char_at(s, i) == '0' || char_at(s, i) == '1') &&
+                   valid_token(s, i + char_length(s, i), uri);
+        }
+
+        /// After a % in a URI fragment, two upper case hex digits.
+        static constexpr bool valid_percent(const char *s, size_t i, bool uri)
+        {
+            return char_length(s, i) != 0 &&
+                   is_upper_hex(char_at(s, i)) &&
+                   char_length(s, i + char_length(s, i)) != 0 &&
+                   is_upper_hex(char_at(s, i + char_length(s, i))) &&
+                   valid_token(s, i + char_length(s, i) + char_length(s, i + char_length(s, i)), uri);
+        }
+
+        std::vector<token> m_path;
+
+        /// See get_path(), nullptr until it is first called.
+        mutable std::atomic<std::list<token> *> m_list;
 
         void build_from_uri_fragment(const std::string &pointer);
         void build_from_json_string(const std::string &pointer);
@@ -115,4 +282,22 @@ namespace NAMESPACE
     std::ostream &operator<<(std::ostream &stream, const pointer &p);
 }
 
+/**
+ * A pointer for a string literal, checked at compile time and built once.
+ * A malformed literal fails to compile, for example
+ * \code{.cpp}
+ * const argo::json &zip = j.find(ARGO_POINTER("/0/address/zip"));
+ * \endcode
+ * Each use expands to a function local static pointer, which C++11
+ * guarantees is built once even with many threads, so a lookup costs only
+ * the walk along the path.
+ */
+#define ARGO_POINTER(s) \
+    ([]() -> const NAMESPACE::pointer & \
+    { \
+        static_assert(NAMESPACE::pointer::is_valid(s), "invalid JSON pointer " s); \
+        static const NAMESPACE::pointer p(s); \
+        return p; \
+    }())
+
 #endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file pointer_set.cpp The pointer_set class implementation.
+
+#include "common.hpp"
+#include "pointer_set.hpp"
+
+using namespace NAMESPACE;
+
+namespace
+{
+    /// The trie while it is being built, nodes refer to their children by index.
+    struct build_node
+    {
+        build_node(const pointer::token &t) : m_token(t)
+        {
+        }
+
+        pointer::token m_token;
+        std::vector<size_t> m_children;
+        std::vector<size_t> m_pointers;
+    };
+
+    bool same_token(const pointer::token &a, const pointer::token &b)
+    {
+        return a.get_type() == b.get_type() &&
+               (a.get_type() == pointer::token::object_e ? a.get_name() == b.get_name() : a.get_index() == b.get_index());
+    }
+}
+
+pointer_set::node::node(const pointer::token &t) : m_token(t), m_end(0)
+{
+}
+
+const pointer::token &pointer_set::node::get_token() const noexcept
+{
+    return m_token;
+}
+
+size_t pointer_set::node::get_end() const noexcept
+{
+    return m_end;
+}
+
+const std::vector<size_t> &pointer_set::node::get_pointers() const noexcept
+{
+    return m_pointers;
+}
+
+pointer_set::pointer_set(const std::vector<pointer> &pointers) : m_size(pointers.size())
+{
+    std::vector<build_node> trie(1, build_node(pointer::token()));
+
+    for (size_t p = 0; p < pointers.size(); p++)
+    {
+        size_t n = 0;
+
+        for (const auto &t : pointers[p].get_tokens())
+        {
+            // all_e is the document itself, i.e. where we already are
+            if (t.get_type() == pointer::token::all_e)
+            {
+                continue;
+            }
+
+            size_t child = 0;
+            for (auto c : trie[n].m_children)
+            {
+                if (same_token(trie[c].m_token, t))
+                {
+                    child = c;
+                    break;
+                }
+            }
+
+            if (child == 0)
+            {
+                child = trie.size();
+                trie.push_back(build_node(t));
+                trie[n].m_children.push_back(child);
+            }
+            n = child;
+        }
+
+        trie[n].m_pointers.push_back(p);
+    }
+
+    // Lay the trie out depth first, noting where each subtree ends once
+    // all of its children have been added.
+    struct frame
+    {
+        size_t m_in;
+        size_t m_out;
+        size_t m_next_child;
+    };
+    std::vector<frame> stack(1, frame{0, 0, 0});
+
+    m_nodes.reserve(trie.size());
+    m_nodes.push_back(node(trie[0].m_token));
+    m_nodes.back().m_pointers = trie[0].m_pointers;
+
+    while (!stack.empty())
+    {
+        frame &f = stack.back();
+
+        if (f.m_next_child < trie[f.m_in].m_children.size())
+        {
+            size_t c = trie[f.m_in].m_children[f.m_next_child++];
+            stack.push_back(frame{c, m_nodes.size(), 0});
+            m_nodes.push_back(node(trie[c].m_token));
+            m_nodes.back().m_pointers = trie[c].m_pointers;
+        }
+        else
+        {
+            m_nodes[f.m_out].m_end = m_nodes.size();
+            stack.pop_back();
+        }
+    }
+}
+
+size_t pointer_set::size() const noexcept
+{
+    return m_size;
+}
+
+const std::vector<pointer_set::node> &pointer_set::get_nodes() const noexcept
+{
+    return m_nodes;
+}
@@ -0,0 +1,108 @@
+#ifndef _json_pointer_set_hpp_
+#define _json_pointer_set_hpp_
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file pointer_set.hpp The pointer_set class.
+
+#include <vector>
+
+#include "common.hpp"
+#include "pointer.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * \brief A set of pointers to look up together.
+     *
+     * The pointers are merged into a trie so that a prefix common to several of
+     * them, e.g. /payload/meta in /payload/meta/id and /payload/meta/source,
+     * is only walked once. json::find(const pointer_set &, std::vector<const json *> &)
+     * resolves the whole set in one walk of the document. Build the set once
+     * and reuse it for every document, it may be used by any number of
+     * threads at once.
+     */
+    class pointer_set
+    {
+    public:
+
+        /**
+         * \brief A node of the trie.
+         *
+         * Nodes are held in a vector in depth first order so that the
+         * children of a node follow it and the subtree of node i is the
+         * nodes from i up to, but not including, get_end().
+         */
+        class node
+        {
+        public:
+
+            /// New node for token t.
+            node(const pointer::token &t);
+
+            /// The token leading to this node from its parent, all_e for the root.
+            const pointer::token &get_token() const noexcept;
+
+            /// The index of the node after the last one in this node's subtree.
+            size_t get_end() const noexcept;
+
+            /// The indexes, in the set, of the pointers that end at this node.
+            const std::vector<size_t> &get_pointers() const noexcept;
+
+        private:
+
+            friend class pointer_set;
+
+            /// See get_token().
+            pointer::token m_token;
+
+            /// See get_end().
+            size_t m_end;
+
+            /// See get_pointers().
+            std::vector<size_t> m_pointers;
+        };
+
+        /**
+         * Build the trie.
+         * \param pointers  The pointers. Results are reported in this order.
+         */
+        explicit pointer_set(const std::vector<pointer> &pointers);
+
+        /// The number of pointers in the set.
+        size_t size() const noexcept;
+
+        /// The trie. Node 0 is the root, the document itself.
+        const std::vector<node> &get_nodes() const noexcept;
+
+    private:
+
+        /// See size().
+        size_t m_size;
+
+        /// See get_nodes().
+        std::vector<node> m_nodes;
+    };
+}
+
+#endif
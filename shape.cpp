@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file shape.cpp The object_shape and shape_table classes implementation.
+
+#include <algorithm>
+#include <cstring>
+
+#include "common.hpp"
+#include "shape.hpp"
+
+using namespace NAMESPACE;
+
+const size_t object_shape::npos;
+const size_t shape_table::max_shapes;
+
+object_shape::object_shape(std::vector<std::string> names) : m_names(std::move(names)), m_last(0)
+{
+}
+
+const std::vector<std::string> &object_shape::get_names() const noexcept
+{
+    return m_names;
+}
+
+size_t object_shape::size() const noexcept
+{
+    return m_names.size();
+}
+
+size_t object_shape::find(const std::string &name) const noexcept
+{
+    return find(name.data(), name.size());
+}
+
+size_t object_shape::find(const char *name, size_t length) const noexcept
+{
+    size_t last = m_last.load(std::memory_order_relaxed);
+
+    if (last < m_names.size() && matches(last, name, length))
+    {
+        return last;
+    }
+
+    size_t res = search(name, length);
+
+    if (res != npos)
+    {
+        m_last.store(res, std::memory_order_relaxed);
+    }
+
+    return res;
+}
+
+size_t object_shape::find(const std::string &name, size_t hint) const noexcept
+{
+    if (hint < m_names.size() && matches(hint, name.data(), name.size()))
+    {
+        return hint;
+    }
+
+    return search(name.data(), name.size());
+}
+
+bool object_shape::matches(size_t i, const char *name, size_t length) const noexcept
+{
+    return m_names[i].size() == length && memcmp(m_names[i].data(), name, length) == 0;
+}
+
+size_t object_shape::search(const char *name, size_t length) const noexcept
+{
+    if (m_names.size() <= linear_search_limit)
+    {
+        for (size_t i = 0; i < m_names.size(); i++)
+        {
+            if (matches(i, name, length))
+            {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    size_t lo = 0;
+    size_t hi = m_names.size();
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = m_names[mid].compare(0, std::string::npos, name, length);
+
+        if (c == 0)
+        {
+            return mid;
+        }
+        else if (c < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return npos;
+}
+
+std::shared_ptr<const object_shape> shape_table::get(const std::vector<std::string> &names)
+{
+    // Neighbouring objects, e.g. the records in an array, nearly always
+    // have the same names.
+    if (m_last && m_last->get_names() == names)
+    {
+        return m_last;
+    }
+
+    // Each name is prefixed with its length so that the key is unambiguous
+    // whatever characters the names contain.
+    m_key.clear();
+    for (const auto &n : names)
+    {
+        size_t l = n.size();
+        m_key.append(reinterpret_cast<const char *>(&l), sizeof(l));
+        m_key.append(n);
+    }
+
+    auto i = m_shapes.find(m_key);
+
+    if (i == m_shapes.end())
+    {
+        if (m_shapes.size() >= max_shapes)
+        {
+            m_shapes.clear();
+        }
+        i = m_shapes.emplace(m_key, std::make_shared<const object_shape>(names)).first;
+    }
+
+    m_last = i->second;
+    return m_last;
+}
+
+size_t shape_table::size() const noexcept
+{
+    return m_shapes.size();
+}
@@ -0,0 +1,144 @@
+#ifndef _json_shape_hpp_
+#define _json_shape_hpp_
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file shape.hpp The object_shape and shape_table classes.
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * \brief The set of member names of an object, shared by every object that
+     * has exactly that set of names.
+     *
+     * A shaped object (see json::is_shaped()) stores just its values, in the
+     * order of the names in its shape. Arrays of records therefore hold each
+     * member name once rather than once per record. Shapes are immutable and
+     * are handled through std::shared_ptr so that any number of objects, in
+     * any number of threads, can share one.
+     */
+    class object_shape
+    {
+    public:
+
+        /// Returned by find() when the name isn't part of the shape.
+        static const size_t npos = static_cast<size_t>(-1);
+
+        /**
+         * Constructor.
+         * \param names The member names, sorted and without duplicates.
+         */
+        explicit object_shape(std::vector<std::string> names);
+
+        /// The member names in order.
+        const std::vector<std::string> &get_names() const noexcept;
+
+        /// Number of members.
+        size_t size() const noexcept;
+
+        /**
+         * The slot holding the value for name or npos. The slot found last is
+         * remembered and tried first so that looking up the same member of
+         * every record in an array of records is a single comparison.
+         */
+        size_t find(const std::string &name) const noexcept;
+
+        /// As find(const std::string &) for the length bytes at name.
+        size_t find(const char *name, size_t length) const noexcept;
+
+        /**
+         * As find(const std::string &) but trying slot hint rather than the
+         * slot found last. Used by code that looks up the same name many times
+         * and keeps its own hint, e.g. a pointer.
+         */
+        size_t find(const std::string &name, size_t hint) const noexcept;
+
+    private:
+
+        object_shape(const object_shape &other) = delete;
+        object_shape &operator=(const object_shape &other) = delete;
+
+        /// True if slot i holds the length bytes at name.
+        bool matches(size_t i, const char *name, size_t length) const noexcept;
+
+        /// find() without the cache.
+        size_t search(const char *name, size_t length) const noexcept;
+
+        /// Shapes up to this size are searched linearly rather than by bisection.
+        static const size_t linear_search_limit = 8;
+
+        /// The names.
+        std::vector<std::string> m_names;
+
+        /// The slot found by the last successful find(). A hint only, so relaxed loads and stores suffice.
+        mutable std::atomic<size_t> m_last;
+    };
+
+    /**
+     * \brief Hands out one shape per distinct set of member names.
+     *
+     * Used by the parser so that all the objects it parses with the same
+     * names share a shape. To bound the memory used when every object has
+     * different names the table starts again once it holds max_shapes shapes.
+     * That only loses sharing with objects parsed earlier, the shapes
+     * themselves live as long as any object using them. Not thread safe.
+     */
+    class shape_table
+    {
+    public:
+
+        /// The most shapes held before the table is cleared.
+        static const size_t max_shapes = 4096;
+
+        /**
+         * The shape for a set of names, created if this is the first time
+         * it has been asked for.
+         * \param names The member names, sorted and without duplicates.
+         */
+        std::shared_ptr<const object_shape> get(const std::vector<std::string> &names);
+
+        /// Number of distinct shapes handed out.
+        size_t size() const noexcept;
+
+    private:
+
+        /// Shapes by their names joined together.
+        std::unordered_map<std::string, std::shared_ptr<const object_shape>> m_shapes;
+
+        /// Reused to build keys for m_shapes.
+        std::string m_key;
+
+        /// The shape returned by the last call to get(), tried first.
+        std::shared_ptr<const object_shape> m_last;
+    };
+}
+
+#endif
@@ -0,0 +1,727 @@
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/// \file tape.cpp The tape class implementation.
+
+#include <string.h>
+#include <climits>
+
+#include "common.hpp"
+#include "tape.hpp"
+#include "json_exception.hpp"
+#include "json_invalid_key_exception.hpp"
+#include "json_array_index_range_exception.hpp"
+
+using namespace NAMESPACE;
+
+static const uint64_t payload_mask = (static_cast<uint64_t>(1) << 56) - 1;
+
+tape::tape(const json &j)
+{
+    string_offsets names;
+    write(j, names);
+}
+
+void tape::append(tag t, uint64_t payload)
+{
+    m_tape.push_back((static_cast<uint64_t>(t) << 56) | (payload & payload_mask));
+}
+
+uint64_t tape::write_string(const std::string &s)
+{
+    uint64_t offset = m_strings.size();
+    uint32_t length = static_cast<uint32_t>(s.size());
+
+    m_strings.resize(offset + sizeof(length) + s.size() + 1);
+    memcpy(&m_strings[offset], &length, sizeof(length));
+    memcpy(&m_strings[offset + sizeof(length)], s.data(), s.size());
+    m_strings[offset + sizeof(length) + s.size()] = '\0';
+
+    return offset;
+}
+
+void tape::write_member(const std::string &name, const json &j, string_offsets &names)
+{
+    auto i = names.find(name);
+    if (i == names.end())
+    {
+        i = names.insert(std::make_pair(name, write_string(name))).first;
+    }
+    append(string_tag, i->second);
+    write(j, names);
+}
+
+void tape::write(const json &j, string_offsets &names)
+{
+    if (j.get_raw_value().size() > 0)
+    {
+        append(raw_tag, write_string(j.get_raw_value()));
+        m_tape.push_back(j.get_instance_type());
+        return;
+    }
+
+    switch (j.get_instance_type())
+    {
+    case json::object_e:
+        {
+            size_t start = m_tape.size();
+            append(object_tag, 0);
+
+            // shaped objects are written straight from their storage
+            auto shape = j.get_shape();
+            if (shape)
+            {
+                auto values = j.get_shape_values();
+                m_tape.push_back(values.size());
+                for (size_t k = 0; k < values.size(); k++)
+                {
+                    write_member(shape->get_names()[k], values[k], names);
+                }
+            }
+            else
+            {
+                m_tape.push_back(j.get_object().size());
+                for (const auto &p : j.get_object())
+                {
+                    write_member(p.first, p.second, names);
+                }
+            }
+
+            append(object_end_tag, start);
+            m_tape[start] |= m_tape.size();
+        }
+        break;
+    case json::array_e:
+        {
+            size_t start = m_tape.size();
+            append(array_tag, 0);
+            if (j.get_packed_type() == json::number_int_e)
+            {
+                auto s = j.as_span<int64_t>();
+                m_tape.push_back(s.size());
+                for (auto i : s)
+                {
+                    append(int_tag, 0);
+                    m_tape.push_back(static_cast<uint64_t>(i));
+                }
+            }
+            else if (j.get_packed_type() == json::number_double_e)
+            {
+                auto s = j.as_span<double>();
+                m_tape.push_back(s.size());
+                for (auto d : s)
+                {
+                    uint64_t bits;
+                    memcpy(&bits, &d, sizeof(bits));
+                    append(double_tag, 0);
+                    m_tape.push_back(bits);
+                }
+            }
+            else
+            {
+                m_tape.push_back(j.get_array().size());
+                for (const auto &e : j.get_array())
+                {
+                    write(e, names);
+                }
+            }
+            append(array_end_tag, start);
+            m_tape[start] |= m_tape.size();
+        }
+        break;
+    case json::boolean_e:
+        append(static_cast<bool>(j) ? true_tag : false_tag, 0);
+        break;
+    case json::null_e:
+        append(null_tag, 0);
+        break;
+    case json::number_int_e:
+        if (j.is_uint64())
+        {
+            append(uint_tag, 0);
+            m_tape.push_back(static_cast<uint64_t>(j));
+        }
+        else
+        {
+            append(int_tag, 0);
+            m_tape.push_back(static_cast<uint64_t>(static_cast<int64_t>(j)));
+        }
+        break;
+    case json::number_double_e:
+        {
+            double d = j;
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            append(double_tag, 0);
+            m_tape.push_back(bits);
+        }
+        break;
+    case json::string_e:
+        append(string_tag, write_string(j));
+        break;
+    default:
+        throw json_exception(json_exception::invalid_json_type_e);
+    }
+}
+
+tape::tag tape::get_tag(size_t index) const noexcept
+{
+    return static_cast<tag>(m_tape[index] >> 56);
+}
+
+uint64_t tape::get_payload(size_t index) const noexcept
+{
+    return m_tape[index] & payload_mask;
+}
+
+size_t tape::skip(size_t index) const noexcept
+{
+    switch (get_tag(index))
+    {
+    case object_tag:
+    case array_tag:
+        return get_payload(index);
+    case int_tag:
+    case uint_tag:
+    case double_tag:
+    case raw_tag:
+        return index + 2;
+    default:
+        return index + 1;
+    }
+}
+
+const char *tape::get_string(size_t index, size_t &length) const noexcept
+{
+    uint64_t offset = get_payload(index);
+    uint32_t l;
+    memcpy(&l, &m_strings[offset], sizeof(l));
+    length = l;
+    return &m_strings[offset + sizeof(l)];
+}
+
+tape::value tape::root() const noexcept
+{
+    return value(this, 0);
+}
+
+tape::value tape::operator[](const std::string &name) const
+{
+    return root()[name];
+}
+
+tape::value tape::operator[](const char *name) const
+{
+    return root()[name];
+}
+
+tape::value tape::operator[](size_t index) const
+{
+    return root()[index];
+}
+
+tape::value tape::operator[](int index) const
+{
+    return root()[index];
+}
+
+tape::value tape::find(const pointer &p) const
+{
+    return root().find(p);
+}
+
+std::unique_ptr<json> tape::to_json() const
+{
+    return root().to_json();
+}
+
+const std::vector<uint64_t> &tape::get_tape() const noexcept
+{
+    return m_tape;
+}
+
+const std::vector<char> &tape::get_string_arena() const noexcept
+{
+    return m_strings;
+}
+
+// values
+
+tape::value::value(const tape *t, size_t index) noexcept : m_tape(t), m_index(index)
+{
+}
+
+size_t tape::value::get_index() const noexcept
+{
+    return m_index;
+}
+
+json::type tape::value::get_instance_type() const
+{
+    switch (m_tape->get_tag(m_index))
+    {
+    case object_tag:
+        return json::object_e;
+    case array_tag:
+        return json::array_e;
+    case string_tag:
+        return json::string_e;
+    case int_tag:
+    case uint_tag:
+        return json::number_int_e;
+    case double_tag:
+        return json::number_double_e;
+    case raw_tag:
+        return static_cast<json::type>(m_tape->m_tape[m_index + 1]);
+    case true_tag:
+    case false_tag:
+        return json::boolean_e;
+    case null_tag:
+        return json::null_e;
+    default:
+        throw json_exception(json_exception::invalid_json_type_e);
+    }
+}
+
+const char *tape::value::get_instance_type_name() const
+{
+    switch (get_instance_type())
+    {
+    case json::object_e:
+        return "object";
+    case json::array_e:
+        return "array";
+    case json::boolean_e:
+        return "boolean";
+    case json::null_e:
+        return "null";
+    case json::number_int_e:
+        return "number (int)";
+    case json::number_double_e:
+        return "number (double)";
+    case json::string_e:
+        return "string";
+    default:
+        return "corrupted";
+    }
+}
+
+void tape::value::ensure_type(json::type t, int ex) const
+{
+    if (m_tape->get_tag(m_index) == raw_tag || get_instance_type() != t)
+    {
+        throw json_exception(json_exception::exception_type(ex), get_instance_type_name());
+    }
+}
+
+void tape::value::ensure_not_raw() const
+{
+    if (m_tape->get_tag(m_index) == raw_tag)
+    {
+        throw json_exception(json_exception::cant_cast_raw_e);
+    }
+}
+
+size_t tape::value::size() const
+{
+    tag t = m_tape->get_tag(m_index);
+
+    if (t == object_tag || t == array_tag)
+    {
+        return m_tape->m_tape[m_index + 1];
+    }
+    else
+    {
+        throw json_exception(json_exception::not_an_array_e, get_instance_type_name());
+    }
+}
+
+bool tape::value::find_member(const std::string &name, size_t &index) const
+{
+    size_t end = m_tape->get_payload(m_index) - 1;
+    size_t i = m_index + 2;
+
+    while (i < end)
+    {
+        size_t length;
+        const char *s = m_tape->get_string(i, length);
+
+        if (length == name.size() && memcmp(s, name.data(), length) == 0)
+        {
+            index = i + 1;
+            return true;
+        }
+
+        i = m_tape->skip(i + 1);
+    }
+
+    return false;
+}
+
+bool tape::value::has(const std::string &name) const
+{
+    ensure_type(json::object_e, json_exception::not_an_object_e);
+    size_t index;
+    return find_member(name, index);
+}
+
+tape::value tape::value::operator[](const std::string &name) const
+{
+    ensure_type(json::object_e, json_exception::not_an_object_e);
+
+    size_t index;
+
+    if (find_member(name, index))
+    {
+        return value(m_tape, index);
+    }
+    else
+    {
+        throw json_invalid_key_exception(json_exception::invalid_key_e, name);
+    }
+}
+
+tape::value tape::value::operator[](const char *name) const
+{
+    return (*this)[std::string(name)];
+}
+
+tape::value tape::value::operator[](size_t index) const
+{
+    ensure_type(json::array_e, json_exception::not_an_array_e);
+
+    if (index >= size())
+    {
+        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+    }
+
+    size_t i = m_index + 2;
+
+    while (index-- > 0)
+    {
+        i = m_tape->skip(i);
+    }
+
+    return value(m_tape, i);
+}
+
+tape::value tape::value::operator[](int index) const
+{
+    if (index >= 0)
+    {
+        return (*this)[static_cast<size_t>(index)];
+    }
+    else
+    {
+        throw json_array_index_range_exception(json_exception::array_index_range_e, index);
+    }
+}
+
+tape::value tape::value::find(const pointer &p) const
+{
+    value res = *this;
+    size_t index;
+
+    for (const auto &t : p.get_tokens())
+    {
+        switch (t.get_type())
+        {
+        case pointer::token::all_e:
+            break;
+
+        case pointer::token::object_e:
+            if (m_tape->get_tag(res.m_index) == object_tag && res.find_member(t.get_name(), index))
+            {
+                res.m_index = index;
+            }
+            else
+            {
+                throw json_exception(json_exception::pointer_not_matched_e);
+            }
+            break;
+
+        case pointer::token::array_e:
+            if (m_tape->get_tag(res.m_index) == array_tag && t.get_index() < res.size())
+            {
+                res = res[t.get_index()];
+            }
+            else
+            {
+                throw json_exception(json_exception::pointer_not_matched_e);
+            }
+            break;
+
+        default:
+            throw json_exception(json_exception::pointer_token_type_invalid_e);
+        }
+    }
+
+    return res;
+}
+
+tape::iterator tape::value::begin() const
+{
+    (void)size();
+    return iterator(m_tape, m_index + 2, m_tape->get_tag(m_index) == object_tag);
+}
+
+tape::iterator tape::value::end() const
+{
+    (void)size();
+    return iterator(m_tape, m_tape->get_payload(m_index) - 1, m_tape->get_tag(m_index) == object_tag);
+}
+
+tape::value::operator int() const
+{
+    ensure_not_raw();
+
+    switch (m_tape->get_tag(m_index))
+    {
+    case int_tag:
+        {
+            int64_t i = static_cast<int64_t>(m_tape->m_tape[m_index + 1]);
+            if (i < INT_MIN || i > INT_MAX)
+            {
+                throw json_exception(json_exception::number_out_of_range_e);
+            }
+            return static_cast<int>(i);
+        }
+    case uint_tag:
+        throw json_exception(json_exception::number_out_of_range_e);
+    case double_tag:
+        return static_cast<int>(static_cast<double>(*this));
+    default:
+        throw json_exception(json_exception::not_number_e, get_instance_type_name());
+    }
+}
+
+tape::value::operator int64_t() const
+{
+    ensure_not_raw();
+
+    switch (m_tape->get_tag(m_index))
+    {
+    case int_tag:
+        return static_cast<int64_t>(m_tape->m_tape[m_index + 1]);
+    case uint_tag:
+        throw json_exception(json_exception::number_out_of_range_e);
+    case double_tag:
+        return static_cast<int64_t>(static_cast<double>(*this));
+    default:
+        throw json_exception(json_exception::not_number_e, get_instance_type_name());
+    }
+}
+
+tape::value::operator uint64_t() const
+{
+    ensure_not_raw();
+
+    switch (m_tape->get_tag(m_index))
+    {
+    case int_tag:
+        if (static_cast<int64_t>(m_tape->m_tape[m_index + 1]) < 0)
+        {
+            throw json_exception(json_exception::number_out_of_range_e);
+        }
+        return m_tape->m_tape[m_index + 1];
+    case uint_tag:
+        return m_tape->m_tape[m_index + 1];
+    case double_tag:
+        return static_cast<uint64_t>(static_cast<double>(*this));
+    default:
+        throw json_exception(json_exception::not_number_e, get_instance_type_name());
+    }
+}
+
+bool tape::value::is_uint64() const noexcept
+{
+    return m_tape->get_tag(m_index) == uint_tag;
+}
+
+tape::value::operator double() const
+{
+    ensure_not_raw();
+
+    switch (m_tape->get_tag(m_index))
+    {
+    case double_tag:
+        {
+            double d;
+            memcpy(&d, &m_tape->m_tape[m_index + 1], sizeof(d));
+            return d;
+        }
+    case int_tag:
+        return static_cast<double>(static_cast<int64_t>(m_tape->m_tape[m_index + 1]));
+    case uint_tag:
+        return static_cast<double>(m_tape->m_tape[m_index + 1]);
+    default:
+        throw json_exception(json_exception::not_number_e, get_instance_type_name());
+    }
+}
+
+tape::value::operator bool() const
+{
+    switch (m_tape->get_tag(m_index))
+    {
+    case true_tag:
+        return true;
+    case false_tag:
+        return false;
+    case int_tag:
+    case uint_tag:
+        return m_tape->m_tape[m_index + 1] != 0;
+    default:
+        throw json_exception(json_exception::not_number_int_or_boolean_e, get_instance_type_name());
+    }
+}
+
+tape::value::operator std::string() const
+{
+    return std::string(c_str(), length());
+}
+
+const char *tape::value::c_str() const
+{
+    ensure_not_raw();
+    ensure_type(json::string_e, json_exception::not_string_e);
+    size_t length;
+    return m_tape->get_string(m_index, length);
+}
+
+size_t tape::value::length() const
+{
+    ensure_not_raw();
+    ensure_type(json::string_e, json_exception::not_string_e);
+    size_t length;
+    (void)m_tape->get_string(m_index, length);
+    return length;
+}
+
+std::string tape::value::get_raw_value() const
+{
+    if (m_tape->get_tag(m_index) == raw_tag)
+    {
+        size_t length;
+        const char *s = m_tape->get_string(m_index, length);
+        return std::string(s, length);
+    }
+    else
+    {
+        return std::string();
+    }
+}
+
+std::unique_ptr<json> tape::value::to_json() const
+{
+    std::unique_ptr<json> res;
+
+    switch (m_tape->get_tag(m_index))
+    {
+    case object_tag:
+        {
+            json::json_object o;
+            for (auto i = begin(); i != end(); ++i)
+            {
+                o.emplace_hint(o.end(), i.key(), std::move(*(*i).to_json()));
+            }
+            res.reset(new json(json::from_object(std::move(o))));
+        }
+        break;
+    case array_tag:
+        {
+            json::json_array a;
+            a.reserve(size());
+            for (auto i = begin(); i != end(); ++i)
+            {
+                a.push_back(std::move(*(*i).to_json()));
+            }
+            res.reset(new json(json::from_array(std::move(a))));
+        }
+        break;
+    case string_tag:
+        res.reset(new json(static_cast<std::string>(*this)));
+        break;
+    case int_tag:
+        res.reset(new json(static_cast<int64_t>(*this)));
+        break;
+    case uint_tag:
+        res.reset(new json(static_cast<uint64_t>(*this)));
+        break;
+    case double_tag:
+        res.reset(new json(static_cast<double>(*this)));
+        break;
+    case raw_tag:
+        res.reset(new json(get_instance_type(), get_raw_value()));
+        break;
+    case true_tag:
+        res.reset(new json(true));
+        break;
+    case false_tag:
+        res.reset(new json(false));
+        break;
+    case null_tag:
+        res.reset(new json());
+        break;
+    default:
+        throw json_exception(json_exception::invalid_json_type_e);
+    }
+
+    return res;
+}
+
+// iterators
+
+tape::iterator::iterator(const tape *t, size_t index, bool is_object) noexcept :
+                    m_tape(t),
+                    m_index(index),
+                    m_is_object(is_object)
+{
+}
+
+tape::value tape::iterator::operator*() const
+{
+    return value(m_tape, m_is_object ? m_index + 1 : m_index);
+}
+
+std::string tape::iterator::key() const
+{
+    size_t length;
+    const char *s = m_tape->get_string(m_index, length);
+    return std::string(s, length);
+}
+
+tape::iterator &tape::iterator::operator++()
+{
+    m_index = m_tape->skip(m_is_object ? m_index + 1 : m_index);
+    return *this;
+}
+
+bool tape::iterator::operator==(const iterator &other) const noexcept
+{
+    return m_index == other.m_index;
+}
+
+bool tape::iterator::operator!=(const iterator &other) const noexcept
+{
+    return m_index != other.m_index;
+}
@@ -0,0 +1,341 @@
+#ifndef _json_tape_hpp_
+#define _json_tape_hpp_
+
+
+/*
+ * Copyright (c) 2017 Andrew Haisley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// \file tape.hpp The tape class.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "json.hpp"
+#include "pointer.hpp"
+
+namespace NAMESPACE
+{
+    /**
+     * \brief An immutable JSON document held in one contiguous block of memory.
+     *
+     * A tape is a read-only alternative to a tree of json instances. The whole
+     * document is stored as a single vector of tagged 64 bit entries (the tape)
+     * plus a second vector holding the characters of all the strings (the arena).
+     * Every entry holds an 8 bit tag in the top byte and a 56 bit payload:
+     *
+     * <pre>
+     * {  payload = index of the entry after the matching }, next entry = member count
+     * [  payload = index of the entry after the matching ], next entry = element count
+     * }  payload = index of the matching {
+     * ]  payload = index of the matching [
+     * "  payload = offset of the string in the arena
+     * l  next entry = the int value
+     * u  next entry = the int value, for values too big for an int64_t
+     * d  next entry = the bits of the double value
+     * r  payload = offset of the raw value in the arena, next entry = json type
+     * t  true
+     * f  false
+     * n  null
+     * </pre>
+     *
+     * Object members are stored as a string entry for the name followed by the
+     * value. Navigation is therefore a forward walk through memory rather than
+     * a chase through map nodes and vector buffers. Build one from a json
+     * instance and convert back with to_json() if a mutable copy is needed.
+     * The navigation API mirrors the const parts of the json API.
+     */
+    class tape
+    {
+    public:
+
+        class iterator;
+
+        /**
+         * \brief A lightweight reference to one value on a tape.
+         *
+         * Instances are cheap to copy and are only valid as long as the tape
+         * they refer to.
+         */
+        class value
+        {
+        public:
+
+            /// Construct a reference to the value at the given tape index.
+            value(const tape *t, size_t index) noexcept;
+
+            /// Get the type of the value.
+            json::type get_instance_type() const;
+
+            /// Get the type name of the value - mainly for logging etc.
+            const char *get_instance_type_name() const;
+
+            /**
+             * Number of elements or members for an array or object.
+             * \throw json_exception if the value isn't an array or an object.
+             */
+            size_t size() const;
+
+            /**
+             * Check if an object has a named member.
+             * \throw json_exception if the value isn't an object.
+             */
+            bool has(const std::string &name) const;
+
+            /**
+             * Find a member of an object by name.
+             * \throw json_exception if the value isn't an object.
+             * \throw json_invalid_key_exception if the member doesn't exist.
+             */
+            value operator[](const std::string &name) const;
+
+            /// See operator[](const std::string &).
+            value operator[](const char *name) const;
+
+            /**
+             * Find an element of an array by index.
+             * \throw json_exception if the value isn't an array.
+             * \throw json_array_index_range_exception if the index is out of range.
+             */
+            value operator[](size_t index) const;
+
+            /// See operator[](size_t). Provides disambiguation from char * for a 0 literal.
+            value operator[](int index) const;
+
+            /**
+             * Find the value pointed at by a pointer.
+             * \throw json_exception if the pointer didn't match.
+             */
+            value find(const pointer &p) const;
+
+            /**
+             * Iterator to the first element or member.
+             * \throw json_exception if the value isn't an array or an object.
+             */
+            iterator begin() const;
+
+            /**
+             * Iterator past the last element or member.
+             * \throw json_exception if the value isn't an array or an object.
+             */
+            iterator end() const;
+
+            /**
+             * Cast to an int.
+             * \throw json_exception if the value isn't an int or a double or
+             *                       is out of range for an int.
+             */
+            operator int() const;
+
+            /**
+             * Cast to an int64_t.
+             * \throw json_exception if the value isn't an int or a double or
+             *                       is too big for an int64_t.
+             */
+            operator int64_t() const;
+
+            /**
+             * Cast to a uint64_t.
+             * \throw json_exception if the value isn't an int or a double or
+             *                       is negative.
+             */
+            operator uint64_t() const;
+
+            /// See json::is_uint64().
+            bool is_uint64() const noexcept;
+
+            /**
+             * Cast to a double.
+             * \throw json_exception if the value isn't a double or an int.
+             */
+            operator double() const;
+
+            /**
+             * Cast to a bool.
+             * \throw json_exception if the value isn't a bool or an int.
+             */
+            operator bool() const;
+
+            /**
+             * Cast to a string. This makes a copy, use c_str() and length() to avoid it.
+             * \throw json_exception if the value isn't a string.
+             */
+            operator std::string() const;
+
+            /**
+             * Pointer to the UTF-8 characters of a string value. They are
+             * nul terminated but may also contain embedded nuls.
+             * \throw json_exception if the value isn't a string.
+             */
+            const char *c_str() const;
+
+            /**
+             * Length in bytes of a string value.
+             * \throw json_exception if the value isn't a string.
+             */
+            size_t length() const;
+
+            /// The raw text of a raw value (see json::get_raw_value()), empty otherwise.
+            std::string get_raw_value() const;
+
+            /// Deep copy the value into a new json instance.
+            std::unique_ptr<json> to_json() const;
+
+            /// Index of the value on the tape.
+            size_t get_index() const noexcept;
+
+        private:
+
+            /// ensure that the value is of the correct type
+            void ensure_type(json::type t, int ex) const;
+
+            /// throw if the value is a raw value
+            void ensure_not_raw() const;
+
+            /// find a named member of an object, index is set to the tape index of the value
+            bool find_member(const std::string &name, size_t &index) const;
+
+            const tape *m_tape;
+            size_t     m_index;
+        };
+
+        /**
+         * \brief Forward iterator over the elements of an array or the members of an object.
+         */
+        class iterator
+        {
+        public:
+
+            /// Constructor. index is the tape index of an element or object member name.
+            iterator(const tape *t, size_t index, bool is_object) noexcept;
+
+            /// The current element or member value.
+            value operator*() const;
+
+            /// Name of the current member. Only valid when iterating an object.
+            std::string key() const;
+
+            /// Move on to the next element or member.
+            iterator &operator++();
+
+            /// Equality.
+            bool operator==(const iterator &other) const noexcept;
+
+            /// Inequality.
+            bool operator!=(const iterator &other) const noexcept;
+
+        private:
+
+            const tape *m_tape;
+            size_t     m_index;
+            bool       m_is_object;
+        };
+
+        /// Entry tags. The values are the characters used in the class description.
+        typedef enum
+        {
+            object_tag = '{',
+            object_end_tag = '}',
+            array_tag = '[',
+            array_end_tag = ']',
+            string_tag = '"',
+            int_tag = 'l',
+            uint_tag = 'u',
+            double_tag = 'd',
+            raw_tag = 'r',
+            true_tag = 't',
+            false_tag = 'f',
+            null_tag = 'n'
+        }
+        tag;
+
+        /// Build a tape holding a copy of the json instance.
+        explicit tape(const json &j);
+
+        /// The value at the root of the document.
+        value root() const noexcept;
+
+        /// Shortcut for root()[name].
+        value operator[](const std::string &name) const;
+
+        /// Shortcut for root()[name].
+        value operator[](const char *name) const;
+
+        /// Shortcut for root()[index].
+        value operator[](size_t index) const;
+
+        /// Shortcut for root()[index].
+        value operator[](int index) const;
+
+        /// Shortcut for root().find(p).
+        value find(const pointer &p) const;
+
+        /// Shortcut for root().to_json().
+        std::unique_ptr<json> to_json() const;
+
+        /// Get the entries - mainly for debugging.
+        const std::vector<uint64_t> &get_tape() const noexcept;
+
+        /// Get the string arena - mainly for debugging.
+        const std::vector<char> &get_string_arena() const noexcept;
+
+    private:
+
+        /// Map of object member names already in the arena to their offsets.
+        typedef std::unordered_map<std::string, uint64_t> string_offsets;
+
+        /// Append the json instance to the tape. Member names are only stored once.
+        void write(const json &j, string_offsets &names);
+
+        /// Append an object member to the tape.
+        void write_member(const std::string &name, const json &j, string_offsets &names);
+
+        /// Append a string to the arena and return its offset.
+        uint64_t write_string(const std::string &s);
+
+        /// Append an entry to the tape.
+        void append(tag t, uint64_t payload);
+
+        /// Get the tag of an entry.
+        tag get_tag(size_t index) const noexcept;
+
+        /// Get the payload of an entry.
+        uint64_t get_payload(size_t index) const noexcept;
+
+        /// Index of the entry following the value starting at index.
+        size_t skip(size_t index) const noexcept;
+
+        /// Get the string at the arena offset held in the entry at index.
+        const char *get_string(size_t index, size_t &length) const noexcept;
+
+        /// The tagged entries.
+        std::vector<uint64_t> m_tape;
+
+        /// Characters for all strings, each preceded by a 32 bit length and followed by a nul.
+        std::vector<char> m_strings;
+    };
+}
+
+#endif
@@ -74,6 +74,18 @@ token::~token()
 {
 }
 
+void token::set(token_type t)
+{
+    m_type = t;
+    m_raw_value.clear();
+}
+
+void token::set(token_type t, const char *raw_value, size_t len)
+{
+    m_type = t;
+    m_raw_value.assign(raw_value, len);
+}
+
 const std::string &token::get_raw_value() const
 {
     return m_raw_value;
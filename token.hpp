@@ -104,6 +104,12 @@ namespace NAMESPACE
         /// Move. Shallow copy.
         token &operator=(token &&other);
 
+        /// Make this a token of type t, keeping the capacity of the raw value.
+        void set(token_type t);
+
+        /// Make this a token of type t with a copy of the raw value, reusing its capacity.
+        void set(token_type t, const char *raw_value, size_t len);
+
         /// Get the raw untranslated JSON value.
         const std::string &get_raw_value() const;
 
@@ -67,35 +67,89 @@ void unparser::unparse_object(const json &j, int indent_level)
 {
     print_indent(indent_level);
     m_writer << '{' << m_space << m_newline;
-    int n = j.get_object().size();
-    for (const auto &p : j.get_object())
+
+    // shaped objects are written straight from their storage
+    auto shape = j.get_shape();
+    if (shape)
     {
-        print_indent(indent_level + m_indent_inc);
-        m_writer << '"' << p.first << '"' << m_space << ':' << m_space;
-        if (p.second.get_instance_type() == json::object_e ||
-            p.second.get_instance_type() == json::array_e)
+        const auto &names = shape->get_names();
+        auto values = j.get_shape_values();
+        for (size_t i = 0; i < names.size(); i++)
         {
-            m_writer << m_newline;
-            unparse((p.second), indent_level + (m_indent_inc * 2));
+            unparse_member(names[i], values[i], i + 1 == names.size(), indent_level);
         }
-        else
+    }
+    else
+    {
+        size_t n = j.get_object().size();
+        for (const auto &p : j.get_object())
         {
-            unparse((p.second), indent_level + m_indent_inc);
+            unparse_member(p.first, p.second, --n == 0, indent_level);
         }
+    }
+
+    print_indent(indent_level);
+    m_writer << m_space << '}';
+}
+
+void unparser::unparse_member(const std::string &name, const json &j, bool last, int indent_level)
+{
+    print_indent(indent_level + m_indent_inc);
+    m_writer << '"' << name << '"' << m_space << ':' << m_space;
+    if (j.get_instance_type() == json::object_e ||
+        j.get_instance_type() == json::array_e)
+    {
+        m_writer << m_newline;
+        unparse(j, indent_level + (m_indent_inc * 2));
+    }
+    else
+    {
+        unparse(j, indent_level + m_indent_inc);
+    }
+    if (!last)
+    {
+        m_writer << ',';
+    }
+    m_writer << m_newline;
+}
+
+template <typename T, typename C>
+void unparser::unparse_packed_array(span<const C> s, int indent_level)
+{
+    size_t n = s.size();
+    for (const auto &i : s)
+    {
+        print_indent(indent_level + m_indent_inc);
+        m_writer << static_cast<T>(i);
         if (n-- > 1)
         {
-            m_writer << ',';
+            m_writer << ',' << m_space;
         }
         m_writer << m_newline;
     }
-    print_indent(indent_level);
-    m_writer << m_space << '}';
 }
 
 void unparser::unparse_array(const json &j, int indent_level)
 {
     print_indent(indent_level);
     m_writer << '[' << m_space << m_newline;
+
+    // packed arrays are written straight from their storage
+    if (j.get_packed_type() != json::null_e)
+    {
+        if (j.get_packed_type() == json::number_int_e)
+        {
+            unparse_packed_array<int64_t>(j.as_span<int64_t>(), indent_level);
+        }
+        else
+        {
+            unparse_packed_array<double>(j.as_span<double>(), indent_level);
+        }
+        print_indent(indent_level);
+        m_writer << m_space << ']';
+        return;
+    }
+
     int n = j.get_array().size();
     for (const auto &i : j.get_array())
     {
@@ -134,7 +188,14 @@ void unparser::unparse(const json &j, int indent_level)
             m_writer << "null";
             break;
         case json::number_int_e:
-            m_writer << static_cast<int>(j);
+            if (j.is_uint64())
+            {
+                m_writer << static_cast<uint64_t>(j);
+            }
+            else
+            {
+                m_writer << static_cast<int64_t>(j);
+            }
             break;
         case json::number_double_e:
             m_writer << static_cast<double>(j);
@@ -159,6 +220,126 @@ void unparser::unparse(const json &j, int indent_level)
     }
 }
 
+void unparser::unparse_object(const tape::value &v, int indent_level)
+{
+    print_indent(indent_level);
+    m_writer << '{' << m_space << m_newline;
+    int n = v.size();
+    for (auto i = v.begin(); i != v.end(); ++i)
+    {
+        tape::value m = *i;
+        print_indent(indent_level + m_indent_inc);
+        m_writer << '"' << i.key() << '"' << m_space << ':' << m_space;
+        if (m.get_instance_type() == json::object_e ||
+            m.get_instance_type() == json::array_e)
+        {
+            m_writer << m_newline;
+            unparse(m, indent_level + (m_indent_inc * 2));
+        }
+        else
+        {
+            unparse(m, indent_level + m_indent_inc);
+        }
+        if (n-- > 1)
+        {
+            m_writer << ',';
+        }
+        m_writer << m_newline;
+    }
+    print_indent(indent_level);
+    m_writer << m_space << '}';
+}
+
+void unparser::unparse_array(const tape::value &v, int indent_level)
+{
+    print_indent(indent_level);
+    m_writer << '[' << m_space << m_newline;
+    int n = v.size();
+    for (auto i = v.begin(); i != v.end(); ++i)
+    {
+        tape::value e = *i;
+        if (e.get_instance_type() != json::object_e &&
+            e.get_instance_type() != json::array_e)
+        {
+            print_indent(indent_level + m_indent_inc);
+        }
+        unparse(e, indent_level + m_indent_inc);
+        if (n-- > 1)
+        {
+            m_writer << ',' << m_space;
+        }
+        m_writer << m_newline;
+    }
+    print_indent(indent_level);
+    m_writer << m_space << ']';
+}
+
+void unparser::unparse(const tape::value &v, int indent_level)
+{
+    std::string raw = v.get_raw_value();
+
+    if (raw == "")
+    {
+        switch (v.get_instance_type())
+        {
+        case json::object_e:
+            unparse_object(v, indent_level);
+            break;
+        case json::array_e:
+            unparse_array(v, indent_level);
+            break;
+        case json::boolean_e:
+            m_writer << (static_cast<bool>(v) ? "true" : "false");
+            break;
+        case json::null_e:
+            m_writer << "null";
+            break;
+        case json::number_int_e:
+            if (v.is_uint64())
+            {
+                m_writer << static_cast<uint64_t>(v);
+            }
+            else
+            {
+                m_writer << static_cast<int64_t>(v);
+            }
+            break;
+        case json::number_double_e:
+            m_writer << static_cast<double>(v);
+            break;
+        case json::string_e:
+            m_writer << '"' << *(utf8::utf8_to_json_string(v)) << '"';
+            break;
+        default:
+            throw json_exception(json_exception::invalid_json_type_e);
+        }
+    }
+    else
+    {
+        if (v.get_instance_type() == json::string_e)
+        {
+            m_writer << '"' << raw << '"';
+        }
+        else
+        {
+            m_writer << raw;
+        }
+    }
+}
+
+void unparser::unparse(
+        std::ostream &o,
+        const tape   &t,
+        const char   *space,
+        const char   *newline,
+        const char   *indent,
+        int           indent_inc)
+{
+    stream_writer w(&o);
+    unparser u(w, space, newline, indent, indent_inc);
+    u.unparse(t.root(), 0);
+}
+
 void unparser::unparse(
         std::ostream &o,
         const json   &j,
@@ -234,3 +415,17 @@ void NAMESPACE::operator<<(std::string &s, const json &j)
     unparser::unparse(ss, j);
     s = ss.str();
 }
+
+std::ostream &NAMESPACE::operator<<(std::ostream &stream, const tape &t)
+{
+    unparser::unparse(stream, t);
+    return stream;
+}
+
+std::ostream &NAMESPACE::operator<<(std::ostream &stream, const tape::value &v)
+{
+    stream_writer w(&stream);
+    unparser u(w);
+    u.unparse(v, 0);
+    return stream;
+}
@@ -29,6 +29,7 @@
 
 #include "common.hpp"
 #include "json.hpp"
+#include "tape.hpp"
 #include "writer.hpp"
 
 namespace NAMESPACE
@@ -45,6 +46,16 @@ namespace NAMESPACE
      */
     void operator<<(std::string &s, const json &e);
 
+    /**
+     * Write a tape to a stream. All output will be on one line.
+     */
+    std::ostream &operator<<(std::ostream &stream, const tape &t);
+
+    /**
+     * Write a value on a tape to a stream. All output will be on one line.
+     */
+    std::ostream &operator<<(std::ostream &stream, const tape::value &v);
+
     /**
      * \brief Class to unparse json instances into JSON messages.
      *
@@ -74,6 +85,20 @@ namespace NAMESPACE
                 const char   *indent = " ",
                 int          indent_inc = 0);
 
+        /**
+         * Unparse a tape to an ostream. The output is identical to that for
+         * the json instance the tape was built from. See documentation for
+         * unparse of a json instance to a stream for parameter details.
+         * \throw json_io_exception Thrown in the case of a IO error whilst writing.
+         */
+        static void unparse(
+                std::ostream &o,
+                const tape   &t,
+                const char   *space = " ",
+                const char   *newline = "",
+                const char   *indent = " ",
+                int          indent_inc = 0);
+
 #ifndef _ARGO_WINDOWS_
         /**
          * Unparse a json instance to a POSIX file descriptor. See documentation
@@ -141,12 +166,26 @@ namespace NAMESPACE
          */
         void unparse(const json &j, int indent_level = 0);
 
+        /**
+         * Unparse a single value held on a tape.
+         * \param v             The value to output.
+         * \param indent_level  The indent level to start at (usually 0).
+         * \throw json_io_exception Thrown in the case of a IO error whilst writing.
+         */
+        void unparse(const tape::value &v, int indent_level = 0);
+
     private:
 
         void print_indent(int indent_level);
         void unparse_object(const json &j, int indent_level);
+        void unparse_member(const std::string &name, const json &j, bool last, int indent_level);
         void unparse_array(const json &j, int indent_level);
 
+        template <typename T, typename C>
+        void unparse_packed_array(span<const C> s, int indent_level);
+        void unparse_object(const tape::value &v, int indent_level);
+        void unparse_array(const tape::value &v, int indent_level);
+
         writer     &m_writer;
         const char *m_space;
         const char *m_newline;
@@ -57,6 +57,22 @@ writer &NAMESPACE::operator<<(writer& w, int i)
     return w;
 }
 
+writer &NAMESPACE::operator<<(writer& w, int64_t i)
+{
+    std::ostringstream ss;
+    ss << i;
+    w.write(ss.str());
+    return w;
+}
+
+writer &NAMESPACE::operator<<(writer& w, uint64_t i)
+{
+    std::ostringstream ss;
+    ss << i;
+    w.write(ss.str());
+    return w;
+}
+
 writer &NAMESPACE::operator<<(writer& w, double d)
 {
     std::ostringstream ss;
@@ -26,6 +26,7 @@
 /// \file writer.hpp The writer class.
 
 #include <ostream>
+#include <cstdint>
 
 #include "common.hpp"
 
@@ -58,6 +59,10 @@ namespace NAMESPACE
     writer &operator<<(writer& w, char c);
     /// Write an int (formatted as a string. i.e. 123 is written as "123").
     writer &operator<<(writer& w, int i);
+    /// Write an int64_t (formatted as a string. i.e. 123 is written as "123").
+    writer &operator<<(writer& w, int64_t i);
+    /// Write a uint64_t (formatted as a string. i.e. 123 is written as "123").
+    writer &operator<<(writer& w, uint64_t i);
     /// Write a double (formatted as a string. i.e. 123e23 is written as "123e23").
     writer &operator<<(writer& w, double d);
 }